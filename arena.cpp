@@ -0,0 +1,96 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+static thread_local Arena* current_arena = nullptr;
+
+// Finished arenas keep their first page and are reused by the next scope on the thread.
+struct ArenaPool {
+    ~ArenaPool() {
+        destroyed = true;
+        for (Arena* arena : arenas) {
+            delete arena;
+        }
+    }
+
+    std::vector<Arena*> arenas;
+    // objects outliving the thread's pool (e.g. in static objects) free their arena directly
+    static thread_local bool destroyed;
+};
+
+thread_local bool ArenaPool::destroyed = false;
+static thread_local ArenaPool free_arenas;
+
+static std::byte* AlignUp(std::byte* ptr, size_t align) {
+    auto address = reinterpret_cast<uintptr_t>(ptr);
+    return reinterpret_cast<std::byte*>((address + align - 1) & ~(align - 1));
+}
+
+void* Arena::Allocate(size_t size, size_t align) {
+    auto aligned = AlignUp(position_, align);
+    if (position_ == nullptr || aligned + size > end_) {
+        size_t page_size = std::max(next_page_size_, size + align);
+        next_page_size_ = std::min(next_page_size_ * 2, kMaxPageSize);
+        if (pages_.empty()) {
+            first_page_size_ = page_size;
+        }
+        pages_.push_back(std::make_unique_for_overwrite<std::byte[]>(page_size));
+        reserved_ += page_size;
+        position_ = pages_.back().get();
+        end_ = position_ + page_size;
+        aligned = AlignUp(position_, align);
+    }
+    position_ = aligned + size;
+    ++allocated_;
+    return aligned;
+}
+
+void Arena::Release() noexcept {
+    if (references_.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+    if (ArenaPool::destroyed || free_arenas.arenas.size() == kPoolSize) {
+        delete this;
+        return;
+    }
+    pages_.resize(std::min<size_t>(pages_.size(), 1));
+    position_ = pages_.empty() ? nullptr : pages_.front().get();
+    end_ = pages_.empty() ? nullptr : position_ + first_page_size_;
+    reserved_ = pages_.empty() ? 0 : first_page_size_;
+    next_page_size_ = kFirstPageSize * 2;
+    allocated_ = 0;
+    references_.store(kOpenBias, std::memory_order_relaxed);
+    free_arenas.arenas.push_back(this);
+}
+
+Arena* Arena::Current() {
+    return current_arena;
+}
+
+Arena* Arena::Acquire() {
+    if (free_arenas.arenas.empty()) {
+        return new Arena();
+    }
+    Arena* arena = free_arenas.arenas.back();
+    free_arenas.arenas.pop_back();
+    return arena;
+}
+
+// While the scope is open the counter is kOpenBias minus released objects, so it can't reach
+// zero. Closing replaces the bias with the real number of allocations, leaving one reference
+// for the scope itself which is dropped right away.
+void Arena::Close() noexcept {
+    references_.fetch_add(static_cast<int64_t>(allocated_) + 1 - kOpenBias,
+                          std::memory_order_acq_rel);
+    Release();
+}
+
+ArenaScope::ArenaScope() : arena_(Arena::Acquire()), previous_(current_arena) {
+    current_arena = arena_;
+}
+
+ArenaScope::~ArenaScope() {
+    current_arena = previous_;
+    arena_->Close();
+}
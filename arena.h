@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Bump allocator for the objects of one run. Memory is never reused inside an arena, all pages
+// are released together once the owning scope has ended and the last object is destroyed.
+class Arena {
+public:
+    void* Allocate(size_t size, size_t align);
+
+    // Called once per destroyed object, recycles the arena after the last one.
+    void Release() noexcept;
+
+    // Arena of the innermost ArenaScope on this thread, nullptr outside of scopes.
+    static Arena* Current();
+
+    // Long running evaluations stop using the arena once it has grown this much, their later
+    // objects are allocated individually so that memory is reused.
+    bool IsFull() const {
+        return reserved_ >= kMaxSize;
+    }
+
+private:
+    friend class ArenaScope;
+    friend struct ArenaPool;
+
+    Arena() = default;
+    ~Arena() = default;
+
+    static Arena* Acquire();
+    void Close() noexcept;
+
+    static constexpr size_t kFirstPageSize = 4096;
+    static constexpr size_t kMaxPageSize = 64 * 1024;
+    static constexpr size_t kMaxSize = 32 * 1024 * 1024;
+    static constexpr size_t kPoolSize = 8;
+    // Keeps the counter away from zero while the scope is open, see Close.
+    static constexpr int64_t kOpenBias = int64_t{1} << 62;
+
+    std::vector<std::unique_ptr<std::byte[]>> pages_;
+    std::byte* position_ = nullptr;
+    std::byte* end_ = nullptr;
+    size_t next_page_size_ = kFirstPageSize;
+    // the first page is kept when the arena is recycled
+    size_t first_page_size_ = 0;
+    size_t reserved_ = 0;
+    // Allocations are counted without atomics by the owning thread, objects can be destroyed
+    // anywhere so releases go to the atomic counter.
+    size_t allocated_ = 0;
+    std::atomic<int64_t> references_ = kOpenBias;
+};
+
+// Objects created with Make (gc.h) while the scope is alive are placed in a fresh arena.
+class ArenaScope {
+public:
+    ArenaScope();
+    ~ArenaScope();
+
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+private:
+    Arena* arena_;
+    Arena* previous_;
+};
+
+template <class T>
+struct ArenaAllocator {
+    using value_type = T;
+
+    explicit ArenaAllocator(Arena* arena) : arena(arena){};
+
+    template <class U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena){};
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(arena->Allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T*, size_t) noexcept {
+        arena->Release();
+    }
+
+    template <class U>
+    bool operator==(const ArenaAllocator<U>& other) const {
+        return arena == other.arena;
+    }
+
+    Arena* arena;
+};
@@ -0,0 +1,294 @@
+#include "ast_image.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace {
+
+constexpr size_t kAlignment = 8;
+constexpr uint32_t kInProgress = UINT32_MAX;
+
+size_t AlignUp(size_t size) {
+    return (size + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+template <class T>
+void AppendPart(std::string* image, const T* data, size_t count) {
+    image->append(reinterpret_cast<const char*>(data), count * sizeof(T));
+    image->resize(AlignUp(image->size()));
+}
+
+}  // namespace
+
+//////////////////////////////// Writing
+
+uint32_t AstImageWriter::AddNode(const ImageNode& node) {
+    if (nodes_.size() >= kImageEmptyList) {
+        throw std::length_error("too many nodes for an AST image");
+    }
+    nodes_.push_back(node);
+    return nodes_.size() - 1;
+}
+
+// Post-order with an explicit stack, so long lists don't recurse. A node is marked while its
+// children are written, meeting it again among them means the form is cyclic.
+void AstImageWriter::AddForm(const std::shared_ptr<Object>& form) {
+    std::unordered_map<const Object*, uint32_t> written;
+    std::vector<Object*> stack;
+    if (form != nullptr) {
+        stack.push_back(form.get());
+    }
+    // pushes a child that has no node yet, false if it has to be written first
+    auto is_written = [&](const std::shared_ptr<Object>& child) {
+        if (child == nullptr) {
+            return true;
+        }
+        auto it = written.find(child.get());
+        if (it == written.end()) {
+            stack.push_back(child.get());
+            return false;
+        }
+        if (it->second == kInProgress) {
+            throw std::invalid_argument("a cyclic form can't be stored in an AST image");
+        }
+        return true;
+    };
+    std::unordered_set<uint32_t> referenced;
+    auto node_of = [&](const std::shared_ptr<Object>& child) {
+        if (child == nullptr) {
+            return kImageEmptyList;
+        }
+        uint32_t index = written[child.get()];
+        if (!referenced.insert(index).second) {
+            nodes_[index].flags |= ImageNode::SHARED;
+        }
+        return index;
+    };
+
+    while (!stack.empty()) {
+        Object* obj = stack.back();
+        auto [it, inserted] = written.emplace(obj, kInProgress);
+        if (!inserted && it->second != kInProgress) {
+            stack.pop_back();
+            continue;
+        }
+        ImageNode node = {};
+        if (auto* cell = As<Cell>(obj)) {
+            bool first_written = is_written(cell->GetFirst());
+            if (!is_written(cell->GetSecond()) || !first_written) {
+                continue;
+            }
+            node.kind = ImageNodeKind::CELL;
+            node.flags = (cell->IsListMarked() ? ImageNode::LIST : 0) |
+                         (cell->is_quoted ? ImageNode::QUOTED : 0);
+            node.a = node_of(cell->GetFirst());
+            node.b = node_of(cell->GetSecond());
+        } else if (auto* vector = As<Vector>(obj)) {
+            bool elements_written = true;
+            for (const auto& element : vector->GetElements()) {
+                elements_written &= is_written(element);
+            }
+            if (!elements_written) {
+                continue;
+            }
+            node.kind = ImageNodeKind::VECTOR;
+            node.a = elements_.size();
+            node.b = vector->Size();
+            for (const auto& element : vector->GetElements()) {
+                elements_.push_back(node_of(element));
+            }
+        } else if (auto* number = As<Number>(obj)) {
+            auto value = static_cast<uint64_t>(number->GetValue());
+            node.kind = ImageNodeKind::NUMBER;
+            node.a = static_cast<uint32_t>(value);
+            node.b = static_cast<uint32_t>(value >> 32);
+        } else if (auto* boolean = As<Boolean>(obj)) {
+            node.kind = ImageNodeKind::BOOLEAN;
+            node.a = boolean->GetBool();
+        } else if (auto* symbol = As<Symbol>(obj)) {
+            auto [entry, is_new] = symbols_.emplace(symbol->GetId(), symbols_.size());
+            if (is_new) {
+                names_ += symbol->GetName();
+                symbol_starts_.push_back(names_.size());
+            }
+            node.kind = ImageNodeKind::SYMBOL;
+            node.a = entry->second;
+        } else {
+            throw std::invalid_argument(std::string("a ") + ObjectTypeName(obj->GetType()) +
+                                        " can't be stored in an AST image");
+        }
+        written[obj] = AddNode(node);
+        stack.pop_back();
+    }
+    form_starts_.push_back(nodes_.size());
+}
+
+std::string AstImageWriter::Finish() const {
+    ImageHeader header = {};
+    std::memcpy(header.magic, kImageMagic, sizeof(header.magic));
+    header.version = kImageVersion;
+    header.byte_order = kImageByteOrder;
+    header.forms = form_starts_.size() - 1;
+    header.nodes = nodes_.size();
+    header.elements = elements_.size();
+    header.symbols = symbol_starts_.size() - 1;
+    header.names_size = names_.size();
+
+    std::string image;
+    AppendPart(&image, &header, 1);
+    AppendPart(&image, form_starts_.data(), form_starts_.size());
+    AppendPart(&image, nodes_.data(), nodes_.size());
+    AppendPart(&image, elements_.data(), elements_.size());
+    AppendPart(&image, symbol_starts_.data(), symbol_starts_.size());
+    AppendPart(&image, names_.data(), names_.size());
+    return image;
+}
+
+//////////////////////////////// Reading
+
+AstImage::AstImage(const std::string& path)
+    : AstImage(std::make_unique<MappedFile>(path), path) {
+}
+
+AstImage::AstImage(std::unique_ptr<MappedFile> file, std::string name)
+    : file_(std::move(file)), name_(std::move(name)) {
+    Check(file_->View());
+}
+
+AstImage::AstImage(std::string_view data, std::string name) : name_(std::move(name)) {
+    Check(data);
+}
+
+bool AstImage::IsImage(std::string_view data) {
+    return data.size() >= sizeof(ImageHeader) &&
+           std::memcmp(data.data(), kImageMagic, sizeof(kImageMagic)) == 0;
+}
+
+// Everything Root, Node, Element and SymbolName rely on, the nodes are checked as forms are
+// made.
+void AstImage::Check(std::string_view data) {
+    auto fail = [&](const char* what) { throw std::runtime_error(name_ + ": " + what); };
+    if (!IsImage(data)) {
+        fail("not an AST image");
+    }
+    if (reinterpret_cast<uintptr_t>(data.data()) % kAlignment != 0) {
+        fail("misaligned AST image");
+    }
+    header_ = reinterpret_cast<const ImageHeader*>(data.data());
+    if (header_->byte_order != kImageByteOrder) {
+        fail("AST image of another byte order");
+    }
+    if (header_->version != kImageVersion) {
+        fail("unsupported AST image version");
+    }
+
+    uint64_t offset = AlignUp(sizeof(ImageHeader));
+    auto part = [&](uint64_t size) {
+        uint64_t start = offset;
+        offset += AlignUp(size);
+        if (size > data.size() || offset > data.size()) {
+            fail("truncated AST image");
+        }
+        return data.data() + start;
+    };
+    form_starts_ = reinterpret_cast<const uint32_t*>(
+        part((uint64_t{header_->forms} + 1) * sizeof(uint32_t)));
+    nodes_ = reinterpret_cast<const ImageNode*>(part(uint64_t{header_->nodes} * sizeof(ImageNode)));
+    elements_ = reinterpret_cast<const uint32_t*>(
+        part(uint64_t{header_->elements} * sizeof(uint32_t)));
+    symbol_starts_ = reinterpret_cast<const uint32_t*>(
+        part((uint64_t{header_->symbols} + 1) * sizeof(uint32_t)));
+    names_ = part(header_->names_size);
+
+    if (form_starts_[0] != 0 || form_starts_[header_->forms] != header_->nodes) {
+        fail("corrupt forms in AST image");
+    }
+    for (size_t i = 0; i < header_->forms; ++i) {
+        if (form_starts_[i] > form_starts_[i + 1]) {
+            fail("corrupt forms in AST image");
+        }
+    }
+    if (symbol_starts_[0] != 0 || symbol_starts_[header_->symbols] != header_->names_size) {
+        fail("corrupt symbols in AST image");
+    }
+    for (size_t i = 0; i < header_->symbols; ++i) {
+        if (symbol_starts_[i] > symbol_starts_[i + 1]) {
+            fail("corrupt symbols in AST image");
+        }
+    }
+    symbols_.resize(header_->symbols);
+}
+
+// Children come before their parents, so the objects are made in one pass over the nodes. A
+// child that isn't shared is moved into its parent, so a second parent of it finds an empty
+// slot (no node makes an empty object).
+std::shared_ptr<Object> AstImage::Form(size_t form) const {
+    uint32_t begin = form_starts_[form];
+    uint32_t end = form_starts_[form + 1];
+    std::vector<std::shared_ptr<Object>> objects(end - begin);
+    auto child = [&](uint32_t index, uint32_t parent) -> std::shared_ptr<Object> {
+        if (index == kImageEmptyList) {
+            return nullptr;
+        }
+        if (index < begin || index >= parent) {
+            throw std::runtime_error(name_ + ": corrupt node in AST image");
+        }
+        auto& obj = objects[index - begin];
+        if (obj == nullptr) {
+            throw RuntimeError(name_ + ": corrupt image");
+        }
+        if (nodes_[index].flags & ImageNode::SHARED) {
+            return obj;
+        }
+        return std::move(obj);
+    };
+
+    for (uint32_t i = begin; i < end; ++i) {
+        const auto& node = nodes_[i];
+        auto& obj = objects[i - begin];
+        switch (node.kind) {
+            case ImageNodeKind::NUMBER:
+                obj = MakeNumber(node.GetNumber());
+                break;
+            case ImageNodeKind::BOOLEAN:
+                obj = MakeBoolean(node.a != 0);
+                break;
+            case ImageNodeKind::SYMBOL:
+                if (node.a >= header_->symbols) {
+                    throw std::runtime_error(name_ + ": corrupt node in AST image");
+                }
+                if (symbols_[node.a] == nullptr) {
+                    symbols_[node.a] = Symbol::Intern(SymbolName(node.a));
+                }
+                obj = symbols_[node.a];
+                break;
+            case ImageNodeKind::CELL: {
+                auto cell = Make<Cell>(child(node.a, i), child(node.b, i));
+                if (node.flags & ImageNode::LIST) {
+                    cell->IsList();
+                }
+                cell->is_quoted = (node.flags & ImageNode::QUOTED) != 0;
+                obj = std::move(cell);
+                break;
+            }
+            case ImageNodeKind::VECTOR: {
+                if (uint64_t{node.a} + node.b > header_->elements) {
+                    throw std::runtime_error(name_ + ": corrupt node in AST image");
+                }
+                std::vector<std::shared_ptr<Object>> elements;
+                elements.reserve(node.b);
+                for (uint32_t j = 0; j < node.b; ++j) {
+                    elements.push_back(child(elements_[node.a + j], i));
+                }
+                auto vector = Make<Vector>(std::move(elements));
+                vector->MarkLiteral();
+                obj = std::move(vector);
+                break;
+            }
+            default:
+                throw std::runtime_error(name_ + ": corrupt node in AST image");
+        }
+    }
+    return objects.empty() ? nullptr : std::move(objects.back());
+}
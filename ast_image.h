@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "mapped_file.h"
+#include "object.h"
+
+// Binary image of the forms of a program as read, so they can be loaded without tokenizing and
+// parsing the text again (see scheme_image.cpp). The image is one flat buffer without pointers,
+// in native byte order, which is mapped as it is:
+//
+//   ImageHeader
+//   uint32_t form_starts[forms + 1]   the nodes of form i are form_starts[i] .. form_starts[i+1]
+//   ImageNode nodes[nodes]            children before their parents, the root of a form last
+//   uint32_t elements[elements]       the nodes of the elements of vectors
+//   uint32_t symbol_starts[symbols + 1]
+//   char names[]                      the names of symbol i are names[symbol_starts[i] ..]
+//
+// Each part starts at a multiple of 8. Nodes refer to nodes of the same form by index, shared
+// parts of a form (like equal quoted literals) are stored once, and kImageEmptyList is ().
+
+constexpr char kImageMagic[8] = {'S', 'C', 'M', 'I', 'M', 'A', 'G', 'E'};
+constexpr uint32_t kImageVersion = 1;
+// Written as a number, so an image of the other byte order doesn't match.
+constexpr uint32_t kImageByteOrder = 0x01020304;
+constexpr uint32_t kImageEmptyList = UINT32_MAX;
+
+struct ImageHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t forms;
+    uint32_t nodes;
+    uint32_t elements;
+    uint32_t symbols;
+    uint64_t names_size;
+};
+
+enum class ImageNodeKind : uint8_t { NUMBER, BOOLEAN, SYMBOL, CELL, VECTOR };
+
+struct ImageNode {
+    // SHARED: more than one node refers to it
+    enum Flags : uint8_t { LIST = 1, QUOTED = 2, SHARED = 4 };
+
+    ImageNodeKind kind;
+    uint8_t flags;
+    uint16_t unused;
+    // the first of a cell, a symbol, the start of a vector in the elements, the low half of a
+    // number, or a boolean
+    uint32_t a;
+    // the second of a cell, the size of a vector, or the high half of a number
+    uint32_t b;
+
+    int64_t GetNumber() const {
+        return static_cast<int64_t>(uint64_t{b} << 32 | a);
+    }
+};
+
+static_assert(sizeof(ImageNode) == 12);
+
+// Collects forms and lays them out as an image.
+class AstImageWriter {
+public:
+    // The form must only consist of numbers, booleans, symbols, cells and vectors, like the
+    // forms Read returns.
+    void AddForm(const std::shared_ptr<Object>& form);
+
+    std::string Finish() const;
+
+private:
+    uint32_t AddNode(const ImageNode& node);
+
+    std::vector<uint32_t> form_starts_ = {0};
+    std::vector<ImageNode> nodes_;
+    std::vector<uint32_t> elements_;
+    std::unordered_map<uint32_t, uint32_t> symbols_;
+    std::vector<uint32_t> symbol_starts_ = {0};
+    std::string names_;
+};
+
+// An image, either mapped from a file or in memory that outlives it. The nodes can be read in
+// place, objects are only made for the forms that are evaluated. Not thread-safe: symbols are
+// interned on first use.
+class AstImage {
+public:
+    // Throws std::runtime_error if the data isn't an image of this version, errors start with
+    // the path or the name.
+    explicit AstImage(const std::string& path);
+    // Takes over a file that is already mapped, like one IsImage was checked on.
+    AstImage(std::unique_ptr<MappedFile> file, std::string name);
+    AstImage(std::string_view data, std::string name);
+
+    static bool IsImage(std::string_view data);
+
+    size_t Forms() const {
+        return header_->forms;
+    }
+
+    // Index of the root node of a form, kImageEmptyList for ().
+    uint32_t Root(size_t form) const {
+        return form_starts_[form + 1] == form_starts_[form] ? kImageEmptyList
+                                                            : form_starts_[form + 1] - 1;
+    }
+
+    const ImageNode& Node(uint32_t index) const {
+        return nodes_[index];
+    }
+
+    uint32_t Element(const ImageNode& vector, size_t index) const {
+        return elements_[vector.a + index];
+    }
+
+    std::string_view SymbolName(uint32_t symbol) const {
+        return std::string_view(names_ + symbol_starts_[symbol],
+                                symbol_starts_[symbol + 1] - symbol_starts_[symbol]);
+    }
+
+    // Makes the objects of a form, like Read would. Throws std::runtime_error if the form's
+    // nodes are inconsistent.
+    std::shared_ptr<Object> Form(size_t form) const;
+
+private:
+    void Check(std::string_view data);
+
+    std::unique_ptr<MappedFile> file_;
+    std::string name_;
+    const ImageHeader* header_ = nullptr;
+    const uint32_t* form_starts_ = nullptr;
+    const ImageNode* nodes_ = nullptr;
+    const uint32_t* elements_ = nullptr;
+    const uint32_t* symbol_starts_ = nullptr;
+    const char* names_ = nullptr;
+    mutable std::vector<std::shared_ptr<Symbol>> symbols_;
+};
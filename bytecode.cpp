@@ -0,0 +1,416 @@
+#include "bytecode.h"
+#include "eval_limits.h"
+#include "special_forms.h"
+
+#if defined(__GNUC__)
+#define SCHEME_THREADED_DISPATCH 1
+#else
+#define SCHEME_THREADED_DISPATCH 0
+#endif
+
+Bytecode::Bytecode(const std::shared_ptr<Object>& ast) {
+    Compile(ast, false);
+    Emit(OpCode::RETURN);
+}
+
+Bytecode::Bytecode(std::span<const std::shared_ptr<Object>> body) {
+    for (size_t i = 0; i < body.size(); ++i) {
+        Compile(body[i], i + 1 == body.size());
+        if (i + 1 < body.size()) {
+            Emit(OpCode::POP);
+        }
+    }
+    Emit(OpCode::RETURN);
+}
+
+void Bytecode::Emit(OpCode op, uint32_t a, uint32_t b) {
+    switch (op) {
+        case OpCode::PUSH:
+        case OpCode::EVAL:
+        case OpCode::LOCAL:
+            ++depth_;
+            break;
+        case OpCode::POP:
+        case OpCode::JUMP_IF_FALSE:
+            --depth_;
+            break;
+        case OpCode::CALL:
+        case OpCode::CALL_NUMBERS:
+            depth_ = depth_ - b + 1;
+            break;
+        case OpCode::APPLY:
+        case OpCode::TAIL_APPLY:
+            depth_ -= b;
+            break;
+        default:
+            break;
+    }
+    max_depth_ = std::max(max_depth_, depth_);
+    code_.push_back({op, a, b});
+}
+
+uint32_t Bytecode::AddConstant(std::shared_ptr<Object> obj) {
+    constants_.push_back(std::move(obj));
+    return constants_.size() - 1;
+}
+
+// tail is set for the last expression of a procedure body and the branches of ifs in it.
+void Bytecode::Compile(const std::shared_ptr<Object>& node, bool tail) {
+    if (node == nullptr || Is<Number>(node) || Is<Boolean>(node) || Is<Vector>(node)) {
+        Emit(OpCode::PUSH, AddConstant(node));
+    } else if (Is<Constant>(node)) {
+        Emit(OpCode::PUSH, AddConstant(As<Constant>(node)->GetValue()));
+    } else if (Is<Symbol>(node) && As<Symbol>(node)->IsBuiltin()) {
+        Emit(OpCode::PUSH, AddConstant(node->Eval()));
+    } else if (auto* ref = As<LocalRef>(node)) {
+        Emit(OpCode::LOCAL, ref->GetDepth(), ref->GetSlot());
+    } else if (Is<If>(node)) {
+        CompileIf(node, tail);
+    } else if (auto* define = As<Define>(node)) {
+        Compile(define->GetValue(), false);
+        if (define->GetSlot() == Define::kGlobal) {
+            Emit(OpCode::DEFINE_GLOBAL, AddConstant(define->GetName()),
+                 define->GetName()->GetId());
+        } else {
+            Emit(OpCode::DEFINE_LOCAL, define->GetSlot(), AddConstant(define->GetName()));
+        }
+    } else if (Is<Lambda>(node)) {
+        CompileLambda(node);
+        // makes the closure over the current frame
+        Emit(OpCode::EVAL, AddConstant(node));
+    } else if (auto* call = As<Call>(node)) {
+        Compile(call->GetFunction(), false);
+        for (const auto& arg : call->GetArgs()) {
+            Compile(arg, false);
+        }
+        Emit(tail && call->IsTail() ? OpCode::TAIL_APPLY : OpCode::APPLY, 0,
+             call->GetArgs().size());
+    } else if (Is<Cell>(node)) {
+        CompileApplication(node);
+    } else {
+        // global variables
+        Emit(OpCode::EVAL, AddConstant(node));
+    }
+}
+
+// Builtins CALL_NUMBERS does without calling them, see ApplyToNumbers.
+static bool IsOnNumbers(FunctionKind kind) {
+#if SCHEME_PROFILING
+    // their calls are timed
+    return false;
+#else
+    switch (kind) {
+        case FunctionKind::SUM:
+        case FunctionKind::SUBTRACTION:
+        case FunctionKind::PRODUCT:
+        case FunctionKind::DECREASING:
+        case FunctionKind::DECREASING_OR_EQUAL:
+        case FunctionKind::INCREASING:
+        case FunctionKind::INCREASING_OR_EQUAL:
+        case FunctionKind::EQUAL:
+            return true;
+        default:
+            return false;
+    }
+#endif
+}
+
+// Same results as the builtins give for two numbers, overflow wraps around.
+static std::shared_ptr<Object> ApplyToNumbers(FunctionKind kind, int64_t x, int64_t y) {
+    auto ux = static_cast<uint64_t>(x);
+    auto uy = static_cast<uint64_t>(y);
+    switch (kind) {
+        case FunctionKind::SUM:
+            return MakeNumber(static_cast<int64_t>(ux + uy));
+        case FunctionKind::SUBTRACTION:
+            return MakeNumber(static_cast<int64_t>(ux - uy));
+        case FunctionKind::PRODUCT:
+            return MakeNumber(static_cast<int64_t>(ux * uy));
+        case FunctionKind::DECREASING:
+            return MakeBoolean(x > y);
+        case FunctionKind::DECREASING_OR_EQUAL:
+            return MakeBoolean(x >= y);
+        case FunctionKind::INCREASING:
+            return MakeBoolean(x < y);
+        case FunctionKind::INCREASING_OR_EQUAL:
+            return MakeBoolean(x <= y);
+        default:
+            return MakeBoolean(x == y);
+    }
+}
+
+// Applications of builtins, everything else is left to Cell::Eval.
+void Bytecode::CompileApplication(const std::shared_ptr<Object>& node) {
+    auto cell = As<Cell>(node);
+    if (cell->is_quoted) {
+        Emit(OpCode::PUSH, AddConstant(node));
+        return;
+    }
+    const auto& head = cell->GetFirst();
+    std::shared_ptr<Function> func;
+    if (Is<Symbol>(head) && As<Symbol>(head)->IsBuiltin()) {
+        func = AsShared<Function>(head->Eval());
+    }
+    if (func == nullptr) {
+        CompileLambdasIn(node);
+        Emit(OpCode::EVAL, AddConstant(node));
+        return;
+    }
+    switch (func->GetKind()) {
+        case FunctionKind::QUOTE:
+            Emit(OpCode::PUSH, AddConstant(cell->GetSecond()));
+            return;
+        case FunctionKind::AND:
+        case FunctionKind::OR:
+            CompileAndOr(cell->GetSecond(), func->GetKind() == FunctionKind::AND);
+            return;
+        default:
+            break;
+    }
+    std::vector<std::shared_ptr<Object>> args;
+    TreeToVectorNoEval(cell->GetSecond(), args);
+    for (const auto& arg : args) {
+        Compile(arg, false);
+    }
+    bool on_numbers = args.size() == 2 && IsOnNumbers(func->GetKind());
+    functions_.push_back(std::move(func));
+    Emit(on_numbers ? OpCode::CALL_NUMBERS : OpCode::CALL, functions_.size() - 1, args.size());
+}
+
+void Bytecode::CompileAndOr(const std::shared_ptr<Object>& node, bool is_and) {
+    std::vector<std::shared_ptr<Object>> args;
+    TreeToVectorNoEval(node, args);
+    if (args.empty()) {
+        Emit(OpCode::PUSH, AddConstant(MakeBoolean(is_and)));
+        return;
+    }
+    std::vector<size_t> jumps;
+    for (size_t i = 0; i < args.size(); ++i) {
+        Compile(args[i], false);
+        if (i + 1 < args.size()) {
+            jumps.push_back(code_.size());
+            Emit(is_and ? OpCode::JUMP_IF_FALSE_OR_POP : OpCode::JUMP_IF_TRUE_OR_POP);
+            --depth_;
+        }
+    }
+    for (size_t jump : jumps) {
+        code_[jump].a = code_.size();
+    }
+}
+
+void Bytecode::CompileIf(const std::shared_ptr<Object>& node, bool tail) {
+    auto* branch = As<If>(node);
+    Compile(branch->GetTest(), false);
+    size_t to_alternative = code_.size();
+    Emit(OpCode::JUMP_IF_FALSE);
+    Compile(branch->GetConsequent(), tail);
+    size_t to_end = code_.size();
+    Emit(OpCode::JUMP);
+    // only one of the branches runs
+    --depth_;
+    code_[to_alternative].a = code_.size();
+    Compile(branch->GetAlternative(), tail);
+    code_[to_end].a = code_.size();
+}
+
+void Bytecode::CompileLambda(const std::shared_ptr<Object>& node) {
+    auto* lambda = As<Lambda>(node);
+    if (lambda->GetCode() == nullptr) {
+        lambda->SetCode(std::make_shared<const Bytecode>(std::span(lambda->GetBody())));
+    }
+}
+
+void Bytecode::CompileLambdasIn(const std::shared_ptr<Object>& node) {
+    std::vector<Object*> pending = {node.get()};
+    std::vector<Object*> children;
+    while (!pending.empty()) {
+        Object* obj = pending.back();
+        pending.pop_back();
+        if (auto* lambda = As<Lambda>(obj)) {
+            CompileLambda(std::static_pointer_cast<Lambda>(lambda->Self()));
+            continue;
+        }
+        // data can't hold lambdas
+        if (Is<Constant>(obj) || Is<Vector>(obj) || (Is<Cell>(obj) && As<Cell>(obj)->is_quoted)) {
+            continue;
+        }
+        children.clear();
+        obj->GetChildren(children);
+        pending.insert(pending.end(), children.begin(), children.end());
+    }
+}
+
+static bool IsFalse(const std::shared_ptr<Object>& obj) {
+    return Is<Boolean>(obj) && !As<Boolean>(obj)->GetBool();
+}
+
+std::shared_ptr<Object> Bytecode::Run() const {
+    // The stack is taken from the thread's argument stack, it stays in place while the calls
+    // made from here (builtins and procedures, which may run bytecode too) take their own slots
+    // above it. Calls get their arguments in place.
+    Arguments slots(max_depth_);
+    std::shared_ptr<Object>* top = slots.Slots().data();
+    Frame* frame = Frame::Current();
+    const Instruction* ip = code_.data();
+
+    // Replaces the callee and the n arguments above it by the result.
+    auto finish_call = [&top](std::shared_ptr<Object>* callee, size_t n,
+                              std::shared_ptr<Object> result) {
+        for (auto* arg = callee + 1; arg != callee + 1 + n; ++arg) {
+            arg->reset();
+        }
+        *callee = std::move(result);
+        top = callee + 1;
+    };
+    // CALL of the current instruction.
+    auto call_builtin = [&]() {
+        auto* first = top - ip->b;
+        auto res = Invoke(functions_[ip->a].get(), std::span(first, ip->b));
+        for (auto* arg = first; arg != top; ++arg) {
+            arg->reset();
+        }
+        *first = std::move(res);
+        top = first + 1;
+    };
+
+#if SCHEME_THREADED_DISPATCH
+    static const void* const kLabels[] = {
+        &&L_PUSH, &&L_EVAL,       &&L_LOCAL, &&L_DEFINE_LOCAL,  &&L_DEFINE_GLOBAL,
+        &&L_POP,  &&L_CALL,       &&L_CALL_NUMBERS, &&L_APPLY, &&L_TAIL_APPLY,    &&L_JUMP,
+        &&L_JUMP_IF_FALSE,        &&L_JUMP_IF_FALSE_OR_POP,     &&L_JUMP_IF_TRUE_OR_POP,
+        &&L_RETURN};
+#define VM_CASE(op) L_##op
+#define VM_DISPATCH() goto* kLabels[static_cast<uint8_t>(ip->op)]
+    VM_DISPATCH();
+#else
+#define VM_CASE(op) case OpCode::op
+#define VM_DISPATCH() goto dispatch
+dispatch:
+    switch (ip->op) {
+#endif
+
+    VM_CASE(PUSH) : {
+        *top++ = constants_[ip->a];
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(EVAL) : {
+        *top++ = constants_[ip->a]->Eval();
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(LOCAL) : {
+        *top++ = frame->Get(ip->a, ip->b);
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(DEFINE_LOCAL) : {
+        frame->Set(ip->a, std::move(top[-1]));
+        top[-1] = constants_[ip->b];
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(DEFINE_GLOBAL) : {
+        auto* environment = Environment::Current();
+        if (environment == nullptr) {
+            throw RuntimeError("define outside of an interpreter");
+        }
+        environment->Define(ip->b, std::move(top[-1]));
+        top[-1] = constants_[ip->a];
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(POP) : {
+        (--top)->reset();
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(CALL) : {
+        LimitsScope::CountStep();
+        call_builtin();
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(CALL_NUMBERS) : {
+        LimitsScope::CountStep();
+        const auto* x = As<Number>(top[-2]);
+        const auto* y = As<Number>(top[-1]);
+        if (x != nullptr && y != nullptr) {
+            top[-2] = ApplyToNumbers(functions_[ip->a]->GetKind(), x->GetValue(), y->GetValue());
+            (--top)->reset();
+        } else {
+            // the builtin reports the error
+            call_builtin();
+        }
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(APPLY) : {
+        LimitsScope::CountStep();
+        auto* callee = top - ip->b - 1;
+        std::span args(callee + 1, ip->b);
+        if (auto* closure = As<Closure>(*callee)) {
+            finish_call(callee, ip->b, closure->ApplyMoving(args));
+        } else if (auto* function = As<Function>(*callee)) {
+            finish_call(callee, ip->b, Invoke(function, args));
+        } else {
+            throw RuntimeError("not a procedure");
+        }
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(TAIL_APPLY) : {
+        LimitsScope::CountStep();
+        auto* callee = top - ip->b - 1;
+        std::span args(callee + 1, ip->b);
+        if (Is<Closure>(*callee)) {
+            Closure::TailCall(std::static_pointer_cast<Closure>(std::move(*callee)), args);
+            return nullptr;
+        } else if (auto* function = As<Function>(*callee)) {
+            finish_call(callee, ip->b, Invoke(function, args));
+        } else {
+            throw RuntimeError("not a procedure");
+        }
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(JUMP) : {
+        ip = code_.data() + ip->a;
+        VM_DISPATCH();
+    }
+    VM_CASE(JUMP_IF_FALSE) : {
+        LimitsScope::CountStep();
+        bool is_false = IsFalse(top[-1]);
+        (--top)->reset();
+        ip = is_false ? code_.data() + ip->a : ip + 1;
+        VM_DISPATCH();
+    }
+    VM_CASE(JUMP_IF_FALSE_OR_POP) : {
+        if (IsFalse(top[-1])) {
+            ip = code_.data() + ip->a;
+        } else {
+            (--top)->reset();
+            ++ip;
+        }
+        VM_DISPATCH();
+    }
+    VM_CASE(JUMP_IF_TRUE_OR_POP) : {
+        if (!IsFalse(top[-1])) {
+            ip = code_.data() + ip->a;
+        } else {
+            (--top)->reset();
+            ++ip;
+        }
+        VM_DISPATCH();
+    }
+    VM_CASE(RETURN) : {
+        return std::move(top[-1]);
+    }
+
+#if !SCHEME_THREADED_DISPATCH
+    }
+    return nullptr;
+#endif
+#undef VM_CASE
+#undef VM_DISPATCH
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+#include "object.h"
+
+enum class OpCode : uint8_t {
+    PUSH,                  // push constants[a]
+    EVAL,                  // push constants[a]->Eval(), used for global variables, lambdas and
+                           // forms the compiler doesn't know
+    LOCAL,                 // push slot b of the a-th parent of the current frame
+    DEFINE_LOCAL,          // move the top into slot a of the current frame, replace it by
+                           // constants[b] (the name)
+    DEFINE_GLOBAL,         // define the global with symbol id b as the top, replace it by
+                           // constants[a] (the name)
+    POP,                   // drop the top
+    CALL,                  // apply functions[a] to the b values on top of the stack
+    CALL_NUMBERS,          // CALL of an arithmetic or comparison builtin with b = 2, done in
+                           // place when both values are numbers
+    APPLY,                 // apply the value below the b values on top of the stack to them
+    TAIL_APPLY,            // APPLY, but a closure replaces the running call (see Closure::Run)
+    JUMP,                  // jump to a
+    JUMP_IF_FALSE,         // pop, jump to a if it was #f
+    JUMP_IF_FALSE_OR_POP,  // jump to a keeping #f on the stack, otherwise pop
+    JUMP_IF_TRUE_OR_POP,   // jump to a keeping the value if it isn't #f, otherwise pop
+    RETURN
+};
+
+struct Instruction {
+    OpCode op;
+    uint32_t a = 0;
+    uint32_t b = 0;
+};
+
+// Linear code for one expression or procedure body, evaluated on a value stack instead of
+// walking the tree. Compiling an expression also compiles the bodies of all lambdas in it, the
+// closures made from them run their Bytecode (see Closure::Run). Applications of global names at
+// top level and unknown nodes run with EVAL.
+class Bytecode {
+public:
+    explicit Bytecode(const std::shared_ptr<Object>& ast);
+
+    // The body of a lambda, the value of the last expression is returned.
+    explicit Bytecode(std::span<const std::shared_ptr<Object>> body);
+
+    // Runs in the current frame.
+    std::shared_ptr<Object> Run() const;
+
+private:
+    void Compile(const std::shared_ptr<Object>& node, bool tail);
+    void CompileApplication(const std::shared_ptr<Object>& node);
+    void CompileAndOr(const std::shared_ptr<Object>& args, bool is_and);
+    void CompileIf(const std::shared_ptr<Object>& node, bool tail);
+    void CompileLambda(const std::shared_ptr<Object>& node);
+    // Lambdas inside of a node run with EVAL.
+    void CompileLambdasIn(const std::shared_ptr<Object>& node);
+
+    void Emit(OpCode op, uint32_t a = 0, uint32_t b = 0);
+    uint32_t AddConstant(std::shared_ptr<Object> obj);
+
+    std::vector<Instruction> code_;
+    std::vector<std::shared_ptr<Object>> constants_;
+    std::vector<std::shared_ptr<Function>> functions_;
+    size_t depth_ = 0;
+    size_t max_depth_ = 0;
+};
@@ -0,0 +1,192 @@
+#include "compiled.h"
+#include "arena.h"
+
+#include <stdexcept>
+#include <dlfcn.h>
+
+namespace {
+
+// TailCall leaves the callee and the arguments here and returns, the CompiledProcedure::Apply
+// loop below it picks them up.
+struct PendingCall {
+    std::shared_ptr<CompiledProcedure> procedure;
+    std::vector<std::shared_ptr<Object>> args;
+};
+
+thread_local PendingCall pending_call;
+
+}  // namespace
+
+const CompiledProgram& LoadCompiledProgram(const std::string& path) {
+    void* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (handle == nullptr) {
+        throw std::runtime_error(dlerror());
+    }
+    void* entry = dlsym(handle, kCompiledProgramSymbol);
+    if (entry == nullptr) {
+        std::string error = path + ": no " + kCompiledProgramSymbol;
+        dlclose(handle);
+        throw std::runtime_error(error);
+    }
+    return *reinterpret_cast<const CompiledProgram* (*)()>(entry)();
+}
+
+std::shared_ptr<Object> CompiledProcedure::Apply(std::span<const std::shared_ptr<Object>> args) {
+    auto result = code_(*this, args);
+    std::shared_ptr<CompiledProcedure> callee;
+    std::vector<std::shared_ptr<Object>> callee_args;
+    while (pending_call.procedure != nullptr) {
+        callee = std::move(pending_call.procedure);
+        callee_args.swap(pending_call.args);
+        result = callee->code_(*callee, callee_args);
+    }
+    return result;
+}
+
+void CompiledProcedure::GetChildren(std::vector<Object*>& children) const {
+    for (const auto& value : captured_) {
+        if (value != nullptr) {
+            children.push_back(value.get());
+        }
+    }
+}
+
+void CompiledProcedure::ClearChildren() {
+    captured_.clear();
+}
+
+const std::vector<std::shared_ptr<Object>>& BuildConstants(std::span<const ConstantPart> parts,
+                                                           std::span<const uint32_t> elements) {
+    auto& res = *new std::vector<std::shared_ptr<Object>>();
+    res.reserve(parts.size());
+    for (const auto& part : parts) {
+        switch (part.kind) {
+            case ConstantPart::EMPTY_LIST:
+                res.push_back(nullptr);
+                break;
+            case ConstantPart::NUMBER:
+                if (part.value >= kMinSharedNumber && part.value <= kMaxSharedNumber) {
+                    res.push_back(SharedNumber(part.value));
+                } else {
+                    res.push_back(MakeImmortal(new Number(part.value)));
+                }
+                break;
+            case ConstantPart::BOOLEAN:
+                res.push_back(MakeBoolean(part.value != 0));
+                break;
+            case ConstantPart::SYMBOL:
+                res.push_back(Symbol::Intern(part.name));
+                break;
+            case ConstantPart::CELL: {
+                auto cell = MakeImmortal(new Cell(res[part.first], res[part.second]));
+                if (part.flags & ConstantPart::LIST) {
+                    cell->IsList();
+                }
+                cell->is_quoted = (part.flags & ConstantPart::QUOTED) != 0;
+                res.push_back(std::move(cell));
+                break;
+            }
+            case ConstantPart::VECTOR: {
+                std::vector<std::shared_ptr<Object>> values;
+                for (uint32_t index : elements.subspan(part.first, part.second)) {
+                    values.push_back(res[index]);
+                }
+                auto vector = MakeImmortal(new Vector(std::move(values)));
+                vector->MarkLiteral();
+                res.push_back(std::move(vector));
+                break;
+            }
+        }
+    }
+    return res;
+}
+
+std::shared_ptr<Function> FindBuiltin(std::string_view name) {
+    return AsShared<Function>(Symbol::Intern(name)->Eval());
+}
+
+std::shared_ptr<Object> ResolvedNode(const std::shared_ptr<Object>& tree,
+                                     std::initializer_list<uint32_t> path) {
+    // the tree gets its own arena like a prepared expression, the node keeps it alive
+    ArenaScope scope;
+    auto node = Resolve(tree);
+    for (uint32_t index : path) {
+        node = ResolvedChild(node, index);
+    }
+    return node;
+}
+
+const std::shared_ptr<Object>& ResolvedChild(const std::shared_ptr<Object>& node, size_t index) {
+    if (auto* cell = As<Cell>(node)) {
+        return index == 0 ? cell->GetFirst() : cell->GetSecond();
+    }
+    if (auto* branch = As<If>(node)) {
+        return index == 0   ? branch->GetTest()
+               : index == 1 ? branch->GetConsequent()
+                            : branch->GetAlternative();
+    }
+    if (auto* define = As<Define>(node)) {
+        return define->GetValue();
+    }
+    if (auto* call = As<Call>(node)) {
+        return index == 0 ? call->GetFunction() : call->GetArgs()[index - 1];
+    }
+    throw std::logic_error("no children in resolved node");
+}
+
+std::shared_ptr<Object> DefineGlobal(const std::shared_ptr<Symbol>& name,
+                                     std::shared_ptr<Object> value) {
+    auto* environment = Environment::Current();
+    if (environment == nullptr) {
+        throw RuntimeError("define outside of an interpreter");
+    }
+    environment->Define(name->GetId(), std::move(value));
+    return name;
+}
+
+std::shared_ptr<Object> CallProcedure(const std::shared_ptr<Object>& function,
+                                      std::span<const std::shared_ptr<Object>> args) {
+    if (!Is<Function>(function)) {
+        throw RuntimeError("not a procedure");
+    }
+    return Invoke(As<Function>(function), args);
+}
+
+std::shared_ptr<Object> TailCall(const std::shared_ptr<Object>& function,
+                                 std::span<const std::shared_ptr<Object>> args) {
+    if (!Is<CompiledProcedure>(function)) {
+        return CallProcedure(function, args);
+    }
+    pending_call.procedure = AsShared<CompiledProcedure>(function);
+    pending_call.args.assign(args.begin(), args.end());
+    return nullptr;
+}
+
+void CheckArgumentCount(size_t count, size_t params, bool rest) {
+    if (rest ? count + 1 < params : count != params) {
+        throw RuntimeError("wrong number of arguments");
+    }
+}
+
+std::shared_ptr<Object> RestArguments(std::span<const std::shared_ptr<Object>> args) {
+    std::shared_ptr<Cell> rest = nullptr;
+    for (size_t i = args.size(); i-- > 0;) {
+        rest = Make<Cell>(args[i], rest);
+    }
+    if (rest != nullptr) {
+        rest->IsList();
+    }
+    return rest;
+}
+
+int64_t ApplyForNumber(Function* function, std::initializer_list<std::shared_ptr<Object>> args) {
+    auto value = Invoke(function, std::span(args.begin(), args.size()));
+    if (!Is<Number>(value)) {
+        throw RuntimeError("not a number");
+    }
+    return As<Number>(value)->GetValue();
+}
+
+bool ApplyForTest(Function* function, std::initializer_list<std::shared_ptr<Object>> args) {
+    return IsTrue(Invoke(function, std::span(args.begin(), args.size())));
+}
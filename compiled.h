@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "eval_limits.h"
+#include "object.h"
+#include "special_forms.h"
+
+// Runtime of programs translated to C++ by schemec (see schemec.cpp). A translated program is
+// built into a shared object exporting kCompiledProgramSymbol, the process loading it must
+// export the library's symbols (e.g. be linked with -rdynamic) so both use the same symbol
+// table, heaps and builtins.
+
+// One top-level form of a program.
+struct CompiledForm {
+    // Evaluates the form, nullptr for a form that is interpreted.
+    std::shared_ptr<Object> (*run)();
+    // The form as read.
+    const std::shared_ptr<Object>& (*tree)();
+};
+
+struct CompiledProgram {
+    std::span<const CompiledForm> forms;
+};
+
+// Function with C linkage returning the program.
+constexpr const char* kCompiledProgramSymbol = "SchemeCompiledProgram";
+
+// Loads a shared object built from schemec's output, it stays loaded until the process exits.
+const CompiledProgram& LoadCompiledProgram(const std::string& path);
+
+// A lambda translated to a C++ function. Variables of enclosing procedures are captured by
+// value, unless a define can change them later, then the procedure shares a box with them.
+class CompiledProcedure final : public Function {
+public:
+    static constexpr FunctionKind kKind = FunctionKind::COMPILED_PROCEDURE;
+
+    using Code = std::shared_ptr<Object> (*)(const CompiledProcedure& self,
+                                             std::span<const std::shared_ptr<Object>> args);
+
+    CompiledProcedure(Code code, std::vector<std::shared_ptr<Object>> captured)
+        : Function(kKind), code_(code), captured_(std::move(captured)){};
+
+    const std::shared_ptr<Object>& GetCaptured(size_t index) const {
+        return captured_[index];
+    }
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
+
+    void GetChildren(std::vector<Object*>& children) const override;
+
+    void ClearChildren() override;
+
+private:
+    Code code_;
+    std::vector<std::shared_ptr<Object>> captured_;
+};
+
+//////////////////////////////// Used by the generated code
+
+// One object of the constants of a program (quoted data and the forms as read), cells and
+// vectors refer to the parts before them by index. A table of these compiles much faster than
+// as many initialisers.
+struct ConstantPart {
+    enum Kind : uint8_t { EMPTY_LIST, NUMBER, BOOLEAN, SYMBOL, CELL, VECTOR };
+    enum Flags : uint8_t { LIST = 1, QUOTED = 2 };
+
+    Kind kind;
+    // the first and the second of a cell, the start in the elements and the size of a vector
+    uint32_t first = 0;
+    uint32_t second = 0;
+    uint8_t flags = 0;
+    // a number, or a boolean
+    int64_t value = 0;
+    const char* name = nullptr;
+};
+
+// The objects are immortal, so that they don't pin the arena of the run that uses them first,
+// and stay alive until the process exits like the loaded program.
+const std::vector<std::shared_ptr<Object>>& BuildConstants(std::span<const ConstantPart> parts,
+                                                           std::span<const uint32_t> elements);
+
+std::shared_ptr<Function> FindBuiltin(std::string_view name);
+
+// Node of the resolved tree of a form, found by the indices of the children on the way (see
+// ResolvedChild), for parts of a form that are interpreted.
+std::shared_ptr<Object> ResolvedNode(const std::shared_ptr<Object>& tree,
+                                     std::initializer_list<uint32_t> path);
+
+// 0 and 1 are the first and the second of a cell, then the test, consequent and alternative of
+// an if, the value of a define, and the function and the arguments of a call.
+const std::shared_ptr<Object>& ResolvedChild(const std::shared_ptr<Object>& node, size_t index);
+
+inline bool IsTrue(const std::shared_ptr<Object>& value) {
+    return !Is<Boolean>(value) || As<Boolean>(value)->GetBool();
+}
+
+// Global define, evaluates to the name.
+std::shared_ptr<Object> DefineGlobal(const std::shared_ptr<Symbol>& name,
+                                     std::shared_ptr<Object> value);
+
+// Application of a value that isn't known to be a builtin.
+std::shared_ptr<Object> CallProcedure(const std::shared_ptr<Object>& function,
+                                      std::span<const std::shared_ptr<Object>> args);
+
+// Call in tail position of a procedure, a compiled callee runs in the loop of the Apply below,
+// so procedures calling each other that way don't grow the stack.
+std::shared_ptr<Object> TailCall(const std::shared_ptr<Object>& function,
+                                 std::span<const std::shared_ptr<Object>> args);
+
+void CheckArgumentCount(size_t count, size_t params, bool rest);
+
+// The list the rest parameter gets.
+std::shared_ptr<Object> RestArguments(std::span<const std::shared_ptr<Object>> args);
+
+inline std::shared_ptr<Frame> MakeBox(std::shared_ptr<Object> value) {
+    return Make<Frame>(nullptr, std::vector<std::shared_ptr<Object>>{std::move(value)});
+}
+
+inline const std::shared_ptr<Object>& Unbox(const std::shared_ptr<Object>& box) {
+    return static_cast<const Frame*>(box.get())->Get(0, 0);
+}
+
+// Arithmetic on unboxed numbers, wrapping around like the builtins.
+inline int64_t WrappingAdd(int64_t a, int64_t b) {
+    return static_cast<int64_t>(static_cast<uint64_t>(a) + static_cast<uint64_t>(b));
+}
+
+inline int64_t WrappingSubtract(int64_t a, int64_t b) {
+    return static_cast<int64_t>(static_cast<uint64_t>(a) - static_cast<uint64_t>(b));
+}
+
+inline int64_t WrappingMultiply(int64_t a, int64_t b) {
+    return static_cast<int64_t>(static_cast<uint64_t>(a) * static_cast<uint64_t>(b));
+}
+
+inline int64_t WrappingAbs(int64_t a) {
+    return a < 0 ? WrappingSubtract(0, a) : a;
+}
+
+inline int64_t Divide(int64_t a, int64_t b) {
+    if (b == 0) {
+        throw RuntimeError("division by zero");
+    }
+    if (b == -1 && a == std::numeric_limits<int64_t>::min()) {
+        throw RuntimeError("overflow in /");
+    }
+    return a / b;
+}
+
+// A builtin applied to arguments that aren't all numbers, for the unboxed operations: the
+// arithmetic ones throw then, the comparisons may still give a result.
+int64_t ApplyForNumber(Function* function, std::initializer_list<std::shared_ptr<Object>> args);
+bool ApplyForTest(Function* function, std::initializer_list<std::shared_ptr<Object>> args);
@@ -13,3 +13,8 @@ struct RuntimeError : public std::runtime_error {
 struct NameError : public std::runtime_error {
     using std::runtime_error::runtime_error;
 };
+
+// A run reached its step limit or deadline or was cancelled, see RunOptions.
+struct EvaluationAborted : public std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
@@ -0,0 +1,47 @@
+#include "eval_limits.h"
+#include "error.h"
+
+#include <algorithm>
+
+LimitsScope::LimitsScope(const RunOptions& options)
+    : options_(options), previous_(current_), previous_countdown_(countdown_) {
+    current_ = this;
+    StartBatch();
+}
+
+LimitsScope::~LimitsScope() {
+    current_ = previous_;
+    countdown_ = previous_countdown_;
+}
+
+void LimitsScope::StartBatch() {
+    batch_ = kCheckInterval;
+    if (options_.max_steps != 0) {
+        batch_ = std::min(batch_, options_.max_steps + 1 - steps_);
+    }
+    countdown_ = batch_;
+}
+
+// A reached limit stays reached: the next step fails again, even if the error was caught.
+void LimitsScope::Check() {
+    LimitsScope* scope = current_;
+    if (scope == nullptr) {
+        countdown_ = SIZE_MAX;
+        return;
+    }
+    scope->steps_ += scope->batch_;
+    scope->batch_ = 0;
+    countdown_ = 1;
+    const auto& options = scope->options_;
+    if (options.max_steps != 0 && scope->steps_ > options.max_steps) {
+        throw EvaluationAborted("step limit exceeded");
+    }
+    if (options.cancellation != nullptr && options.cancellation->IsCancelled()) {
+        throw EvaluationAborted("evaluation cancelled");
+    }
+    if (options.deadline != std::chrono::steady_clock::time_point::max() &&
+        std::chrono::steady_clock::now() >= options.deadline) {
+        throw EvaluationAborted("deadline exceeded");
+    }
+    scope->StartBatch();
+}
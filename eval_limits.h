@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Stops runs that are cancelled from another thread.
+class CancellationToken {
+public:
+    void Cancel() {
+        cancelled_.store(true, std::memory_order_relaxed);
+    }
+
+    bool IsCancelled() const {
+        return cancelled_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<bool> cancelled_ = false;
+};
+
+// Bounds of one evaluation, a run that reaches one of them fails with EvaluationAborted.
+struct RunOptions {
+    // Steps are evaluated applications and ifs and list cells walked by builtins, 0 is no limit.
+    size_t max_steps = 0;
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    // Must outlive the run.
+    const CancellationToken* cancellation = nullptr;
+};
+
+// Applies options to the evaluations on this thread while alive. Steps are counted down in
+// batches, so a step costs a decrement and the clock and the token are only looked at once per
+// kCheckInterval steps.
+class LimitsScope {
+public:
+    explicit LimitsScope(const RunOptions& options);
+    ~LimitsScope();
+
+    LimitsScope(const LimitsScope&) = delete;
+    LimitsScope& operator=(const LimitsScope&) = delete;
+
+    // Counts one step of the innermost scope, throws once a limit is reached.
+    static void CountStep() {
+        if (--countdown_ == 0) {
+            Check();
+        }
+    }
+
+private:
+    static constexpr size_t kCheckInterval = 1024;
+
+    static void Check();
+
+    void StartBatch();
+
+    static inline thread_local LimitsScope* current_ = nullptr;
+    // steps left in the current batch, without a scope there is no end to the batch
+    static inline thread_local size_t countdown_ = SIZE_MAX;
+
+    RunOptions options_;
+    // in the finished batches
+    size_t steps_ = 0;
+    size_t batch_ = 0;
+    LimitsScope* previous_;
+    size_t previous_countdown_;
+};
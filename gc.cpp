@@ -0,0 +1,137 @@
+#include "gc.h"
+
+#include <algorithm>
+#include "object.h"
+
+Heap& Heap::Current() {
+    static thread_local Heap heap;
+    return heap;
+}
+
+void Heap::RememberMutation(Object* obj) {
+    auto weak = obj->weak_from_this();
+    if (weak.expired()) {
+        // not owned by a shared_ptr yet, nothing can point back at it
+        return;
+    }
+    candidates_[obj] = std::move(weak);
+    ++mutations_since_collect_;
+    if (candidates_.size() >= prune_at_) {
+        PruneCandidates();
+    }
+}
+
+void Heap::PruneCandidates() {
+    std::erase_if(candidates_, [](const auto& entry) { return entry.second.expired(); });
+    prune_at_ = std::max(kCollectThreshold, candidates_.size() * 2);
+}
+
+void Heap::AddRoot(const std::shared_ptr<Object>* slot) {
+    roots_.push_back(slot);
+}
+
+void Heap::RemoveRoot(const std::shared_ptr<Object>* slot) {
+    auto it = std::find(roots_.begin(), roots_.end(), slot);
+    if (it != roots_.end()) {
+        roots_.erase(it);
+    }
+}
+
+void Heap::MaybeCollect() {
+    if (mutations_since_collect_ >= kCollectThreshold) {
+        Collect();
+    }
+}
+
+size_t Heap::Collect() {
+    auto start = std::chrono::steady_clock::now();
+    mutations_since_collect_ = 0;
+
+    // Everything reachable from the candidates, each pinned once so nothing dies while we look.
+    std::unordered_map<Object*, int64_t> external_refs;
+    std::vector<std::shared_ptr<Object>> pinned;
+    std::vector<Object*> children;
+    for (auto it = candidates_.begin(); it != candidates_.end();) {
+        auto candidate = it->second.lock();
+        if (candidate == nullptr) {
+            it = candidates_.erase(it);
+            continue;
+        }
+        ++it;
+        if (external_refs.contains(candidate.get())) {
+            continue;
+        }
+        external_refs[candidate.get()] = 0;
+        pinned.push_back(std::move(candidate));
+        for (size_t i = pinned.size() - 1; i < pinned.size(); ++i) {
+            children.clear();
+            pinned[i]->GetChildren(children);
+            for (Object* child : children) {
+                if (external_refs.contains(child)) {
+                    continue;
+                }
+                if (auto pin = child->weak_from_this().lock()) {
+                    external_refs[child] = 0;
+                    pinned.push_back(std::move(pin));
+                }
+            }
+        }
+    }
+
+    // Subtracting references from inside the graph (and our own pin) leaves the external ones.
+    for (const auto& obj : pinned) {
+        external_refs[obj.get()] += obj.use_count() - 1;
+    }
+    for (const auto& obj : pinned) {
+        children.clear();
+        obj->GetChildren(children);
+        for (Object* child : children) {
+            auto it = external_refs.find(child);
+            if (it != external_refs.end()) {
+                --it->second;
+            }
+        }
+    }
+
+    // Externally referenced objects and roots keep alive everything they reach, -1 marks live.
+    std::vector<Object*> stack;
+    for (const auto& [obj, refs] : external_refs) {
+        if (refs > 0) {
+            stack.push_back(obj);
+        }
+    }
+    for (const auto* slot : roots_) {
+        if (external_refs.contains(slot->get())) {
+            stack.push_back(slot->get());
+        }
+    }
+    while (!stack.empty()) {
+        Object* obj = stack.back();
+        stack.pop_back();
+        auto it = external_refs.find(obj);
+        if (it == external_refs.end() || it->second == -1) {
+            continue;
+        }
+        it->second = -1;
+        children.clear();
+        obj->GetChildren(children);
+        stack.insert(stack.end(), children.begin(), children.end());
+    }
+
+    size_t collected = 0;
+    for (const auto& obj : pinned) {
+        if (external_refs[obj.get()] != -1) {
+            obj->ClearChildren();
+            candidates_.erase(obj.get());
+            ++collected;
+        }
+    }
+    pinned.clear();
+
+    auto pause = std::chrono::steady_clock::now() - start;
+    ++stats_.collections;
+    stats_.objects_collected += collected;
+    stats_.last_pause = std::chrono::duration_cast<std::chrono::nanoseconds>(pause);
+    stats_.total_pause += stats_.last_pause;
+    return collected;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "arena.h"
+#include "profile.h"
+
+class Object;
+
+struct GcStats {
+    size_t collections = 0;
+    size_t objects_allocated = 0;
+    size_t bytes_allocated = 0;
+    size_t objects_collected = 0;
+    std::chrono::nanoseconds last_pause{0};
+    std::chrono::nanoseconds total_pause{0};
+};
+
+// Objects are freed by the reference counts of their shared_ptrs, this is a cycle collector on
+// top of them, not a tracing collector: every copy of a pointer still updates its count. A
+// cycle can only appear after an object already in the graph is mutated to point at another
+// one. Mutated objects are remembered as candidates, and Collect does trial deletion on the
+// graph reachable from them: it subtracts the references from inside the graph from the counts,
+// objects left without external references (that aren't registered roots or reached from one
+// that has them) are cyclic garbage, their references get cleared so the counts free them.
+//
+// Replacing the counts by a tracing collector means more than a new Heap: the native stack holds
+// shared_ptrs that aren't registered roots, frames are refilled in place when their count says
+// nothing else holds them (Closure::MakeFrame), and arena memory is given back when the counts
+// of its objects drop.
+class Heap {
+public:
+    // Heap of the current thread, objects and candidates aren't shared between threads.
+    // Immortal objects never take part in collection.
+    static Heap& Current();
+
+    // Called after obj gets a reference to an object that may be older than itself.
+    void RememberMutation(Object* obj);
+
+    // Objects held in registered slots are never collected, registering a slot twice is allowed.
+    void AddRoot(const std::shared_ptr<Object>* slot);
+    void RemoveRoot(const std::shared_ptr<Object>* slot);
+
+    // Returns the number of objects found to be garbage.
+    size_t Collect();
+
+    // Collects if enough mutations were seen since the last collection, called between runs.
+    void MaybeCollect();
+
+    const GcStats& Stats() const {
+        return stats_;
+    }
+
+    void NoteAllocation(size_t bytes) {
+        ++stats_.objects_allocated;
+        stats_.bytes_allocated += bytes;
+    }
+
+private:
+    static constexpr size_t kCollectThreshold = 4096;
+
+    // A dead candidate's memory is allocated with its control block, so it isn't freed while
+    // the weak pointer is kept. Long runs mutating many short-lived objects (like forcing the
+    // promises of a stream) drop them whenever the candidates doubled.
+    void PruneCandidates();
+
+    std::unordered_map<Object*, std::weak_ptr<Object>> candidates_;
+    std::vector<const std::shared_ptr<Object>*> roots_;
+    size_t mutations_since_collect_ = 0;
+    size_t prune_at_ = kCollectThreshold;
+    GcStats stats_;
+};
+
+// For objects that are never freed (builtins, #t/#f, interned symbols). The pointer has no
+// control block, so copies don't touch a reference count shared between threads.
+template <class T>
+std::shared_ptr<T> MakeImmortal(T* obj) {
+    return std::shared_ptr<T>(std::shared_ptr<T>(), obj);
+}
+
+// Allocation entry point for interpreter objects.
+template <class T, class... Args>
+std::shared_ptr<T> Make(Args&&... args) {
+    Heap::Current().NoteAllocation(sizeof(T));
+    CountAllocation(T::kType);
+    if (Arena* arena = Arena::Current(); arena != nullptr && !arena->IsFull()) {
+        return std::allocate_shared<T>(ArenaAllocator<T>(arena), std::forward<Args>(args)...);
+    }
+    return std::make_shared<T>(std::forward<Args>(args)...);
+}
@@ -0,0 +1,209 @@
+#include "hash_table.h"
+
+#include <algorithm>
+
+namespace {
+
+constexpr size_t kMinSlots = 8;
+
+// The expected size is only a hint, larger tables grow as keys are added.
+constexpr int64_t kMaxExpectedSize = 1 << 24;
+
+// At most 3/4 of the slots are used, so probe sequences stay short.
+bool IsOverloaded(size_t size, size_t slots) {
+    return size * 4 > slots * 3;
+}
+
+// Finaliser of splitmix64, neighbouring numbers and ids end up in unrelated slots.
+uint64_t Mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+    return x ^ (x >> 31);
+}
+
+bool IsSameKey(const Object* a, const Object* b) {
+    if (a == b) {
+        return true;
+    }
+    return Is<Number>(a) && Is<Number>(b) &&
+           static_cast<const Number*>(a)->GetValue() == static_cast<const Number*>(b)->GetValue();
+}
+
+HashTable* TableArg(std::span<const std::shared_ptr<Object>> args, size_t min_count,
+                    size_t max_count, const char* name) {
+    if (args.size() < min_count || args.size() > max_count || !Is<HashTable>(args.front())) {
+        throw RuntimeError(std::string("bad args for ") + name);
+    }
+    return As<HashTable>(args.front());
+}
+
+HashTable* ModifiableTableArg(std::span<const std::shared_ptr<Object>> args, size_t count,
+                              const char* name) {
+    auto* table = TableArg(args, count, count, name);
+    if (!table->IsModifiable()) {
+        throw RuntimeError(std::string(name) + " of a hash table shared by batch items");
+    }
+    return table;
+}
+
+}  // namespace
+
+HashTable::HashTable(size_t capacity) : Object(kType) {
+    size_t slots = kMinSlots;
+    while (IsOverloaded(capacity, slots)) {
+        slots *= 2;
+    }
+    hashes_.resize(slots);
+    entries_.resize(slots);
+}
+
+uint64_t HashTable::Hash(const Object* key) {
+    uint64_t hash;
+    if (Is<Number>(key)) {
+        hash = Mix(static_cast<const Number*>(key)->GetValue());
+    } else if (Is<Symbol>(key)) {
+        hash = Mix(static_cast<const Symbol*>(key)->GetId() ^ 0x9e3779b97f4a7c15);
+    } else {
+        hash = Mix(reinterpret_cast<uintptr_t>(key));
+    }
+    return hash == 0 ? 1 : hash;
+}
+
+size_t HashTable::Probe(const std::shared_ptr<Object>& key, uint64_t hash) const {
+    size_t mask = hashes_.size() - 1;
+    for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+        if (hashes_[slot] == 0 ||
+            (hashes_[slot] == hash && IsSameKey(entries_[slot].key.get(), key.get()))) {
+            return slot;
+        }
+    }
+}
+
+void HashTable::Rehash(size_t slots) {
+    std::vector<uint64_t> hashes(slots);
+    std::vector<Entry> entries(slots);
+    hashes.swap(hashes_);
+    entries.swap(entries_);
+    size_t mask = slots - 1;
+    for (size_t i = 0; i < hashes.size(); ++i) {
+        if (hashes[i] == 0) {
+            continue;
+        }
+        size_t slot = hashes[i] & mask;
+        while (hashes_[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        hashes_[slot] = hashes[i];
+        entries_[slot] = std::move(entries[i]);
+    }
+}
+
+const std::shared_ptr<Object>* HashTable::Find(const std::shared_ptr<Object>& key) const {
+    size_t slot = Probe(key, Hash(key.get()));
+    return hashes_[slot] == 0 ? nullptr : &entries_[slot].value;
+}
+
+void HashTable::Set(const std::shared_ptr<Object>& key, std::shared_ptr<Object> value) {
+    uint64_t hash = Hash(key.get());
+    size_t slot = Probe(key, hash);
+    if (hashes_[slot] == 0) {
+        if (IsOverloaded(size_ + 1, hashes_.size())) {
+            Rehash(hashes_.size() * 2);
+            slot = Probe(key, hash);
+        }
+        hashes_[slot] = hash;
+        entries_[slot].key = key;
+        ++size_;
+    }
+    entries_[slot].value = std::move(value);
+    Heap::Current().RememberMutation(this);
+}
+
+// An entry after the hole moves into it unless its own slot lies between the hole and it, in
+// which case moving it would put it before the start of its probe sequence.
+bool HashTable::Erase(const std::shared_ptr<Object>& key) {
+    size_t hole = Probe(key, Hash(key.get()));
+    if (hashes_[hole] == 0) {
+        return false;
+    }
+    size_t mask = hashes_.size() - 1;
+    for (size_t slot = (hole + 1) & mask; hashes_[slot] != 0; slot = (slot + 1) & mask) {
+        size_t home = hashes_[slot] & mask;
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            hashes_[hole] = hashes_[slot];
+            entries_[hole] = std::move(entries_[slot]);
+            hole = slot;
+        }
+    }
+    hashes_[hole] = 0;
+    entries_[hole] = {};
+    --size_;
+    return true;
+}
+
+void HashTable::GetChildren(std::vector<Object*>& children) const {
+    for (size_t slot = 0; slot < hashes_.size(); ++slot) {
+        if (hashes_[slot] == 0) {
+            continue;
+        }
+        if (entries_[slot].key != nullptr) {
+            children.push_back(entries_[slot].key.get());
+        }
+        if (entries_[slot].value != nullptr) {
+            children.push_back(entries_[slot].value.get());
+        }
+    }
+}
+
+void HashTable::ClearChildren() {
+    std::fill(hashes_.begin(), hashes_.end(), 0);
+    for (auto& entry : entries_) {
+        entry = {};
+    }
+    size_ = 0;
+}
+
+std::shared_ptr<Object> HashTable::Eval() {
+    return Self();
+}
+
+std::string HashTable::Serialise() {
+    return "#<hash-table>";
+}
+
+//////////////////////////////// Builtins
+
+std::shared_ptr<Object> MakeHashTable::Apply(std::span<const std::shared_ptr<Object>> args) {
+    if (args.empty()) {
+        return Make<HashTable>();
+    }
+    if (args.size() > 1 || !Is<Number>(args.front()) || As<Number>(args.front())->GetValue() < 0) {
+        throw RuntimeError("bad args for make-hash-table");
+    }
+    return Make<HashTable>(std::min(As<Number>(args.front())->GetValue(), kMaxExpectedSize));
+}
+
+std::shared_ptr<Object> HashTableRef::Apply(std::span<const std::shared_ptr<Object>> args) {
+    auto* table = TableArg(args, 2, 3, "hash-table-ref");
+    if (const auto* value = table->Find(args[1])) {
+        return *value;
+    }
+    if (args.size() == 3) {
+        return args[2];
+    }
+    throw RuntimeError("no such key in hash-table-ref");
+}
+
+std::shared_ptr<Object> HashTableSet::Apply(std::span<const std::shared_ptr<Object>> args) {
+    ModifiableTableArg(args, 3, "hash-table-set!")->Set(args[1], args[2]);
+    return args.front();
+}
+
+std::shared_ptr<Object> HashTableDelete::Apply(std::span<const std::shared_ptr<Object>> args) {
+    ModifiableTableArg(args, 2, "hash-table-delete!")->Erase(args[1]);
+    return args.front();
+}
+
+std::shared_ptr<Object> HashTableCount::Apply(std::span<const std::shared_ptr<Object>> args) {
+    return MakeNumber(TableArg(args, 1, 1, "hash-table-count")->Size());
+}
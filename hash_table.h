@@ -0,0 +1,112 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "object.h"
+
+// Mutable map from keys to values. Numbers are compared by value, everything else (interned
+// symbols, the two booleans, lists) by identity.
+//
+// Open addressing with linear probing: the hashes are kept in an array of their own, so a
+// lookup scans adjacent words and only compares keys whose hash matches. Deletion shifts the
+// following entries back instead of leaving tombstones.
+class HashTable final : public Object {
+public:
+    static constexpr ObjectType kType = ObjectType::HASH_TABLE;
+
+    // Room for capacity keys without growing.
+    explicit HashTable(size_t capacity = 0);
+
+    size_t Size() const {
+        return size_;
+    }
+
+    // nullptr if the key isn't in the table.
+    const std::shared_ptr<Object>* Find(const std::shared_ptr<Object>& key) const;
+
+    bool IsModifiable() const {
+        return BatchItemScope::MayModify(batch_item_);
+    }
+
+    void Set(const std::shared_ptr<Object>& key, std::shared_ptr<Object> value);
+
+    // Returns whether the key was in the table.
+    bool Erase(const std::shared_ptr<Object>& key);
+
+    void GetChildren(std::vector<Object*>& children) const override;
+
+    void ClearChildren() override;
+
+    std::shared_ptr<Object> Eval() override;
+
+    std::string Serialise() override;
+
+private:
+    struct Entry {
+        std::shared_ptr<Object> key;
+        std::shared_ptr<Object> value;
+    };
+
+    // 0 marks an empty slot, Hash never returns it.
+    static uint64_t Hash(const Object* key);
+
+    // Slot of the key or the empty slot where it would be inserted.
+    size_t Probe(const std::shared_ptr<Object>& key, uint64_t hash) const;
+
+    void Rehash(size_t slots);
+
+    std::vector<uint64_t> hashes_;
+    std::vector<Entry> entries_;
+    size_t size_ = 0;
+    const uint32_t batch_item_ = BatchItemScope::Current();
+};
+
+// (make-hash-table) or (make-hash-table expected-size)
+class MakeHashTable final : public Function {
+public:
+    static constexpr FunctionKind kKind = FunctionKind::MAKE_HASH_TABLE;
+
+    MakeHashTable() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
+};
+
+// (hash-table-ref table key) fails if the key is missing, (hash-table-ref table key default)
+// returns default.
+class HashTableRef final : public Function {
+public:
+    static constexpr FunctionKind kKind = FunctionKind::HASH_TABLE_REF;
+
+    HashTableRef() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
+};
+
+// Returns the table.
+class HashTableSet final : public Function {
+public:
+    static constexpr FunctionKind kKind = FunctionKind::HASH_TABLE_SET;
+
+    HashTableSet() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
+};
+
+// Returns the table, deleting a missing key does nothing.
+class HashTableDelete final : public Function {
+public:
+    static constexpr FunctionKind kKind = FunctionKind::HASH_TABLE_DELETE;
+
+    HashTableDelete() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
+};
+
+class HashTableCount final : public Function {
+public:
+    static constexpr FunctionKind kKind = FunctionKind::HASH_TABLE_COUNT;
+
+    HashTableCount() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
+};
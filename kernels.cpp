@@ -0,0 +1,184 @@
+#include "kernels.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define SCHEME_AVX2_KERNELS 1
+#include <immintrin.h>
+#else
+#define SCHEME_AVX2_KERNELS 0
+#endif
+
+namespace {
+
+// Shorter inputs aren't worth the vector setup.
+constexpr size_t kMinVectorSize = 16;
+
+int64_t WrappingAdd(int64_t a, int64_t b) {
+    return static_cast<int64_t>(static_cast<uint64_t>(a) + static_cast<uint64_t>(b));
+}
+
+template <Order order>
+bool InOrder(int64_t a, int64_t b) {
+    if constexpr (order == Order::INCREASING) {
+        return a < b;
+    } else if constexpr (order == Order::NON_DECREASING) {
+        return a <= b;
+    } else if constexpr (order == Order::DECREASING) {
+        return a > b;
+    } else if constexpr (order == Order::NON_INCREASING) {
+        return a >= b;
+    } else {
+        return a == b;
+    }
+}
+
+template <Order order>
+bool IsOrderedScalar(std::span<const int64_t> values, size_t start) {
+    for (size_t i = start + 1; i < values.size(); ++i) {
+        if (!InOrder<order>(values[i - 1], values[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#if SCHEME_AVX2_KERNELS
+
+bool HasAvx2() {
+    static const bool kHasAvx2 = __builtin_cpu_supports("avx2");
+    return kHasAvx2;
+}
+
+__attribute__((target("avx2"))) __m256i Load(const int64_t* ptr) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr));
+}
+
+__attribute__((target("avx2"))) int64_t SumAvx2(std::span<const int64_t> values) {
+    __m256i first = _mm256_setzero_si256();
+    __m256i second = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= values.size(); i += 8) {
+        first = _mm256_add_epi64(first, Load(&values[i]));
+        second = _mm256_add_epi64(second, Load(&values[i + 4]));
+    }
+    alignas(32) int64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), _mm256_add_epi64(first, second));
+    int64_t res = 0;
+    for (int64_t lane : lanes) {
+        res = WrappingAdd(res, lane);
+    }
+    for (; i < values.size(); ++i) {
+        res = WrappingAdd(res, values[i]);
+    }
+    return res;
+}
+
+// There is no 64-bit min/max before AVX-512, the larger lanes are selected by a comparison.
+template <bool is_max>
+__attribute__((target("avx2"))) int64_t ExtremumAvx2(std::span<const int64_t> values) {
+    __m256i res = _mm256_set1_epi64x(values[0]);
+    size_t i = 0;
+    for (; i + 4 <= values.size(); i += 4) {
+        __m256i value = Load(&values[i]);
+        __m256i take = is_max ? _mm256_cmpgt_epi64(value, res) : _mm256_cmpgt_epi64(res, value);
+        res = _mm256_blendv_epi8(res, value, take);
+    }
+    alignas(32) int64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), res);
+    int64_t extremum = lanes[0];
+    for (int64_t lane : lanes) {
+        extremum = is_max ? std::max(extremum, lane) : std::min(extremum, lane);
+    }
+    for (; i < values.size(); ++i) {
+        extremum = is_max ? std::max(extremum, values[i]) : std::min(extremum, values[i]);
+    }
+    return extremum;
+}
+
+// Compares values[i..i+3] with values[i+1..i+4] lane by lane.
+template <Order order>
+__attribute__((target("avx2"))) bool IsOrderedAvx2(std::span<const int64_t> values) {
+    size_t i = 0;
+    for (; i + 5 <= values.size(); i += 4) {
+        __m256i a = Load(&values[i]);
+        __m256i b = Load(&values[i + 1]);
+        __m256i holds;
+        if constexpr (order == Order::INCREASING) {
+            holds = _mm256_cmpgt_epi64(b, a);
+        } else if constexpr (order == Order::NON_DECREASING) {
+            holds = _mm256_xor_si256(_mm256_cmpgt_epi64(a, b), _mm256_set1_epi64x(-1));
+        } else if constexpr (order == Order::DECREASING) {
+            holds = _mm256_cmpgt_epi64(a, b);
+        } else if constexpr (order == Order::NON_INCREASING) {
+            holds = _mm256_xor_si256(_mm256_cmpgt_epi64(b, a), _mm256_set1_epi64x(-1));
+        } else {
+            holds = _mm256_cmpeq_epi64(a, b);
+        }
+        if (_mm256_movemask_pd(_mm256_castsi256_pd(holds)) != 0xF) {
+            return false;
+        }
+    }
+    return IsOrderedScalar<order>(values, i);
+}
+
+#endif
+
+template <Order order>
+bool IsOrderedDispatch(std::span<const int64_t> values) {
+#if SCHEME_AVX2_KERNELS
+    if (values.size() >= kMinVectorSize && HasAvx2()) {
+        return IsOrderedAvx2<order>(values);
+    }
+#endif
+    return IsOrderedScalar<order>(values, 0);
+}
+
+}  // namespace
+
+int64_t SumOf(std::span<const int64_t> values) {
+#if SCHEME_AVX2_KERNELS
+    if (values.size() >= kMinVectorSize && HasAvx2()) {
+        return SumAvx2(values);
+    }
+#endif
+    int64_t res = 0;
+    for (int64_t value : values) {
+        res = WrappingAdd(res, value);
+    }
+    return res;
+}
+
+int64_t MaxOf(std::span<const int64_t> values) {
+#if SCHEME_AVX2_KERNELS
+    if (values.size() >= kMinVectorSize && HasAvx2()) {
+        return ExtremumAvx2<true>(values);
+    }
+#endif
+    return *std::max_element(values.begin(), values.end());
+}
+
+int64_t MinOf(std::span<const int64_t> values) {
+#if SCHEME_AVX2_KERNELS
+    if (values.size() >= kMinVectorSize && HasAvx2()) {
+        return ExtremumAvx2<false>(values);
+    }
+#endif
+    return *std::min_element(values.begin(), values.end());
+}
+
+bool IsOrdered(std::span<const int64_t> values, Order order) {
+    switch (order) {
+        case Order::INCREASING:
+            return IsOrderedDispatch<Order::INCREASING>(values);
+        case Order::NON_DECREASING:
+            return IsOrderedDispatch<Order::NON_DECREASING>(values);
+        case Order::DECREASING:
+            return IsOrderedDispatch<Order::DECREASING>(values);
+        case Order::NON_INCREASING:
+            return IsOrderedDispatch<Order::NON_INCREASING>(values);
+        case Order::EQUAL:
+            return IsOrderedDispatch<Order::EQUAL>(values);
+    }
+    return true;
+}
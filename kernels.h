@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+// Loops of the arithmetic and comparison builtins over unboxed arguments. They use AVX2 when the
+// CPU has it and plain loops otherwise, overflow wraps around in both.
+
+int64_t SumOf(std::span<const int64_t> values);
+
+// values must not be empty.
+int64_t MaxOf(std::span<const int64_t> values);
+int64_t MinOf(std::span<const int64_t> values);
+
+// Relation that must hold between every two neighbouring values.
+enum class Order : uint8_t { INCREASING, NON_DECREASING, DECREASING, NON_INCREASING, EQUAL };
+
+bool IsOrdered(std::span<const int64_t> values, Order order);
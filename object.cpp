@@ -1,27 +1,108 @@
 #include "object.h"
+#include "eval_limits.h"
+#include "hash_table.h"
+#include "kernels.h"
+#include "special_forms.h"
+#include "stream.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <shared_mutex>
+#include <span>
+#include <unordered_set>
+
+//////////////////////////////// BatchItemScope
+
+BatchItemScope::BatchItemScope() : previous_(current_) {
+    static std::atomic<uint32_t> last_item = 0;
+    do {
+        current_ = last_item.fetch_add(1, std::memory_order_relaxed) + 1;
+    } while (current_ == 0);
+}
+
+BatchItemScope::~BatchItemScope() {
+    current_ = previous_;
+}
 
 //////////////////////////////// Eval
 
+std::shared_ptr<Object> Object::Self() {
+    if (auto self = weak_from_this().lock()) {
+        return self;
+    }
+    return MakeImmortal(this);
+}
+
 std::shared_ptr<Object> Number::Eval() {
-    return std::make_shared<Number>(GetValue());
+    return Self();
 }
 
+// Builtins, then global variables, an unknown name evaluates to itself.
 std::shared_ptr<Object> Symbol::Eval() {
-    if (functions_map.contains(name_)) {
-        return functions_map[name_];
-    } else {
-        return std::make_shared<Symbol>(name_);
+    const auto& builtins = FunctionsMap();
+    if (id_ < builtins.size()) {
+        return builtins[id_].function;
     }
+    if (auto* environment = Environment::Current()) {
+        if (const auto* value = environment->Find(id_)) {
+            return *value;
+        }
+    }
+    return Self();
+}
+
+bool Symbol::IsBuiltin() const {
+    return id_ < FunctionsMap().size();
 }
 
 std::shared_ptr<Object> Boolean::Eval() {
-    return std::make_shared<Boolean>(GetBool());
+    return Self();
+}
+
+std::shared_ptr<Object> Vector::Eval() {
+    return Self();
+}
+
+namespace {
+
+// Evaluates the arguments of an application (unless the function takes them as they are) into
+// slots of the argument stack. A dotted tail is one more argument.
+std::shared_ptr<Object> ApplyToArgs(Function* function, const std::shared_ptr<Object>& args_node,
+                                    bool evaluate) {
+    size_t count = 0;
+    const std::shared_ptr<Object>* rest = &args_node;
+    for (; Is<Cell>(*rest); rest = &As<Cell>(*rest)->GetSecond()) {
+        ++count;
+    }
+    Arguments args(count + (*rest != nullptr));
+    auto slots = args.Slots();
+    rest = &args_node;
+    for (size_t i = 0; i < count; ++i) {
+        const auto& arg = As<Cell>(*rest)->GetFirst();
+        slots[i] = evaluate ? Evaluate(arg) : arg;
+        rest = &As<Cell>(*rest)->GetSecond();
+    }
+    if (*rest != nullptr) {
+        slots[count] = evaluate ? (*rest)->Eval() : *rest;
+    }
+    if (auto* closure = As<Closure>(function)) {
+        return closure->ApplyMoving(slots);
+    }
+    return Invoke(function, slots);
 }
 
+}  // namespace
+
 std::shared_ptr<Object> Cell::Eval() {
     if (is_quoted) {
-        return shared_from_this();
+        return Self();
     }
+    CountEvaluatedNode();
+    LimitsScope::CountStep();
     if (GetFirst() == nullptr && GetSecond() == nullptr) {
         throw RuntimeError("robin");
     }
@@ -30,23 +111,17 @@ std::shared_ptr<Object> Cell::Eval() {
     }
     if (Is<Symbol>(GetFirst())) {
         auto func = GetFirst()->Eval();
-        std::vector<std::shared_ptr<Object>> args;
-        if (Is<Quote>(func)) {
-            args.push_back(GetSecond());
-        } else if (Is<And>(func) || Is<Or>(func)) {
-            TreeToVectorNoEval(GetSecond(), args);
-        } else {
-            if (GetSecond() != nullptr) {
-                if (GetSecond()->Eval() == nullptr) {
-                    args.push_back(nullptr);
-                } else {
-                    TreeToVector(GetSecond()->Eval(), args);
-                }
+        if (auto* function = As<Function>(func)) {
+            switch (function->GetKind()) {
+                case FunctionKind::QUOTE:
+                    return Invoke(function, {&GetSecond(), 1});
+                case FunctionKind::AND:
+                case FunctionKind::OR:
+                    return ApplyToArgs(function, GetSecond(), false);
+                default:
+                    return ApplyToArgs(function, GetSecond(), true);
             }
         }
-        if (Is<Function>(func)) {
-            return As<Function>(func)->Apply(args);
-        }
     }
     if (GetSecond() == nullptr) {
         return GetFirst()->Eval();
@@ -54,7 +129,12 @@ std::shared_ptr<Object> Cell::Eval() {
     if (GetFirst() == nullptr) {
         throw RuntimeError("batman");
     }
-    return std::make_shared<Cell>(GetFirst()->Eval(), GetSecond()->Eval());
+    // e.g. ((make-adder 1) 2)
+    auto first = GetFirst()->Eval();
+    if (auto* function = As<Function>(first)) {
+        return ApplyToArgs(function, GetSecond(), true);
+    }
+    return Make<Cell>(first, GetSecond()->Eval());
 }
 
 ///////////////////////////////// Serialise
@@ -77,133 +157,422 @@ std::string Symbol::Serialise() {
 
 std::string Cell::Serialise() {
     std::string res;
-    if (is_list_) {
-        res = '(';
-    }
-    SerialiseInsideOfBrackets(std::make_shared<Cell>(*this), res);
-    if (is_list_) {
-        res.push_back(')');
-    }
+    SerialiseTo(this, res);
     return res;
 }
 
-void Cell::SerialiseInsideOfBrackets(std::shared_ptr<Object> node, std::string& str) {
-    if (!Is<Cell>(node)) {
-        str += node->Serialise();
+std::string Vector::Serialise() {
+    std::string res;
+    SerialiseTo(this, res);
+    return res;
+}
+
+std::string Function::Serialise() {
+    return "#<procedure>";
+}
+
+namespace {
+
+enum class SerialiseStep : uint8_t {
+    OBJECT,
+    INSIDE_OF_BRACKETS,
+    SECOND,
+    SPACE,
+    CLOSE,
+    CLOSE_VECTOR
+};
+
+void AppendAtom(Object* obj, std::string& out) {
+    switch (obj->GetType()) {
+        case ObjectType::NUMBER: {
+            char digits[24];
+            auto end = std::to_chars(digits, std::end(digits), As<Number>(obj)->GetValue()).ptr;
+            out.append(digits, end);
+            break;
+        }
+        case ObjectType::SYMBOL:
+            out += As<Symbol>(obj)->GetName();
+            break;
+        case ObjectType::BOOLEAN:
+            out += As<Boolean>(obj)->GetBool() ? "#t" : "#f";
+            break;
+        default:
+            out += obj->Serialise();
     }
+}
+
+}  // namespace
 
-    // Left son
-    if (Is<Cell>(As<Cell>(node)->GetFirst())) {
-        if (!str.empty() && str.back() != '(') {
-            str.push_back(' ');
+// A cell marked as a list is printed in brackets, its contents are the first element followed
+// by the second one: a cell without brackets (unless it is a dotted pair marked as a list), or
+// " . " and an atom. Pending steps are kept on a stack, so long and deep lists are printed in
+// one pass without recursion. Vectors are printed as #( and their elements separated by spaces,
+// a vector inside of itself as #(...).
+void SerialiseTo(Object* obj, std::string& out) {
+    static thread_local std::vector<std::pair<SerialiseStep, Object*>> stack;
+    static thread_local std::unordered_set<Object*> open_vectors;
+    size_t bottom = stack.size();
+    stack.emplace_back(SerialiseStep::OBJECT, obj);
+    while (stack.size() > bottom) {
+        auto [step, node] = stack.back();
+        stack.pop_back();
+        switch (step) {
+            case SerialiseStep::OBJECT:
+                if (node == nullptr) {
+                    out += "()";
+                    break;
+                }
+                if (auto* vector = As<Vector>(node)) {
+                    if (!open_vectors.insert(node).second) {
+                        out += "#(...)";
+                        break;
+                    }
+                    out += "#(";
+                    stack.emplace_back(SerialiseStep::CLOSE_VECTOR, node);
+                    const auto& elements = vector->GetElements();
+                    for (size_t i = elements.size(); i-- > 0;) {
+                        stack.emplace_back(SerialiseStep::OBJECT, elements[i].get());
+                        if (i > 0) {
+                            stack.emplace_back(SerialiseStep::SPACE, nullptr);
+                        }
+                    }
+                    break;
+                }
+                if (!Is<Cell>(node)) {
+                    AppendAtom(node, out);
+                    break;
+                }
+                if (As<Cell>(node)->IsListMarked()) {
+                    out.push_back('(');
+                    stack.emplace_back(SerialiseStep::CLOSE, nullptr);
+                }
+                stack.emplace_back(SerialiseStep::INSIDE_OF_BRACKETS, node);
+                break;
+            case SerialiseStep::INSIDE_OF_BRACKETS: {
+                auto* cell = As<Cell>(node);
+                stack.emplace_back(SerialiseStep::SECOND, cell);
+                if (cell->GetFirst() == nullptr) {
+                    out += "()";
+                } else {
+                    stack.emplace_back(SerialiseStep::OBJECT, cell->GetFirst().get());
+                }
+                break;
+            }
+            case SerialiseStep::SECOND: {
+                auto* cell = As<Cell>(node);
+                auto* second = cell->GetSecond().get();
+                if (second == nullptr) {
+                    break;
+                }
+                if (Is<Cell>(second)) {
+                    out.push_back(' ');
+                    stack.emplace_back(As<Cell>(second)->CellWithDot()
+                                           ? SerialiseStep::INSIDE_OF_BRACKETS
+                                           : SerialiseStep::OBJECT,
+                                       second);
+                } else {
+                    out += cell->CellWithDot() ? " . " : " ";
+                    stack.emplace_back(SerialiseStep::OBJECT, second);
+                }
+                break;
+            }
+            case SerialiseStep::SPACE:
+                out.push_back(' ');
+                break;
+            case SerialiseStep::CLOSE:
+                out.push_back(')');
+                break;
+            case SerialiseStep::CLOSE_VECTOR:
+                open_vectors.erase(node);
+                out.push_back(')');
+                break;
         }
-        if (As<Cell>(As<Cell>(node)->GetFirst())->is_list_) {
-            str += As<Cell>(As<Cell>(node)->GetFirst())->Serialise();
-        } else {
-            std::string temp_str;
-            SerialiseInsideOfBrackets(As<Cell>(node)->GetFirst(), temp_str);
-            str += temp_str;
+    }
+}
+
+///////////////////////////////// Registry
+// The registries are never destroyed, so immortal objects stay usable (and reachable for leak
+// checkers) until the process exits.
+const std::vector<BuiltinFunction>& FunctionsMap() {
+    static const auto* kFunctions = new std::vector<BuiltinFunction>{
+        {"number?", MakeImmortal(new IntegerPredicate()), true},
+        {"+", MakeImmortal(new Sum()), true},
+        {"-", MakeImmortal(new Subtraction()), true},
+        {"*", MakeImmortal(new Product()), true},
+        {"/", MakeImmortal(new Division()), true},
+        {"max", MakeImmortal(new Max()), true},
+        {"min", MakeImmortal(new Min()), true},
+        {"abs", MakeImmortal(new Abs()), true},
+        {">", MakeImmortal(new Decreasing()), true},
+        {">=", MakeImmortal(new DecreasingOrEqual()), true},
+        {"<", MakeImmortal(new Increasing()), true},
+        {"<=", MakeImmortal(new IncreasingOrEqual()), true},
+        {"=", MakeImmortal(new Equal()), true},
+        {"boolean?", MakeImmortal(new BooleanPredicate()), true},
+        {"not", MakeImmortal(new Not()), true},
+        {"quote", MakeImmortal(new Quote()), true},
+        {"pair?", MakeImmortal(new PairPredicate()), true},
+        {"null?", MakeImmortal(new NullPredicate()), true},
+        {"list?", MakeImmortal(new ListPredicate()), true},
+        {"cons", MakeImmortal(new Cons()), true},
+        {"car", MakeImmortal(new Car()), true},
+        {"cdr", MakeImmortal(new Cdr()), true},
+        {"list", MakeImmortal(new List()), true},
+        {"list-ref", MakeImmortal(new ListRef()), true},
+        {"list-tail", MakeImmortal(new ListTail()), true},
+        {"and", MakeImmortal(new And()), true},
+        {"or", MakeImmortal(new Or()), true},
+        // vectors can be modified, so only their lengths are constant
+        {"make-vector", MakeImmortal(new MakeVector()), false},
+        {"vector", MakeImmortal(new VectorOf()), false},
+        {"vector?", MakeImmortal(new VectorPredicate()), true},
+        {"vector-length", MakeImmortal(new VectorLength()), true},
+        {"vector-ref", MakeImmortal(new VectorRef()), false},
+        {"vector-set!", MakeImmortal(new VectorSet()), false},
+        {"vector->list", MakeImmortal(new VectorToList()), false},
+        {"list->vector", MakeImmortal(new ListToVector()), false},
+        {"make-hash-table", MakeImmortal(new MakeHashTable()), false},
+        {"hash-table-ref", MakeImmortal(new HashTableRef()), false},
+        {"hash-table-set!", MakeImmortal(new HashTableSet()), false},
+        {"hash-table-delete!", MakeImmortal(new HashTableDelete()), false},
+        {"hash-table-count", MakeImmortal(new HashTableCount()), false},
+        {"runtime-stats", MakeImmortal(new GetRuntimeStats()), false},
+        // forcing runs code
+        {"delay-thunk", MakeImmortal(new DelayThunk()), false},
+        {"force", MakeImmortal(new Force()), false},
+        {"promise?", MakeImmortal(new PromisePredicate()), false},
+        {"stream-car", MakeImmortal(new StreamCar()), false},
+        {"stream-cdr", MakeImmortal(new StreamCdr()), false},
+        {"stream-map", MakeImmortal(new StreamMap()), false},
+        {"stream-filter", MakeImmortal(new StreamFilter()), false},
+        {"stream-take", MakeImmortal(new StreamTake()), false},
+        {"stream->list", MakeImmortal(new StreamToList()), false},
+    };
+    return *kFunctions;
+}
+
+class SymbolTable {
+public:
+    static SymbolTable& Instance() {
+        static auto* table = new SymbolTable();
+        return *table;
+    }
+
+    std::shared_ptr<Symbol> Intern(std::string_view name) {
+        {
+            std::shared_lock lock(mutex_);
+            auto it = ids_.find(name);
+            if (it != ids_.end()) {
+                return symbols_[it->second];
+            }
         }
-    } else {
-        if (!str.empty() && str.back() != '(') {
-            str.push_back(' ');
+        std::unique_lock lock(mutex_);
+        auto it = ids_.find(name);
+        if (it != ids_.end()) {
+            return symbols_[it->second];
         }
-        if (As<Cell>(node)->GetFirst() != nullptr) {
-            str += As<Cell>(node)->GetFirst()->Serialise();
-        } else {
-            str += "()";
+        return Insert(name);
+    }
+
+private:
+    SymbolTable() {
+        for (const auto& builtin : FunctionsMap()) {
+            Insert(builtin.name);
         }
     }
 
-    // Right son
-    if (As<Cell>(node)->GetSecond() == nullptr) {
-        return;
+    const std::shared_ptr<Symbol>& Insert(std::string_view name) {
+        uint32_t id = symbols_.size();
+        symbols_.push_back(MakeImmortal(new Symbol(id, std::string(name))));
+        // the key points into the name owned by the symbol
+        ids_.emplace(symbols_.back()->GetName(), id);
+        return symbols_.back();
     }
 
-    if (Is<Cell>(As<Cell>(node)->GetSecond())) {
-        str.push_back(' ');
-        if (!As<Cell>(node)->CellWithDot()) {
-            if (Is<Cell>(As<Cell>(node)->GetSecond())) {
-                if (As<Cell>(As<Cell>(node)->GetSecond())->CellWithDot()) {
-                    std::string temp_str;
-                    SerialiseInsideOfBrackets(As<Cell>(node)->GetSecond(), temp_str);
-                    str += temp_str;
-                } else {
-                    str += As<Cell>(As<Cell>(node)->GetSecond())->Serialise();
-                }
-            } else {
-                str += As<Cell>(node)->GetSecond()->Serialise();
-            }
-        } else {
-            std::string temp_str;
-            SerialiseInsideOfBrackets(As<Cell>(node)->GetSecond(), temp_str);
-            str += temp_str;
+    std::shared_mutex mutex_;
+    std::vector<std::shared_ptr<Symbol>> symbols_;
+    std::unordered_map<std::string_view, uint32_t> ids_;
+};
+
+std::shared_ptr<Symbol> Symbol::Intern(std::string_view name) {
+    return SymbolTable::Instance().Intern(name);
+}
+
+///////////////////////////////// Helpers
+const std::shared_ptr<Boolean>& MakeBoolean(bool value) {
+    static const auto* kTrue = new std::shared_ptr<Boolean>(MakeImmortal(new Boolean(true)));
+    static const auto* kFalse = new std::shared_ptr<Boolean>(MakeImmortal(new Boolean(false)));
+    return value ? *kTrue : *kFalse;
+}
+
+const std::shared_ptr<Number>& SharedNumber(int64_t value) {
+    static const auto* kShared = [] {
+        auto* numbers = new std::vector<std::shared_ptr<Number>>();
+        for (int64_t i = kMinSharedNumber; i <= kMaxSharedNumber; ++i) {
+            numbers->push_back(MakeImmortal(new Number(i)));
         }
-    } else {
-        if (As<Cell>(node)->CellWithDot()) {
-            str.push_back(' ');
-            str.push_back('.');
-            str.push_back(' ');
-        } else {
-            str.push_back(' ');
+        return numbers;
+    }();
+    return (*kShared)[value - kMinSharedNumber];
+}
+
+std::shared_ptr<Object> Evaluate(const std::shared_ptr<Object>& node) {
+    if (node == nullptr) {
+        return nullptr;
+    }
+    return node->Eval();
+}
+
+// Arguments are the elements of the list, a dotted tail is taken as the last argument.
+namespace {
+
+struct ArgumentChunk {
+    std::unique_ptr<std::shared_ptr<Object>[]> slots;
+    size_t size;
+};
+
+constexpr size_t kArgumentChunkSize = 4096;
+
+// Blocks are taken from the current chunk, one that doesn't fit there goes to the next chunk
+// (a new one is made as large as needed), so a block never spans two chunks.
+struct ArgumentStack {
+    std::vector<ArgumentChunk> chunks;
+    size_t chunk = 0;
+    size_t top = 0;
+};
+
+thread_local ArgumentStack argument_stack;
+
+}  // namespace
+
+Arguments::Arguments(size_t count)
+    : count_(count), previous_chunk_(argument_stack.chunk), previous_top_(argument_stack.top) {
+    auto& stack = argument_stack;
+    while (stack.chunk == stack.chunks.size() ||
+           stack.top + count > stack.chunks[stack.chunk].size) {
+        if (stack.chunk < stack.chunks.size()) {
+            ++stack.chunk;
+            stack.top = 0;
+            continue;
         }
-        str += As<Cell>(node)->GetSecond()->Serialise();
+        size_t size = std::max(kArgumentChunkSize, count);
+        stack.chunks.push_back({std::make_unique<std::shared_ptr<Object>[]>(size), size});
     }
+    slots_ = stack.chunks[stack.chunk].slots.get() + stack.top;
+    stack.top += count;
+}
+
+Arguments::~Arguments() {
+    for (size_t i = 0; i < count_; ++i) {
+        slots_[i].reset();
+    }
+    argument_stack.chunk = previous_chunk_;
+    argument_stack.top = previous_top_;
 }
 
-///////////////////////////////// Helpers
 void TreeToVector(std::shared_ptr<Object> node, std::vector<std::shared_ptr<Object>>& res) {
+    while (Is<Cell>(node)) {
+        LimitsScope::CountStep();
+        res.push_back(Evaluate(As<Cell>(node)->GetFirst()));
+        node = As<Cell>(node)->GetSecond();
+    }
     if (node != nullptr) {
-        if (!Is<Cell>(node)) {
-            res.push_back(node->Eval());
-        } else {
-            if (As<Cell>(node)->is_quoted) {
-                res.push_back(node);
-                return;
-            }
-
-            if (As<Cell>(node)->GetFirst() != nullptr) {
-                if (Is<Cell>(As<Cell>(node)->GetFirst()) &&
-                    As<Cell>(As<Cell>(node)->GetFirst())->is_quoted) {
-                    res.push_back(As<Cell>(node)->GetFirst());
-                } else {
-                    TreeToVector(As<Cell>(node)->GetFirst()->Eval(), res);
-                }
-            }
-            if (As<Cell>(node)->GetSecond() != nullptr) {
-                if (Is<Cell>(As<Cell>(node)->GetSecond()) &&
-                    As<Cell>(As<Cell>(node)->GetSecond())->is_quoted) {
-                    res.push_back(As<Cell>(node)->GetSecond());
-                } else {
-                    TreeToVector(As<Cell>(node)->GetSecond()->Eval(), res);
-                }
-            }
-        }
+        res.push_back(node->Eval());
     }
 }
 
 void TreeToVectorNoEval(std::shared_ptr<Object> node, std::vector<std::shared_ptr<Object>>& res) {
+    while (Is<Cell>(node)) {
+        res.push_back(As<Cell>(node)->GetFirst());
+        node = As<Cell>(node)->GetSecond();
+    }
     if (node != nullptr) {
-        if (Is<Cell>(node) && !Is<Cell>(As<Cell>(node)->GetFirst()) &&
-            !Is<Symbol>(As<Cell>(node)->GetFirst())) {
-            res.push_back(As<Cell>(node)->GetFirst());
-            if (As<Cell>(node)->GetSecond() != nullptr) {
-                TreeToVectorNoEval(As<Cell>(node)->GetSecond(), res);
+        res.push_back(node);
+    }
+}
+
+void Cell::GetChildren(std::vector<Object*>& children) const {
+    if (first_ != nullptr) {
+        children.push_back(first_.get());
+    }
+    if (second_ != nullptr) {
+        children.push_back(second_.get());
+    }
+}
+
+namespace {
+
+// What lists, vectors and streams are made of.
+bool IsLink(const std::shared_ptr<Object>& obj) {
+    return Is<Cell>(obj) || Is<Vector>(obj) || Is<Promise>(obj);
+}
+
+}  // namespace
+
+// Cells, vectors and promises only referenced from the dying object are unlinked before they
+// die, so long and deep lists, nested vectors and forced streams are freed without recursion.
+void Cell::FreeLinks(std::span<std::shared_ptr<Object>> children) {
+    static thread_local std::vector<std::shared_ptr<Object>> pending;
+    size_t bottom = pending.size();
+    auto unlink = [](std::shared_ptr<Object>& child) {
+        if (IsLink(child)) {
+            pending.push_back(std::move(child));
+        }
+    };
+    for (auto& child : children) {
+        unlink(child);
+    }
+    while (pending.size() > bottom) {
+        auto obj = std::move(pending.back());
+        pending.pop_back();
+        if (obj.use_count() != 1) {
+            continue;
+        }
+        if (auto* cell = As<Cell>(obj)) {
+            unlink(cell->first_);
+            unlink(cell->second_);
+        } else if (auto* vector = As<Vector>(obj)) {
+            for (auto& element : vector->elements_) {
+                unlink(element);
             }
-        } else if (Is<Cell>(node) && !Is<Cell>(As<Cell>(node)->GetFirst()) &&
-                   Is<Symbol>(As<Cell>(node)->GetFirst())) {
-            res.push_back(node);
         } else {
-            if (As<Cell>(node)->GetFirst() != nullptr) {
-                TreeToVectorNoEval(As<Cell>(node)->GetFirst(), res);
-            }
-            if (As<Cell>(node)->GetSecond() != nullptr) {
-                TreeToVectorNoEval(As<Cell>(node)->GetSecond(), res);
+            auto* promise = As<Promise>(obj);
+            unlink(promise->value_);
+            for (auto& arg : promise->args_) {
+                unlink(arg);
             }
         }
     }
 }
 
+Cell::~Cell() {
+    if (IsLink(first_) || IsLink(second_)) {
+        std::shared_ptr<Object> children[] = {std::move(first_), std::move(second_)};
+        FreeLinks(children);
+    }
+}
+
+Vector::~Vector() {
+    Cell::FreeLinks(elements_);
+}
+
+void Cell::ClearChildren() {
+    first_.reset();
+    second_.reset();
+}
+
+void Vector::GetChildren(std::vector<Object*>& children) const {
+    for (const auto& element : elements_) {
+        if (element != nullptr) {
+            children.push_back(element.get());
+        }
+    }
+}
+
+void Vector::ClearChildren() {
+    elements_.clear();
+}
+
 bool Cell::CellWithDot() {
     if (!Is<Cell>(first_) && !Is<Cell>(second_)) {
         return true;
@@ -213,384 +582,513 @@ bool Cell::CellWithDot() {
 
 ///////////////////////////////// Functions
 
-std::shared_ptr<Object> IntegerPredicate::Apply(std::vector<std::shared_ptr<Object>> args) {
-    return std::make_shared<Boolean>(Is<Number>(args.front()));
+namespace {
+
+// Values of the numbers at the start of args, up to the first argument that isn't a number. The
+// span is valid until the next call on this thread.
+std::span<const int64_t> UnboxNumbers(std::span<const std::shared_ptr<Object>> args) {
+    static thread_local std::vector<int64_t> values;
+    values.clear();
+    for (const auto& arg : args) {
+        const auto* number = As<Number>(arg);
+        if (number == nullptr) {
+            break;
+        }
+        values.push_back(number->GetValue());
+    }
+    return values;
 }
 
-std::shared_ptr<Object> Sum::Apply(std::vector<std::shared_ptr<Object>> args) {
-    int64_t res = 0;
-    for (size_t i = 0; i < args.size(); i++) {
-        if (Is<Number>(args[i])) {
-            res += As<Number>(args[i])->GetValue();
-        } else {
-            throw RuntimeError("not number in args for +");
+// Pairs are checked from the left, so a pair out of order before a bad argument gives #f.
+std::shared_ptr<Object> Compare(std::span<const std::shared_ptr<Object>> args, Order order,
+                                const char* error) {
+    if (args.empty()) {
+        return MakeBoolean(true);
+    }
+    auto values = UnboxNumbers(args);
+    if (values.empty()) {
+        throw RuntimeError(error);
+    }
+    if (!IsOrdered(values, order)) {
+        return MakeBoolean(false);
+    }
+    if (values.size() != args.size()) {
+        throw RuntimeError(error);
+    }
+    return MakeBoolean(true);
+}
+
+// What index applications of cdr to list would give, without copying the cells on the way.
+const std::shared_ptr<Object>& NthTail(const std::shared_ptr<Object>& list, int64_t index,
+                                       const char* too_short) {
+    const std::shared_ptr<Object>* node = &list;
+    for (int64_t i = 0; i < index; ++i) {
+        if (*node == nullptr) {
+            throw RuntimeError(too_short);
+        }
+        if (!Is<Cell>(*node)) {
+            throw RuntimeError("cdr of not a pair");
         }
+        LimitsScope::CountStep();
+        node = &As<Cell>(*node)->GetSecond();
     }
-    return std::make_shared<Number>(res);
+    return *node;
 }
 
-std::shared_ptr<Object> Subtraction::Apply(std::vector<std::shared_ptr<Object>> args) {
+}  // namespace
+
+std::shared_ptr<Object> IntegerPredicate::Apply(std::span<const std::shared_ptr<Object>> args) {
+    if (args.empty()) {
+        throw RuntimeError("no args for number?");
+    }
+    return MakeBoolean(Is<Number>(args.front()));
+}
+
+std::shared_ptr<Object> Sum::Apply(std::span<const std::shared_ptr<Object>> args) {
+    auto values = UnboxNumbers(args);
+    if (values.size() != args.size()) {
+        throw RuntimeError("not number in args for +");
+    }
+    return MakeNumber(SumOf(values));
+}
+
+std::shared_ptr<Object> Subtraction::Apply(std::span<const std::shared_ptr<Object>> args) {
     if (args.empty()) {
         throw RuntimeError("No args for minus");
     }
-    int64_t res = 0;
+    // wraps around like + and *
+    uint64_t res = 0;
     for (size_t i = 0; i < args.size(); i++) {
         if (Is<Number>(args[i])) {
             if (i == 0) {
-                res = As<Number>(args[i])->GetValue();
+                res = static_cast<uint64_t>(As<Number>(args[i])->GetValue());
             } else {
-                res -= As<Number>(args[i])->GetValue();
+                res -= static_cast<uint64_t>(As<Number>(args[i])->GetValue());
             }
         } else {
             throw RuntimeError("not number in args for -");
         }
     }
-    return std::make_shared<Number>(res);
+    return MakeNumber(static_cast<int64_t>(res));
 }
 
-std::shared_ptr<Object> Product::Apply(std::vector<std::shared_ptr<Object>> args) {
-    int64_t res = 1;
-    for (size_t i = 0; i < args.size(); i++) {
-        if (Is<Number>(args[i])) {
-            res *= As<Number>(args[i])->GetValue();
-        } else {
-            throw RuntimeError("not number in args for *");
-        }
+std::shared_ptr<Object> Product::Apply(std::span<const std::shared_ptr<Object>> args) {
+    auto values = UnboxNumbers(args);
+    if (values.size() != args.size()) {
+        throw RuntimeError("not number in args for *");
     }
-    return std::make_shared<Number>(res);
+    // no vector kernel, AVX2 can't multiply 64-bit lanes
+    uint64_t res = 1;
+    for (int64_t value : values) {
+        res *= static_cast<uint64_t>(value);
+    }
+    return MakeNumber(static_cast<int64_t>(res));
 }
 
-std::shared_ptr<Object> Division::Apply(std::vector<std::shared_ptr<Object>> args) {
+std::shared_ptr<Object> Division::Apply(std::span<const std::shared_ptr<Object>> args) {
     if (args.empty()) {
-        throw RuntimeError("No args for minus");
+        throw RuntimeError("No args for /");
     }
     int64_t res = 0;
     for (size_t i = 0; i < args.size(); i++) {
         if (Is<Number>(args[i])) {
+            int64_t value = As<Number>(args[i])->GetValue();
             if (i == 0) {
-                res = As<Number>(args[i])->GetValue();
+                res = value;
+            } else if (value == 0) {
+                throw RuntimeError("division by zero");
+            } else if (value == -1 && res == std::numeric_limits<int64_t>::min()) {
+                throw RuntimeError("overflow in /");
             } else {
-                res /= As<Number>(args[i])->GetValue();
+                res /= value;
             }
         } else {
             throw RuntimeError("not number in args for /");
         }
     }
-    return std::make_shared<Number>(res);
+    return MakeNumber(res);
 }
 
-std::shared_ptr<Object> Max::Apply(std::vector<std::shared_ptr<Object>> args) {
+std::shared_ptr<Object> Max::Apply(std::span<const std::shared_ptr<Object>> args) {
     if (args.empty()) {
-        throw RuntimeError("No args for minus");
+        throw RuntimeError("No args for max");
     }
-    int64_t res = 0;
-    for (size_t i = 0; i < args.size(); i++) {
-        if (Is<Number>(args[i])) {
-            res = std::max(res, As<Number>(args[i])->GetValue());
-        } else {
-            throw RuntimeError("not number in args for max");
-        }
+    auto values = UnboxNumbers(args);
+    if (values.size() != args.size()) {
+        throw RuntimeError("not number in args for max");
     }
-    return std::make_shared<Number>(res);
+    return MakeNumber(MaxOf(values));
 }
 
-std::shared_ptr<Object> Min::Apply(std::vector<std::shared_ptr<Object>> args) {
+std::shared_ptr<Object> Min::Apply(std::span<const std::shared_ptr<Object>> args) {
     if (args.empty()) {
-        throw RuntimeError("No args for minus");
+        throw RuntimeError("No args for min");
     }
-    int64_t res = 10000000;  // mnogo жоско
-    for (size_t i = 0; i < args.size(); i++) {
-        if (Is<Number>(args[i])) {
-            res = std::min(res, As<Number>(args[i])->GetValue());
-        } else {
-            throw RuntimeError("not number in args for min");
-        }
+    auto values = UnboxNumbers(args);
+    if (values.size() != args.size()) {
+        throw RuntimeError("not number in args for min");
     }
-    return std::make_shared<Number>(res);
+    return MakeNumber(MinOf(values));
 }
 
-std::shared_ptr<Object> Abs::Apply(std::vector<std::shared_ptr<Object>> args) {
+std::shared_ptr<Object> Abs::Apply(std::span<const std::shared_ptr<Object>> args) {
     if (args.empty() || args.size() > 1) {
         throw RuntimeError("too many args or to few for abs");
     }
     if (!Is<Number>(args.front())) {
         throw RuntimeError("not number as arg to abs");
     }
-    return std::make_shared<Number>(std::abs(As<Number>(args.front())->GetValue()));
+    // the smallest number has no positive counterpart, it wraps around to itself
+    auto value = static_cast<uint64_t>(As<Number>(args.front())->GetValue());
+    return MakeNumber(static_cast<int64_t>(value >> 63 ? 0 - value : value));
 }
 
-std::shared_ptr<Object> Decreasing::Apply(std::vector<std::shared_ptr<Object>> args) {
-    if (args.empty()) {
-        return std::make_shared<Boolean>(true);
-    }
-    if (args.size() == 1 && Is<Number>(args.front())) {
-        return std::make_shared<Boolean>(true);
-    } else if (!Is<Number>(args.front())) {
-        throw RuntimeError("not number in args for >");
-    }
-    for (size_t i = 1; i < args.size(); i++) {
-        if (Is<Number>(args[i])) {
-            if (As<Number>(args[i])->GetValue() >= As<Number>(args[i - 1])->GetValue()) {
-                return std::make_shared<Boolean>(false);
-            }
-        } else {
-            throw RuntimeError("not number in args for >");
-        }
-    }
-    return std::make_shared<Boolean>(true);
+std::shared_ptr<Object> Decreasing::Apply(std::span<const std::shared_ptr<Object>> args) {
+    return Compare(args, Order::DECREASING, "not number in args for >");
 }
 
-std::shared_ptr<Object> DecreasingOrEqual::Apply(std::vector<std::shared_ptr<Object>> args) {
-    if (args.empty()) {
-        return std::make_shared<Boolean>(true);
-    }
-    if (args.size() == 1 && Is<Number>(args.front())) {
-        return std::make_shared<Boolean>(true);
-    } else if (!Is<Number>(args.front())) {
-        throw RuntimeError("not number in args for >=");
-    }
-    for (size_t i = 1; i < args.size(); i++) {
-        if (Is<Number>(args[i])) {
-            if (As<Number>(args[i])->GetValue() > As<Number>(args[i - 1])->GetValue()) {
-                return std::make_shared<Boolean>(false);
-            }
-        } else {
-            throw RuntimeError("not number in args for >=");
-        }
-    }
-    return std::make_shared<Boolean>(true);
+std::shared_ptr<Object> DecreasingOrEqual::Apply(std::span<const std::shared_ptr<Object>> args) {
+    return Compare(args, Order::NON_INCREASING, "not number in args for >=");
 }
 
-std::shared_ptr<Object> Increasing::Apply(std::vector<std::shared_ptr<Object>> args) {
-    if (args.empty()) {
-        return std::make_shared<Boolean>(true);
-    }
-    if (args.size() == 1 && Is<Number>(args.front())) {
-        return std::make_shared<Boolean>(true);
-    } else if (!Is<Number>(args.front())) {
-        throw RuntimeError("not number in args for <");
-    }
-    for (size_t i = 1; i < args.size(); i++) {
-        if (Is<Number>(args[i])) {
-            if (As<Number>(args[i])->GetValue() <= As<Number>(args[i - 1])->GetValue()) {
-                return std::make_shared<Boolean>(false);
-            }
-        } else {
-            throw RuntimeError("not number in args for <");
-        }
-    }
-    return std::make_shared<Boolean>(true);
+std::shared_ptr<Object> Increasing::Apply(std::span<const std::shared_ptr<Object>> args) {
+    return Compare(args, Order::INCREASING, "not number in args for <");
 }
 
-std::shared_ptr<Object> IncreasingOrEqual::Apply(std::vector<std::shared_ptr<Object>> args) {
-    if (args.empty()) {
-        return std::make_shared<Boolean>(true);
-    }
-    if (args.size() == 1 && Is<Number>(args.front())) {
-        return std::make_shared<Boolean>(true);
-    } else if (!Is<Number>(args.front())) {
-        throw RuntimeError("not number in args for <=");
-    }
-    for (size_t i = 1; i < args.size(); i++) {
-        if (Is<Number>(args[i])) {
-            if (As<Number>(args[i])->GetValue() < As<Number>(args[i - 1])->GetValue()) {
-                return std::make_shared<Boolean>(false);
-            }
-        } else {
-            throw RuntimeError("not number in args for <=");
-        }
-    }
-    return std::make_shared<Boolean>(true);
+std::shared_ptr<Object> IncreasingOrEqual::Apply(std::span<const std::shared_ptr<Object>> args) {
+    return Compare(args, Order::NON_DECREASING, "not number in args for <=");
 }
 
-std::shared_ptr<Object> Equal::Apply(std::vector<std::shared_ptr<Object>> args) {
-    if (args.empty()) {
-        return std::make_shared<Boolean>(true);
-    }
-    if (args.size() == 1 && Is<Number>(args.front())) {
-        return std::make_shared<Boolean>(true);
-    } else if (!Is<Number>(args.front())) {
-        throw RuntimeError("not number in args for ==");
-    }
-    for (size_t i = 1; i < args.size(); i++) {
-        if (Is<Number>(args[i])) {
-            if (As<Number>(args[i])->GetValue() != As<Number>(args[i - 1])->GetValue()) {
-                return std::make_shared<Boolean>(false);
-            }
-        } else {
-            throw RuntimeError("not number in args for ==");
-        }
-    }
-    return std::make_shared<Boolean>(true);
+std::shared_ptr<Object> Equal::Apply(std::span<const std::shared_ptr<Object>> args) {
+    return Compare(args, Order::EQUAL, "not number in args for ==");
 }
 
-std::shared_ptr<Object> BooleanPredicate::Apply(std::vector<std::shared_ptr<Object>> args) {
+std::shared_ptr<Object> BooleanPredicate::Apply(std::span<const std::shared_ptr<Object>> args) {
     if (args.empty() || args.size() > 1) {
         throw RuntimeError("too many or too few args in boolean?");
     }
     if (Is<Boolean>(args.front())) {
-        return std::make_shared<Boolean>(true);
+        return MakeBoolean(true);
     }
-    return std::make_shared<Boolean>(false);
+    return MakeBoolean(false);
 }
 
-std::shared_ptr<Object> Not::Apply(std::vector<std::shared_ptr<Object>> args) {
+std::shared_ptr<Object> Not::Apply(std::span<const std::shared_ptr<Object>> args) {
     if (args.empty() || args.size() > 1) {
         throw RuntimeError("too many or too few args in boolean?");
     }
     if (Is<Boolean>(args.front())) {
         if (As<Boolean>(args.front())->GetBool()) {
-            return std::make_shared<Boolean>(false);
+            return MakeBoolean(false);
         }
-        return std::make_shared<Boolean>(true);
+        return MakeBoolean(true);
     }
-    return std::make_shared<Boolean>(false);
+    return MakeBoolean(false);
 }
 
-std::shared_ptr<Object> Quote::Apply(std::vector<std::shared_ptr<Object>> args) {
-    if (Is<Cell>(args.front())) {
-        As<Cell>(args.front())->is_quoted = true;
+// The quoted cell is marked by the reader, evaluation never modifies the tree.
+std::shared_ptr<Object> Quote::Apply(std::span<const std::shared_ptr<Object>> args) {
+    if (args.size() != 1) {
+        throw RuntimeError("bad args for quote");
     }
     return args.front();
 }
 
-std::shared_ptr<Object> PairPredicate::Apply(std::vector<std::shared_ptr<Object>> args) {
+std::shared_ptr<Object> PairPredicate::Apply(std::span<const std::shared_ptr<Object>> args) {
+    if (args.empty()) {
+        throw RuntimeError("no args for pair?");
+    }
     if (args.front() == nullptr) {
-        return std::make_shared<Boolean>(false);
+        return MakeBoolean(false);
     }
     auto node = args.front();
     if (!Is<Cell>(node)) {
-        return std::make_shared<Boolean>(false);
-    }
-    if (As<Cell>(node)->GetFirst() != nullptr && As<Cell>(node)->GetSecond() != nullptr) {
-        return std::make_shared<Boolean>(true);
+        return MakeBoolean(false);
     }
+    return MakeBoolean(true);
 }
 
-std::shared_ptr<Object> NullPredicate::Apply(std::vector<std::shared_ptr<Object>> args) {
+std::shared_ptr<Object> NullPredicate::Apply(std::span<const std::shared_ptr<Object>> args) {
+    if (args.empty()) {
+        throw RuntimeError("no args for null?");
+    }
     if (args.front() == nullptr) {
-        return std::make_shared<Boolean>(true);
+        return MakeBoolean(true);
     } else {
-        return std::make_shared<Boolean>(false);
+        return MakeBoolean(false);
     }
 }
 
-std::shared_ptr<Object> ListPredicate::Apply(std::vector<std::shared_ptr<Object>> args) {
+std::shared_ptr<Object> ListPredicate::Apply(std::span<const std::shared_ptr<Object>> args) {
+    if (args.empty()) {
+        throw RuntimeError("no args for list?");
+    }
     if (args.front() == nullptr) {
-        return std::make_shared<Boolean>(true);
+        return MakeBoolean(true);
     }
     std::shared_ptr<Object> temp = args.front();
     while (Is<Cell>(temp) && temp != nullptr) {
+        LimitsScope::CountStep();
         temp = As<Cell>(temp)->GetSecond();
     }
     if (temp != nullptr) {
-        return std::make_shared<Boolean>(false);
+        return MakeBoolean(false);
     } else {
-        return std::make_shared<Boolean>(true);
+        return MakeBoolean(true);
     }
     return nullptr;
 }
-std::shared_ptr<Object> Cons::Apply(std::vector<std::shared_ptr<Object>> args) {
+std::shared_ptr<Object> Cons::Apply(std::span<const std::shared_ptr<Object>> args) {
     if (args.size() < 2) {
         throw RuntimeError("to few args for cons");
     }
-    auto to_return = std::make_shared<Cell>(args[0], args[1]);
+    auto to_return = Make<Cell>(args[0], args[1]);
     to_return->IsList();
     return to_return;
 }
 
-std::shared_ptr<Object> Car::Apply(std::vector<std::shared_ptr<Object>> args) {
+std::shared_ptr<Object> Car::Apply(std::span<const std::shared_ptr<Object>> args) {
     if (args.empty() || (args.size() == 1 && args.front() == nullptr)) {
         throw RuntimeError("no args for car");
     }
+    if (!Is<Cell>(args.front())) {
+        throw RuntimeError("car of not a pair");
+    }
     return As<Cell>(args.front())->GetFirst();
 }
 
-std::shared_ptr<Object> Cdr::Apply(std::vector<std::shared_ptr<Object>> args) {
-    if (args.front() == nullptr) {
+std::shared_ptr<Object> Cdr::Apply(std::span<const std::shared_ptr<Object>> args) {
+    if (args.empty() || args.front() == nullptr) {
         throw RuntimeError("no args for car");
     }
-    auto to_return = As<Cell>(args.front())->GetSecond();
+    if (!Is<Cell>(args.front())) {
+        throw RuntimeError("cdr of not a pair");
+    }
+    const auto& to_return = As<Cell>(args.front())->GetSecond();
 
-    if (to_return != nullptr && !As<Cell>(args.front())->CellWithDot()) {
-        As<Cell>(to_return)->IsList();
-        return to_return;
+    // the rest is printed as a list, so it is copied instead of marking a cell that may be shared
+    if (Is<Cell>(to_return) && !As<Cell>(args.front())->CellWithDot()) {
+        auto rest = Make<Cell>(*As<Cell>(to_return));
+        rest->IsList();
+        return rest;
     }
-    return As<Cell>(args.front())->GetSecond();
+    return to_return;
 }
 
-std::shared_ptr<Object> List::Apply(std::vector<std::shared_ptr<Object>> args) {
-    if (args.empty() || args.front() == nullptr) {
+std::shared_ptr<Object> List::Apply(std::span<const std::shared_ptr<Object>> args) {
+    if (args.empty()) {
         return nullptr;
     }
     std::shared_ptr<Cell> to_return = nullptr;
     for (int i = args.size() - 1; i >= 0; i--) {
-        to_return = std::make_shared<Cell>(args[i], to_return);
+        to_return = Make<Cell>(args[i], to_return);
     }
     to_return->IsList();
     return to_return;
 }
 
-std::shared_ptr<Object> ListRef::Apply(std::vector<std::shared_ptr<Object>> args) {
-    Cdr cdr;
-    auto res = args.front();
-    std::vector<std::shared_ptr<Object>> temp;
-    temp.push_back(res);
-    List list_maker;
-    for (int i = 0; i < As<Number>(args.back())->GetValue(); i++) {
-        if (res == nullptr) {
-            throw RuntimeError("joker");
-        }
-        res = cdr.Apply(temp);
-        temp.clear();
-        temp.push_back(res);
+std::shared_ptr<Object> ListRef::Apply(std::span<const std::shared_ptr<Object>> args) {
+    if (args.size() != 2 || !Is<Number>(args.back())) {
+        throw RuntimeError("bad args for list-ref");
     }
-    Car car;
-    res = car.Apply(temp);
-    if (res != nullptr) {
-        return res;
-    } else {
+    const auto& tail = NthTail(args.front(), As<Number>(args.back())->GetValue(), "joker");
+    if (tail == nullptr) {
+        throw RuntimeError("no args for car");
+    }
+    if (!Is<Cell>(tail)) {
+        throw RuntimeError("car of not a pair");
+    }
+    const auto& res = As<Cell>(tail)->GetFirst();
+    if (res == nullptr) {
         throw RuntimeError("matos");
     }
+    return res;
 }
 
-std::shared_ptr<Object> ListTail::Apply(std::vector<std::shared_ptr<Object>> args) {
-    Cdr cdr;
-    auto res = args.front();
-    std::vector<std::shared_ptr<Object>> temp;
-    temp.push_back(res);
-    List list_maker;
-    for (int i = 0; i < As<Number>(args.back())->GetValue(); i++) {
-        if (res == nullptr) {
-            throw RuntimeError("nike");
+std::shared_ptr<Object> ListTail::Apply(std::span<const std::shared_ptr<Object>> args) {
+    if (args.size() != 2 || !Is<Number>(args.back())) {
+        throw RuntimeError("bad args for list-tail");
+    }
+    int64_t index = As<Number>(args.back())->GetValue();
+    const auto& tail = NthTail(args.front(), index, "nike");
+    // as returned by the last cdr
+    if (index > 0 && Is<Cell>(tail)) {
+        auto rest = Make<Cell>(*As<Cell>(tail));
+        rest->IsList();
+        return rest;
+    }
+    return tail;
+}
+
+std::shared_ptr<Object> And::Apply(std::span<const std::shared_ptr<Object>> args) {
+    if (args.empty()) {
+        return MakeBoolean(true);
+    }
+    std::shared_ptr<Object> value;
+    for (const auto& arg : args) {
+        value = Evaluate(arg);
+        if (Is<Boolean>(value) && !As<Boolean>(value)->GetBool()) {
+            return MakeBoolean(false);
         }
-        res = cdr.Apply(temp);
-        temp.clear();
-        temp.push_back(res);
     }
-    return res;
+    return value;
 }
 
-std::shared_ptr<Object> And::Apply(std::vector<std::shared_ptr<Object>> args) {
+std::shared_ptr<Object> Or::Apply(std::span<const std::shared_ptr<Object>> args) {
     if (args.empty()) {
-        return std::make_shared<Boolean>(true);
+        return MakeBoolean(false);
     }
-    for (int i = 0; i < args.size(); i++) {
-        if (Is<Boolean>(args[i]->Eval()) && !As<Boolean>(args[i]->Eval())->GetBool()) {
-            return std::make_shared<Boolean>(false);
+    std::shared_ptr<Object> value;
+    for (const auto& arg : args) {
+        value = Evaluate(arg);
+        if (!Is<Boolean>(value) || As<Boolean>(value)->GetBool()) {
+            return value;
         }
     }
-    return args.back()->Eval();
+    return value;
 }
-std::shared_ptr<Object> Or::Apply(std::vector<std::shared_ptr<Object>> args) {
-    if (args.empty()) {
-        return std::make_shared<Boolean>(false);
+
+namespace {
+
+Vector* VectorArg(std::span<const std::shared_ptr<Object>> args, size_t count, const char* name) {
+    if (args.size() != count || !Is<Vector>(args.front())) {
+        throw RuntimeError(std::string("bad args for ") + name);
+    }
+    return As<Vector>(args.front());
+}
+
+// The elements of the largest vector make-vector creates take 4 GiB.
+constexpr int64_t kMaxVectorSize = int64_t{1} << 28;
+
+size_t IndexArg(const Vector* vector, const std::shared_ptr<Object>& index, const char* name) {
+    if (!Is<Number>(index) || As<Number>(index)->GetValue() < 0 ||
+        static_cast<uint64_t>(As<Number>(index)->GetValue()) >= vector->Size()) {
+        throw RuntimeError(std::string("bad index for ") + name);
+    }
+    return As<Number>(index)->GetValue();
+}
+
+}  // namespace
+
+// (make-vector size) is filled with 0.
+std::shared_ptr<Object> MakeVector::Apply(std::span<const std::shared_ptr<Object>> args) {
+    if (args.empty() || args.size() > 2 || !Is<Number>(args.front()) ||
+        As<Number>(args.front())->GetValue() < 0 ||
+        As<Number>(args.front())->GetValue() > kMaxVectorSize) {
+        throw RuntimeError("bad args for make-vector");
+    }
+    auto fill = args.size() == 2 ? args.back() : MakeNumber(0);
+    return Make<Vector>(std::vector<std::shared_ptr<Object>>(
+        As<Number>(args.front())->GetValue(), fill));
+}
+
+std::shared_ptr<Object> VectorOf::Apply(std::span<const std::shared_ptr<Object>> args) {
+    return Make<Vector>(std::vector<std::shared_ptr<Object>>(args.begin(), args.end()));
+}
+
+std::shared_ptr<Object> VectorPredicate::Apply(std::span<const std::shared_ptr<Object>> args) {
+    if (args.size() != 1) {
+        throw RuntimeError("bad args for vector?");
+    }
+    return MakeBoolean(Is<Vector>(args.front()));
+}
+
+std::shared_ptr<Object> VectorLength::Apply(std::span<const std::shared_ptr<Object>> args) {
+    return MakeNumber(VectorArg(args, 1, "vector-length")->Size());
+}
+
+std::shared_ptr<Object> VectorRef::Apply(std::span<const std::shared_ptr<Object>> args) {
+    auto* vector = VectorArg(args, 2, "vector-ref");
+    return vector->GetElements()[IndexArg(vector, args[1], "vector-ref")];
+}
+
+std::shared_ptr<Object> VectorSet::Apply(std::span<const std::shared_ptr<Object>> args) {
+    auto* vector = VectorArg(args, 3, "vector-set!");
+    if (vector->IsLiteral()) {
+        throw RuntimeError("vector-set! of a literal vector");
+    }
+    if (!vector->IsModifiable()) {
+        throw RuntimeError("vector-set! of a vector shared by batch items");
+    }
+    vector->Set(IndexArg(vector, args[1], "vector-set!"), args[2]);
+    return args.front();
+}
+
+std::shared_ptr<Object> VectorToList::Apply(std::span<const std::shared_ptr<Object>> args) {
+    const auto& elements = VectorArg(args, 1, "vector->list")->GetElements();
+    std::shared_ptr<Cell> res = nullptr;
+    for (size_t i = elements.size(); i-- > 0;) {
+        res = Make<Cell>(elements[i], std::move(res));
+    }
+    if (res != nullptr) {
+        res->IsList();
+    }
+    return res;
+}
+
+std::shared_ptr<Object> ListToVector::Apply(std::span<const std::shared_ptr<Object>> args) {
+    if (args.size() != 1) {
+        throw RuntimeError("bad args for list->vector");
+    }
+    std::vector<std::shared_ptr<Object>> elements;
+    const std::shared_ptr<Object>* node = &args.front();
+    for (; Is<Cell>(*node); node = &As<Cell>(*node)->GetSecond()) {
+        LimitsScope::CountStep();
+        elements.push_back(As<Cell>(*node)->GetFirst());
+    }
+    if (*node != nullptr) {
+        throw RuntimeError("not a list in list->vector");
     }
-    for (int i = 0; i < args.size(); i++) {
-        if ((Is<Boolean>(args[i]->Eval()) && As<Boolean>(args[i]->Eval())->GetBool()) ||
-            !Is<Boolean>(args[i]->Eval())) {
-            return args[i]->Eval();
+    return Make<Vector>(std::move(elements));
+}
+
+namespace {
+
+std::shared_ptr<Object> ListOf(std::vector<std::shared_ptr<Object>> elements) {
+    std::shared_ptr<Cell> res = nullptr;
+    for (size_t i = elements.size(); i-- > 0;) {
+        res = Make<Cell>(std::move(elements[i]), std::move(res));
+    }
+    if (res != nullptr) {
+        res->IsList();
+    }
+    return res;
+}
+
+std::shared_ptr<Object> Counter(const char* name, size_t value) {
+    return ListOf({Symbol::Intern(name), MakeNumber(value)});
+}
+
+}  // namespace
+
+std::shared_ptr<Object> RuntimeStatsToList(const RuntimeStats& stats) {
+    std::vector<std::shared_ptr<Object>> allocated = {Symbol::Intern("allocated")};
+    for (size_t type = 0; type < stats.allocated.size(); ++type) {
+        if (stats.allocated[type] != 0) {
+            allocated.push_back(Counter(ObjectTypeName(static_cast<ObjectType>(type)),
+                                        stats.allocated[type]));
+        }
+    }
+    std::vector<std::shared_ptr<Object>> builtins = {Symbol::Intern("builtins")};
+    for (const auto& builtin : FunctionsMap()) {
+        auto kind = static_cast<size_t>(builtin.function->GetKind());
+        if (kind < stats.builtins.size() && stats.builtins[kind].calls != 0) {
+            builtins.push_back(ListOf({Symbol::Intern(builtin.name),
+                                       MakeNumber(stats.builtins[kind].calls),
+                                       MakeNumber(stats.builtins[kind].time.count())}));
         }
     }
-    return args.back()->Eval();
+    return ListOf({Counter("evaluated-nodes", stats.evaluated_nodes),
+                   Counter("tokens", stats.tokens), ListOf(std::move(allocated)),
+                   ListOf(std::move(builtins))});
+}
+
+std::shared_ptr<Object> GetRuntimeStats::Apply(std::span<const std::shared_ptr<Object>> args) {
+    if (!args.empty()) {
+        throw RuntimeError("bad args for runtime-stats");
+    }
+    if (!SCHEME_PROFILING) {
+        return MakeBoolean(false);
+    }
+    return RuntimeStatsToList(CurrentRuntimeStats());
 }
@@ -1,41 +1,220 @@
 #pragma once
 
 #include <memory>
+#include <span>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 #include "error.h"
+#include "gc.h"
 #include <algorithm>
 #include <cmath>
+#include <concepts>
+#include <cstdint>
+
+// Type tag stored in every object, so type checks don't need RTTI.
+enum class ObjectType : uint8_t {
+    NUMBER,
+    SYMBOL,
+    BOOLEAN,
+    CELL,
+    VECTOR,
+    FUNCTION,
+    // special_forms.h
+    FRAME,
+    LOCAL_REF,
+    IF,
+    LAMBDA,
+    DEFINE,
+    CALL,
+    CONSTANT,
+    // hash_table.h
+    HASH_TABLE,
+    // stream.h
+    PROMISE
+};
 
 class Object : public std::enable_shared_from_this<Object> {
 public:
+    explicit Object(ObjectType type) : type_(type){};
     virtual ~Object() = default;
+
+    ObjectType GetType() const {
+        return type_;
+    }
+
+    // shared_from_this() that also works for immortal objects.
+    std::shared_ptr<Object> Self();
+
     virtual std::string Serialise() {
         return "doesn't have";
     };
     virtual std::shared_ptr<Object> Eval() {
         return nullptr;
     }
+
+    // Objects this one references, used by the cycle collector.
+    virtual void GetChildren(std::vector<Object*>&) const {
+    }
+
+    // Drops the references of an object found to be cyclic garbage.
+    virtual void ClearChildren() {
+    }
+
+private:
+    ObjectType type_;
+};
+
+// Identifies the RunBatch item evaluated on this thread while alive. Vectors, hash tables and
+// promises remember the item that made them, an item may only modify its own ones: the others
+// belong to the globals, which the items running on other threads see as well.
+class BatchItemScope {
+public:
+    BatchItemScope();
+    ~BatchItemScope();
+
+    BatchItemScope(const BatchItemScope&) = delete;
+    BatchItemScope& operator=(const BatchItemScope&) = delete;
+
+    // 0 outside of batch items.
+    static uint32_t Current() {
+        return current_;
+    }
+
+    // Whether an object made by item may be modified on this thread.
+    static bool MayModify(uint32_t item) {
+        return current_ == 0 || current_ == item;
+    }
+
+private:
+    static inline thread_local uint32_t current_ = 0;
+
+    uint32_t previous_;
+};
+
+// Second level tag of functions, one per builtin and one per kind of user procedure.
+enum class FunctionKind : uint8_t {
+    INTEGER_PREDICATE,
+    SUM,
+    SUBTRACTION,
+    PRODUCT,
+    DIVISION,
+    MAX,
+    MIN,
+    ABS,
+    DECREASING,
+    DECREASING_OR_EQUAL,
+    INCREASING,
+    INCREASING_OR_EQUAL,
+    EQUAL,
+    BOOLEAN_PREDICATE,
+    NOT,
+    QUOTE,
+    PAIR_PREDICATE,
+    NULL_PREDICATE,
+    LIST_PREDICATE,
+    CONS,
+    CAR,
+    CDR,
+    LIST,
+    LIST_REF,
+    LIST_TAIL,
+    AND,
+    OR,
+    MAKE_VECTOR,
+    VECTOR,
+    VECTOR_PREDICATE,
+    VECTOR_LENGTH,
+    VECTOR_REF,
+    VECTOR_SET,
+    VECTOR_TO_LIST,
+    LIST_TO_VECTOR,
+    MAKE_HASH_TABLE,
+    HASH_TABLE_REF,
+    HASH_TABLE_SET,
+    HASH_TABLE_DELETE,
+    HASH_TABLE_COUNT,
+    RUNTIME_STATS,
+    DELAY_THUNK,
+    FORCE,
+    PROMISE_PREDICATE,
+    STREAM_CAR,
+    STREAM_CDR,
+    STREAM_MAP,
+    STREAM_FILTER,
+    STREAM_TAKE,
+    STREAM_TO_LIST,
+    CLOSURE,
+    // compiled.h
+    COMPILED_PROCEDURE
 };
 
 class Function : public Object {
 public:
-    virtual std::shared_ptr<Object> Apply(std::vector<std::shared_ptr<Object>> args) = 0;
+    static constexpr ObjectType kType = ObjectType::FUNCTION;
+
+    explicit Function(FunctionKind kind) : Object(kType), kind_(kind){};
+
+    FunctionKind GetKind() const {
+        return kind_;
+    }
+
+    // args are borrowed for the duration of the call.
+    virtual std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) = 0;
+
+    // Builtins and user procedures alike.
+    std::string Serialise() override;
+
+private:
+    FunctionKind kind_;
+};
+
+// Apply as called by the evaluators, profiling builds also time the builtins here.
+inline std::shared_ptr<Object> Invoke(Function* function,
+                                      std::span<const std::shared_ptr<Object>> args) {
+#if SCHEME_PROFILING
+    if (function->GetKind() < FunctionKind::CLOSURE) {
+        BuiltinTimer timer(function->GetKind());
+        return function->Apply(args);
+    }
+#endif
+    return function->Apply(args);
+}
+
+// Slots for the arguments of one call, taken from the top of the current thread's argument stack
+// and given back (and cleared) when destroyed, in reverse order. The slots stay in place while
+// more calls take their own ones above, and the stack's memory is kept for later calls.
+class Arguments {
+public:
+    explicit Arguments(size_t count);
+    ~Arguments();
+
+    Arguments(const Arguments&) = delete;
+    Arguments& operator=(const Arguments&) = delete;
+
+    std::span<std::shared_ptr<Object>> Slots() const {
+        return {slots_, count_};
+    }
+
+private:
+    std::shared_ptr<Object>* slots_;
+    size_t count_;
+    size_t previous_chunk_;
+    size_t previous_top_;
 };
 
-class Number : public Object {
+// Numbers and booleans are immutable, so evaluating them returns the same object.
+class Number final : public Object {
 public:
-    Number(int val) : val_(val){};
+    static constexpr ObjectType kType = ObjectType::NUMBER;
+
+    Number(int64_t val) : Object(kType), val_(val){};
 
     int64_t GetValue() const {
         return val_;
     }
 
-    void SetVal(int v) {
-        val_ = v;
-    }
-
     std::shared_ptr<Object> Eval() override;
 
     std::string Serialise() override;
@@ -44,31 +223,45 @@ private:
     int64_t val_ = 0;
 };
 
-class Symbol : public Object {
+class SymbolTable;
+
+// Symbols are interned: there is one Symbol object per name and it is identified by its id.
+class Symbol final : public Object {
 public:
-    Symbol(const std::string& str) : name_(str){};
+    static constexpr ObjectType kType = ObjectType::SYMBOL;
+
+    static std::shared_ptr<Symbol> Intern(std::string_view name);
+
+    uint32_t GetId() const {
+        return id_;
+    }
 
     const std::string& GetName() const {
         return name_;
     }
 
-    void SetName(const std::string& str) {
-        name_ = str;
-    }
+    bool IsBuiltin() const;
 
     std::shared_ptr<Object> Eval() override;
 
     std::string Serialise() override;
 
 private:
+    friend class SymbolTable;
+
+    Symbol(uint32_t id, std::string name) : Object(kType), id_(id), name_(std::move(name)){};
+
+    uint32_t id_;
     std::string name_;
 };
 
-class Boolean : public Object {
+class Boolean final : public Object {
 public:
-    Boolean(bool boolean) : bool_(boolean){};
+    static constexpr ObjectType kType = ObjectType::BOOLEAN;
+
+    Boolean(bool boolean) : Object(kType), bool_(boolean){};
 
-    bool GetBool() {
+    bool GetBool() const {
         return bool_;
     };
 
@@ -80,228 +273,536 @@ private:
     bool bool_;
 };
 
-class Cell : public Object {
+class Cell final : public Object {
 public:
+    static constexpr ObjectType kType = ObjectType::CELL;
+
     Cell(std::shared_ptr<Object> first, std::shared_ptr<Object> second)
-        : first_(first), second_(second){};
+        : Object(kType), first_(std::move(first)), second_(std::move(second)){};
+
+    Cell(const Cell&) = default;
+
+    ~Cell() override;
 
-    std::shared_ptr<Object> GetFirst() const {
+    const std::shared_ptr<Object>& GetFirst() const {
         return first_;
     }
-    std::shared_ptr<Object> GetSecond() const {
+    const std::shared_ptr<Object>& GetSecond() const {
         return second_;
     }
 
     void SetFirst(std::shared_ptr<Object> obj) {
-        first_ = obj;
+        first_ = std::move(obj);
+        Heap::Current().RememberMutation(this);
     }
 
     void SetSecond(std::shared_ptr<Object> obj) {
-        second_ = obj;
+        second_ = std::move(obj);
+        Heap::Current().RememberMutation(this);
     }
 
+    // For cells that are still being built: nothing can point to them yet, so no cycle can
+    // appear and the collector doesn't have to know.
+    void InitFirst(std::shared_ptr<Object> obj) {
+        first_ = std::move(obj);
+    }
+    void InitSecond(std::shared_ptr<Object> obj) {
+        second_ = std::move(obj);
+    }
+
+    void GetChildren(std::vector<Object*>& children) const override;
+
+    void ClearChildren() override;
+
     std::shared_ptr<Object> Eval() override;
 
     std::string Serialise() override;
 
-    void SerialiseInsideOfBrackets(std::shared_ptr<Object> node, std::string& str);
-
     bool CellWithDot();
 
     void IsList() {
         is_list_ = true;
     }
+    bool IsListMarked() const {
+        return is_list_;
+    }
     bool is_quoted = false;
 
 private:
+    // see ~Cell
+    friend class Vector;
+    static void FreeLinks(std::span<std::shared_ptr<Object>> children);
+
     std::shared_ptr<Object> first_;
     std::shared_ptr<Object> second_;
     bool is_list_ = false;
 };
 
+// Fixed size array, #(...) evaluates to itself. Literals are part of the program, which may be
+// executed many times, so they can't be modified.
+class Vector final : public Object {
+public:
+    static constexpr ObjectType kType = ObjectType::VECTOR;
+
+    explicit Vector(std::vector<std::shared_ptr<Object>> elements)
+        : Object(kType), elements_(std::move(elements)){};
+
+    // Nested vectors are freed without recursion, like lists (see ~Cell).
+    ~Vector() override;
+
+    size_t Size() const {
+        return elements_.size();
+    }
+
+    const std::vector<std::shared_ptr<Object>>& GetElements() const {
+        return elements_;
+    }
+
+    bool IsModifiable() const {
+        return BatchItemScope::MayModify(batch_item_);
+    }
+
+    void MarkLiteral() {
+        is_literal_ = true;
+    }
+    bool IsLiteral() const {
+        return is_literal_;
+    }
+
+    void Set(size_t index, std::shared_ptr<Object> obj) {
+        elements_[index] = std::move(obj);
+        Heap::Current().RememberMutation(this);
+    }
+
+    void GetChildren(std::vector<Object*>& children) const override;
+
+    void ClearChildren() override;
+
+    std::shared_ptr<Object> Eval() override;
+
+    std::string Serialise() override;
+
+private:
+    friend class Cell;
+
+    std::vector<std::shared_ptr<Object>> elements_;
+    const uint32_t batch_item_ = BatchItemScope::Current();
+    bool is_literal_ = false;
+};
+
 /////////////////////////////////////////////////////////////////////////////// Functions
 
-class IntegerPredicate : public Function {
+class IntegerPredicate final : public Function {
+public:
+    static constexpr FunctionKind kKind = FunctionKind::INTEGER_PREDICATE;
+
+    IntegerPredicate() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
+};
+
+class Sum final : public Function {
+public:
+    static constexpr FunctionKind kKind = FunctionKind::SUM;
+
+    Sum() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
+};
+
+class Subtraction final : public Function {
+public:
+    static constexpr FunctionKind kKind = FunctionKind::SUBTRACTION;
+
+    Subtraction() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
+};
+
+class Product final : public Function {
+public:
+    static constexpr FunctionKind kKind = FunctionKind::PRODUCT;
+
+    Product() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
+};
+
+class Division final : public Function {
 public:
-    std::shared_ptr<Object> Apply(std::vector<std::shared_ptr<Object>> args) override;
+    static constexpr FunctionKind kKind = FunctionKind::DIVISION;
+
+    Division() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
 };
 
-class Sum : public Function {
+class Max final : public Function {
 public:
-    std::shared_ptr<Object> Apply(std::vector<std::shared_ptr<Object>> args) override;
+    static constexpr FunctionKind kKind = FunctionKind::MAX;
+
+    Max() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
 };
 
-class Subtraction : public Function {
+class Min final : public Function {
 public:
-    std::shared_ptr<Object> Apply(std::vector<std::shared_ptr<Object>> args) override;
+    static constexpr FunctionKind kKind = FunctionKind::MIN;
+
+    Min() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
 };
 
-class Product : public Function {
+class Abs final : public Function {
 public:
-    std::shared_ptr<Object> Apply(std::vector<std::shared_ptr<Object>> args) override;
+    static constexpr FunctionKind kKind = FunctionKind::ABS;
+
+    Abs() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
 };
 
-class Division : public Function {
+class Decreasing final : public Function {
 public:
-    std::shared_ptr<Object> Apply(std::vector<std::shared_ptr<Object>> args) override;
+    static constexpr FunctionKind kKind = FunctionKind::DECREASING;
+
+    Decreasing() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
 };
 
-class Max : public Function {
+class DecreasingOrEqual final : public Function {
 public:
-    std::shared_ptr<Object> Apply(std::vector<std::shared_ptr<Object>> args) override;
+    static constexpr FunctionKind kKind = FunctionKind::DECREASING_OR_EQUAL;
+
+    DecreasingOrEqual() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
 };
 
-class Min : public Function {
+class Increasing final : public Function {
 public:
-    std::shared_ptr<Object> Apply(std::vector<std::shared_ptr<Object>> args) override;
+    static constexpr FunctionKind kKind = FunctionKind::INCREASING;
+
+    Increasing() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
 };
 
-class Abs : public Function {
+class IncreasingOrEqual final : public Function {
 public:
-    std::shared_ptr<Object> Apply(std::vector<std::shared_ptr<Object>> args) override;
+    static constexpr FunctionKind kKind = FunctionKind::INCREASING_OR_EQUAL;
+
+    IncreasingOrEqual() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
 };
 
-class Decreasing : public Function {
+class Equal final : public Function {
 public:
-    std::shared_ptr<Object> Apply(std::vector<std::shared_ptr<Object>> args) override;
+    static constexpr FunctionKind kKind = FunctionKind::EQUAL;
+
+    Equal() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
 };
 
-class DecreasingOrEqual : public Function {
+class BooleanPredicate final : public Function {
 public:
-    std::shared_ptr<Object> Apply(std::vector<std::shared_ptr<Object>> args) override;
+    static constexpr FunctionKind kKind = FunctionKind::BOOLEAN_PREDICATE;
+
+    BooleanPredicate() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
 };
 
-class Increasing : public Function {
+class Not final : public Function {
 public:
-    std::shared_ptr<Object> Apply(std::vector<std::shared_ptr<Object>> args) override;
+    static constexpr FunctionKind kKind = FunctionKind::NOT;
+
+    Not() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
 };
 
-class IncreasingOrEqual : public Function {
+class Quote final : public Function {
 public:
-    std::shared_ptr<Object> Apply(std::vector<std::shared_ptr<Object>> args) override;
+    static constexpr FunctionKind kKind = FunctionKind::QUOTE;
+
+    Quote() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
 };
 
-class Equal : public Function {
+class PairPredicate final : public Function {
 public:
-    std::shared_ptr<Object> Apply(std::vector<std::shared_ptr<Object>> args) override;
+    static constexpr FunctionKind kKind = FunctionKind::PAIR_PREDICATE;
+
+    PairPredicate() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
 };
 
-class BooleanPredicate : public Function {
+class NullPredicate final : public Function {
 public:
-    std::shared_ptr<Object> Apply(std::vector<std::shared_ptr<Object>> args) override;
+    static constexpr FunctionKind kKind = FunctionKind::NULL_PREDICATE;
+
+    NullPredicate() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
 };
 
-class Not : public Function {
+class ListPredicate final : public Function {
 public:
-    std::shared_ptr<Object> Apply(std::vector<std::shared_ptr<Object>> args) override;
+    static constexpr FunctionKind kKind = FunctionKind::LIST_PREDICATE;
+
+    ListPredicate() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
 };
 
-class Quote : public Function {
+class Cons final : public Function {
 public:
-    std::shared_ptr<Object> Apply(std::vector<std::shared_ptr<Object>> args) override;
+    static constexpr FunctionKind kKind = FunctionKind::CONS;
+
+    Cons() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
 };
 
-class PairPredicate : public Function {
+class Car final : public Function {
 public:
-    std::shared_ptr<Object> Apply(std::vector<std::shared_ptr<Object>> args) override;
+    static constexpr FunctionKind kKind = FunctionKind::CAR;
+
+    Car() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
 };
 
-class NullPredicate : public Function {
+class Cdr final : public Function {
 public:
-    std::shared_ptr<Object> Apply(std::vector<std::shared_ptr<Object>> args) override;
+    static constexpr FunctionKind kKind = FunctionKind::CDR;
+
+    Cdr() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
 };
 
-class ListPredicate : public Function {
+class List final : public Function {
 public:
-    std::shared_ptr<Object> Apply(std::vector<std::shared_ptr<Object>> args) override;
+    static constexpr FunctionKind kKind = FunctionKind::LIST;
+
+    List() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
 };
 
-class Cons : public Function {
+class ListRef final : public Function {
 public:
-    std::shared_ptr<Object> Apply(std::vector<std::shared_ptr<Object>> args) override;
+    static constexpr FunctionKind kKind = FunctionKind::LIST_REF;
+
+    ListRef() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
 };
 
-class Car : public Function {
+class ListTail final : public Function {
 public:
-    std::shared_ptr<Object> Apply(std::vector<std::shared_ptr<Object>> args) override;
+    static constexpr FunctionKind kKind = FunctionKind::LIST_TAIL;
+
+    ListTail() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
 };
 
-class Cdr : public Function {
+class And final : public Function {
 public:
-    std::shared_ptr<Object> Apply(std::vector<std::shared_ptr<Object>> args) override;
+    static constexpr FunctionKind kKind = FunctionKind::AND;
+
+    And() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
 };
 
-class List : public Function {
+class Or final : public Function {
 public:
-    std::shared_ptr<Object> Apply(std::vector<std::shared_ptr<Object>> args) override;
+    static constexpr FunctionKind kKind = FunctionKind::OR;
+
+    Or() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
 };
 
-class ListRef : public Function {
+class MakeVector final : public Function {
 public:
-    std::shared_ptr<Object> Apply(std::vector<std::shared_ptr<Object>> args) override;
+    static constexpr FunctionKind kKind = FunctionKind::MAKE_VECTOR;
+
+    MakeVector() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
 };
 
-class ListTail : public Function {
+class VectorOf final : public Function {
 public:
-    std::shared_ptr<Object> Apply(std::vector<std::shared_ptr<Object>> args) override;
+    static constexpr FunctionKind kKind = FunctionKind::VECTOR;
+
+    VectorOf() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
 };
 
-class And : public Function {
+class VectorPredicate final : public Function {
 public:
-    std::shared_ptr<Object> Apply(std::vector<std::shared_ptr<Object>> args) override;
+    static constexpr FunctionKind kKind = FunctionKind::VECTOR_PREDICATE;
+
+    VectorPredicate() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
 };
 
-class Or : public Function {
+class VectorLength final : public Function {
 public:
-    std::shared_ptr<Object> Apply(std::vector<std::shared_ptr<Object>> args) override;
+    static constexpr FunctionKind kKind = FunctionKind::VECTOR_LENGTH;
+
+    VectorLength() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
 };
 
-static std::unordered_map<std::string, std::shared_ptr<Function>> functions_map = {
-    {"number?", std::make_shared<IntegerPredicate>()},
-    {"+", std::make_shared<Sum>()},
-    {"-", std::make_shared<Subtraction>()},
-    {"*", std::make_shared<Product>()},
-    {"/", std::make_shared<Division>()},
-    {"max", std::make_shared<Max>()},
-    {"min", std::make_shared<Min>()},
-    {"abs", std::make_shared<Abs>()},
-    {">", std::make_shared<Decreasing>()},
-    {">=", std::make_shared<DecreasingOrEqual>()},
-    {"<", std::make_shared<Increasing>()},
-    {"<=", std::make_shared<IncreasingOrEqual>()},
-    {"=", std::make_shared<Equal>()},
-    {"boolean?", std::make_shared<BooleanPredicate>()},
-    {"not", std::make_shared<Not>()},
-    {"quote", std::make_shared<Quote>()},
-    {"pair?", std::make_shared<PairPredicate>()},
-    {"null?", std::make_shared<NullPredicate>()},
-    {"list?", std::make_shared<ListPredicate>()},
-    {"cons", std::make_shared<Cons>()},
-    {"car", std::make_shared<Car>()},
-    {"cdr", std::make_shared<Cdr>()},
-    {"list", std::make_shared<List>()},
-    {"list-ref", std::make_shared<ListRef>()},
-    {"list-tail", std::make_shared<ListTail>()},
-    {"and", std::make_shared<And>()},
-    {"or", std::make_shared<Or>()}};
+class VectorRef final : public Function {
+public:
+    static constexpr FunctionKind kKind = FunctionKind::VECTOR_REF;
+
+    VectorRef() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
+};
+
+// Returns the vector.
+class VectorSet final : public Function {
+public:
+    static constexpr FunctionKind kKind = FunctionKind::VECTOR_SET;
+
+    VectorSet() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
+};
+
+class VectorToList final : public Function {
+public:
+    static constexpr FunctionKind kKind = FunctionKind::VECTOR_TO_LIST;
+
+    VectorToList() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
+};
+
+class ListToVector final : public Function {
+public:
+    static constexpr FunctionKind kKind = FunctionKind::LIST_TO_VECTOR;
+
+    ListToVector() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
+};
+
+// (runtime-stats) returns the current thread's counters (see profile.h) as a list, or #f in
+// builds without -DSCHEME_PROFILING=ON, which don't collect them.
+class GetRuntimeStats final : public Function {
+public:
+    static constexpr FunctionKind kKind = FunctionKind::RUNTIME_STATS;
+
+    GetRuntimeStats() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
+};
+
+// ((evaluated-nodes n) (tokens n) (allocated (type n) ...) (builtins (name calls ns) ...)),
+// types and builtins that weren't used are left out.
+std::shared_ptr<Object> RuntimeStatsToList(const RuntimeStats& stats);
+
+struct BuiltinFunction {
+    std::string name;
+    std::shared_ptr<Function> function;
+    // Without side effects, and the result depends only on the arguments and is never modified:
+    // applications to constants are evaluated once, when the expression is prepared.
+    bool pure = false;
+};
+
+// All builtins, the symbol of the i-th one is interned with id i.
+const std::vector<BuiltinFunction>& FunctionsMap();
 
 /////////////////////////////////////////////////////////////////////////////// Helpers
 
+// Shared #t and #f, builtins return these instead of allocating.
+const std::shared_ptr<Boolean>& MakeBoolean(bool value);
+
+// Numbers from kMinSharedNumber to kMaxSharedNumber are preallocated immortal objects, like the
+// booleans. Numbers are never modified, so they can be shared by all their users.
+constexpr int64_t kMinSharedNumber = -128;
+constexpr int64_t kMaxSharedNumber = 1023;
+
+const std::shared_ptr<Number>& SharedNumber(int64_t value);
+
+inline std::shared_ptr<Number> MakeNumber(int64_t value) {
+    if (value >= kMinSharedNumber && value <= kMaxSharedNumber) {
+        return SharedNumber(value);
+    }
+    return Make<Number>(value);
+}
+
+// Appends the printed form of obj (which isn't the empty list) to out.
+void SerialiseTo(Object* obj, std::string& out);
+
+// Evaluates node, the empty list evaluates to itself.
+std::shared_ptr<Object> Evaluate(const std::shared_ptr<Object>& node);
+
 void TreeToVector(std::shared_ptr<Object> node, std::vector<std::shared_ptr<Object>>& res);
 void TreeToVectorNoEval(std::shared_ptr<Object> node, std::vector<std::shared_ptr<Object>>& res);
 
-// Runtime type checking and convertion.
-// This can be helpful: https://en.cppreference.com/w/cpp/memory/shared_ptr/pointer_cast
+// Runtime type checking and convertion, without RTTI: leaf types and Function are checked by
+// their ObjectType, builtins by their FunctionKind. As returns a borrowed pointer (nullptr if
+// the type doesn't match), use AsShared to keep the object.
+
+template <class T>
+concept HasTypeTag = requires {
+    { T::kType } -> std::convertible_to<ObjectType>;
+};
+
+template <class T>
+concept HasKindTag = requires {
+    { T::kKind } -> std::convertible_to<FunctionKind>;
+};
 
 template <class T>
-std::shared_ptr<T> As(const std::shared_ptr<Object>& obj) {
-    return std::dynamic_pointer_cast<T>(obj);
+bool Is(const Object* obj) {
+    static_assert(HasTypeTag<T> || HasKindTag<T>);
+    if constexpr (HasKindTag<T>) {
+        return obj != nullptr && obj->GetType() == ObjectType::FUNCTION &&
+               static_cast<const Function*>(obj)->GetKind() == T::kKind;
+    } else {
+        return obj != nullptr && obj->GetType() == T::kType;
+    }
 }
 
 template <class T>
 bool Is(const std::shared_ptr<Object>& obj) {
-    if (As<T>(obj)) {
-        return true;
-    }
-    return false;
+    return Is<T>(obj.get());
+}
+
+template <class T>
+T* As(Object* obj) {
+    return Is<T>(obj) ? static_cast<T*>(obj) : nullptr;
+}
+
+template <class T>
+T* As(const std::shared_ptr<Object>& obj) {
+    return As<T>(obj.get());
+}
+
+template <class T>
+std::shared_ptr<T> AsShared(const std::shared_ptr<Object>& obj) {
+    return Is<T>(obj) ? std::static_pointer_cast<T>(obj) : nullptr;
 }
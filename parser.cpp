@@ -1,87 +1,295 @@
 #include <parser.h>
 
-std::shared_ptr<Object> Read(Tokenizer* tokenizer, bool first_read) {
-    if (tokenizer->IsEnd()) {
-        throw SyntaxError("SyntaxError");
-    }
+#include <unordered_map>
+#include <vector>
 
-    Token curr_token = tokenizer->GetToken();
-    tokenizer->Next();
-    // (
-    if (curr_token == Token{BracketToken::OPEN}) {
-        auto subtree = ReadList(tokenizer, true);
-        if (tokenizer->GetToken() == Token{BracketToken::CLOSE} && !tokenizer->IsEnd()) {
-            tokenizer->Next();
-        } else {
-            throw SyntaxError("SyntaxError");
+namespace {
+
+// Equal literals of one form share their objects: numbers in quoted data by value and the cells
+// of quoted data by their contents. Quoted data is never modified, so the sharing can't be
+// observed. Forms don't share with each other, every form lives in an arena of its own.
+class LiteralPool {
+public:
+    std::shared_ptr<Object> GetNumber(int64_t value) {
+        if (value >= kMinSharedNumber && value <= kMaxSharedNumber) {
+            return MakeNumber(value);
         }
-        if (first_read) {
-            if (!tokenizer->IsEnd()) {
-                throw SyntaxError("SyntaxError");
-            }
+        auto& number = numbers_[value];
+        if (number == nullptr) {
+            number = Make<Number>(value);
         }
-        return subtree;
-    }
-    // )
-    if (curr_token == Token{BracketToken::CLOSE}) {
-        throw SyntaxError("SyntaxError");
-    }
-    // Const Token
-    if (std::holds_alternative<ConstantToken>(curr_token)) {
-        return std::make_shared<Number>(std::get<ConstantToken>(curr_token).value);
+        return number;
     }
-    // Symbol Token
-    if (std::holds_alternative<SymbolToken>(curr_token)) {
-        return std::make_shared<Symbol>(std::get<SymbolToken>(curr_token).name);
-    }
-    // BoolToken
-    if (std::holds_alternative<BoolToken>(curr_token)) {
-        return std::make_shared<Boolean>(std::get<BoolToken>(curr_token).bool_val);
-    }
-    // DotToken -> syntax error
-    if (std::holds_alternative<DotToken>(curr_token)) {
-        throw SyntaxError("SyntaxError");
+
+    // first and second must be shared ones already (or vectors, which are never shared), so
+    // they are identified by their addresses. The pool keeps them alive, so the addresses
+    // aren't reused while reading.
+    std::shared_ptr<Cell> GetCell(std::shared_ptr<Object> first, std::shared_ptr<Object> second,
+                                  bool is_list, bool is_quoted) {
+        auto& cell = cells_[CellKey{first.get(), second.get(), is_list, is_quoted}];
+        if (cell == nullptr) {
+            cell = Make<Cell>(std::move(first), std::move(second));
+            if (is_list) {
+                cell->IsList();
+            }
+            cell->is_quoted = is_quoted;
+        }
+        return cell;
     }
-    // QuoteToken
-    if (std::holds_alternative<QuoteToken>(curr_token)) {
-        if (tokenizer->IsEnd()) {
-            throw SyntaxError("Syntax Error");
-        } else {
-            return std::make_shared<Cell>(std::make_shared<Symbol>("quote"),
-                                          Read(tokenizer, false));
+
+    // The same value marked as quoted.
+    std::shared_ptr<Object> Quoted(std::shared_ptr<Object> value) {
+        auto* cell = As<Cell>(value);
+        if (cell == nullptr || cell->is_quoted) {
+            return value;
         }
+        return GetCell(cell->GetFirst(), cell->GetSecond(), cell->IsListMarked(), true);
     }
+
+private:
+    struct CellKey {
+        const Object* first;
+        const Object* second;
+        bool is_list;
+        bool is_quoted;
+
+        bool operator==(const CellKey&) const = default;
+    };
+
+    struct CellKeyHash {
+        size_t operator()(const CellKey& key) const {
+            size_t hash = std::hash<const Object*>()(key.first) * 31;
+            hash += std::hash<const Object*>()(key.second);
+            return hash * 4 + key.is_list * 2 + key.is_quoted;
+        }
+    };
+
+    std::unordered_map<int64_t, std::shared_ptr<Number>> numbers_;
+    std::unordered_map<CellKey, std::shared_ptr<Cell>, CellKeyHash> cells_;
+};
+
+// A list, a vector or a quote whose contents are still being read.
+struct ReadFrame {
+    enum class Kind { LIST, VECTOR, QUOTE };
+
+    Kind kind = Kind::LIST;
+    // of vectors and quoted lists
+    std::vector<std::shared_ptr<Object>> elements = {};
+    std::shared_ptr<Cell> head = nullptr;
+    Cell* tail = nullptr;
+    size_t size = 0;
+    // the first element wasn't written as a list, so the first cell is printed in brackets
+    bool first_not_open = false;
+    // (quote ...), its arguments are data
+    bool quote_form = false;
+    bool dotted = false;
+    bool closed_by_dot = false;
+    // A list inside of quoted data keeps its elements and gets its cells from the pool once it
+    // is closed, since a cell can only be looked up after the rest of the list.
+    bool quoted = false;
+    // of a quoted list, after the dot
+    std::shared_ptr<Object> rest = nullptr;
+};
+
+bool IsQuoteSymbol(const std::shared_ptr<Object>& value) {
+    return Is<Symbol>(value) && As<Symbol>(value)->GetName() == "quote";
 }
 
-std::shared_ptr<Object> ReadList(Tokenizer* tokenizer, bool from_open) {
-    if (tokenizer->IsEnd()) {
-        throw SyntaxError("SyntaxError");
+// Whether the next value read is quoted data: inside of a quote or a vector, or the argument
+// of (quote ...).
+bool InData(const std::vector<ReadFrame>& frames) {
+    if (frames.empty()) {
+        return false;
     }
+    const ReadFrame& parent = frames.back();
+    return parent.kind != ReadFrame::Kind::LIST || parent.quoted ||
+           (parent.quote_form && parent.size == 1);
+}
 
-    if (tokenizer->GetToken() == Token{BracketToken::CLOSE}) {
-        return nullptr;
+std::shared_ptr<Object> MakeQuotedList(ReadFrame& frame, bool quoted_head,
+                                       LiteralPool& literals) {
+    std::shared_ptr<Object> res = std::move(frame.rest);
+    for (size_t i = frame.elements.size(); i-- > 0;) {
+        bool is_list = frame.elements[i] == nullptr || (i == 0 && frame.first_not_open);
+        bool is_quoted = (i == 1 && frame.quote_form) || (i == 0 && quoted_head);
+        res = literals.GetCell(std::move(frame.elements[i]), std::move(res), is_list, is_quoted);
     }
+    return res;
+}
 
-    Cell to_return(nullptr, nullptr);
-    if (tokenizer->GetToken() != Token{BracketToken::OPEN} && from_open) {
-        to_return.IsList();
+void AddToList(ReadFrame& frame, std::shared_ptr<Object> value, LiteralPool& literals) {
+    if (frame.kind == ReadFrame::Kind::VECTOR) {
+        frame.elements.push_back(std::move(value));
+        return;
     }
-    std::shared_ptr<Object> first_elem = Read(tokenizer, false);
-    std::shared_ptr<Object> second_elem = nullptr;
-
-    if (first_elem == nullptr && second_elem == nullptr) {
-        to_return.IsList();
+    if (frame.dotted) {
+        if (frame.size == 1 && frame.quote_form) {
+            value = literals.Quoted(std::move(value));
+        }
+        if (frame.quoted) {
+            frame.rest = std::move(value);
+        } else {
+            frame.tail->InitSecond(std::move(value));
+        }
+        frame.closed_by_dot = true;
+        return;
+    }
+    if (frame.quoted) {
+        if (frame.size == 0) {
+            frame.quote_form = IsQuoteSymbol(value);
+        }
+        frame.elements.push_back(std::move(value));
+        ++frame.size;
+        return;
     }
 
-    // встретил точку
-    if (std::holds_alternative<DotToken>(tokenizer->GetToken())) {
-        tokenizer->Next();
-        second_elem = Read(tokenizer, false);
+    bool is_list = value == nullptr || (frame.size == 0 && frame.first_not_open);
+    auto cell = Make<Cell>(std::move(value), nullptr);
+    if (is_list) {
+        cell->IsList();
+    }
+    if (frame.size == 0) {
+        frame.quote_form = IsQuoteSymbol(cell->GetFirst());
+        frame.head = cell;
     } else {
-        second_elem = ReadList(tokenizer, false);
+        if (frame.size == 1 && frame.quote_form) {
+            cell->is_quoted = true;
+        }
+        frame.tail->InitSecond(cell);
     }
+    frame.tail = cell.get();
+    ++frame.size;
+}
+
+}  // namespace
+
+// Lists are built in place by appending to their last cell, only unfinished lists and quotes
+// are kept on the stack, so long lists and deep nesting don't use the native stack.
+std::shared_ptr<Object> Read(Tokenizer* tokenizer, bool first_read) {
+    std::vector<ReadFrame> frames;
+    LiteralPool literals;
+    bool top_is_list = false;
+
+    while (true) {
+        std::shared_ptr<Object> value;
+        bool has_value = false;
+
+        if (!frames.empty() && frames.back().kind == ReadFrame::Kind::VECTOR) {
+            ReadFrame& frame = frames.back();
+            if (tokenizer->IsEnd()) {
+                throw SyntaxError("SyntaxError");
+            }
+            if (tokenizer->GetToken() == Token{BracketToken::CLOSE}) {
+                tokenizer->Next();
+                auto vector = Make<Vector>(std::move(frame.elements));
+                vector->MarkLiteral();
+                value = std::move(vector);
+                has_value = true;
+                frames.pop_back();
+            }
+        } else if (!frames.empty() && frames.back().kind == ReadFrame::Kind::LIST) {
+            ReadFrame& frame = frames.back();
+            if (tokenizer->IsEnd()) {
+                throw SyntaxError("SyntaxError");
+            }
+            const Token& token = tokenizer->GetToken();
+            if (frame.closed_by_dot && token != Token{BracketToken::CLOSE}) {
+                throw SyntaxError("SyntaxError");
+            }
+            if (token == Token{BracketToken::CLOSE}) {
+                tokenizer->Next();
+                if (frame.quoted) {
+                    bool quoted_head = frames.size() > 1 &&
+                                       frames[frames.size() - 2].kind == ReadFrame::Kind::QUOTE;
+                    value = MakeQuotedList(frame, quoted_head, literals);
+                } else {
+                    value = std::move(frame.head);
+                }
+                has_value = true;
+                frames.pop_back();
+            } else if (frame.size > 0 && std::holds_alternative<DotToken>(token)) {
+                tokenizer->Next();
+                frame.dotted = true;
+            } else if (frame.size == 0) {
+                frame.first_not_open = token != Token{BracketToken::OPEN};
+            }
+        }
+
+        if (!has_value) {
+            if (tokenizer->IsEnd()) {
+                throw SyntaxError("SyntaxError");
+            }
 
-    to_return.SetFirst(first_elem);
-    to_return.SetSecond(second_elem);
-    return std::make_shared<Cell>(to_return);
+            // Symbol Token, interned before Next() since the name may point into the
+            // tokenizer's buffer
+            if (const auto* symbol = std::get_if<SymbolToken>(&tokenizer->GetToken())) {
+                value = Symbol::Intern(symbol->name);
+                tokenizer->Next();
+            } else {
+                Token curr_token = tokenizer->GetToken();
+                tokenizer->Next();
+                // (
+                if (curr_token == Token{BracketToken::OPEN}) {
+                    if (frames.empty()) {
+                        top_is_list = true;
+                    }
+                    bool quoted = InData(frames);
+                    frames.push_back({ReadFrame::Kind::LIST});
+                    frames.back().quoted = quoted;
+                    continue;
+                }
+                // #(
+                if (curr_token == Token{BracketToken::VECTOR_OPEN}) {
+                    if (frames.empty()) {
+                        top_is_list = true;
+                    }
+                    frames.push_back({ReadFrame::Kind::VECTOR});
+                    continue;
+                }
+                // )
+                if (curr_token == Token{BracketToken::CLOSE}) {
+                    throw SyntaxError("SyntaxError");
+                }
+                // DotToken -> syntax error
+                if (std::holds_alternative<DotToken>(curr_token)) {
+                    throw SyntaxError("SyntaxError");
+                }
+                // QuoteToken
+                if (std::holds_alternative<QuoteToken>(curr_token)) {
+                    if (tokenizer->IsEnd()) {
+                        throw SyntaxError("Syntax Error");
+                    }
+                    frames.push_back({ReadFrame::Kind::QUOTE});
+                    continue;
+                }
+                // Const Token
+                if (std::holds_alternative<ConstantToken>(curr_token)) {
+                    int64_t number = std::get<ConstantToken>(curr_token).value;
+                    value = InData(frames) ? literals.GetNumber(number) : MakeNumber(number);
+                }
+                // BoolToken
+                if (std::holds_alternative<BoolToken>(curr_token)) {
+                    value = MakeBoolean(std::get<BoolToken>(curr_token).bool_val);
+                }
+            }
+        }
+
+        // The finished value completes the quotes around it and goes into the enclosing list.
+        while (!frames.empty() && frames.back().kind == ReadFrame::Kind::QUOTE) {
+            frames.pop_back();
+            value = literals.Quoted(std::move(value));
+            if (InData(frames)) {
+                value = literals.GetCell(Symbol::Intern("quote"), std::move(value), false, false);
+            } else {
+                value = Make<Cell>(Symbol::Intern("quote"), std::move(value));
+            }
+        }
+        if (frames.empty()) {
+            if (first_read && top_is_list && !tokenizer->IsEnd()) {
+                throw SyntaxError("SyntaxError");
+            }
+            return value;
+        }
+        AddToList(frames.back(), std::move(value), literals);
+    }
 }
@@ -8,4 +8,35 @@
 
 std::shared_ptr<Object> Read(Tokenizer* tokenizer, bool first_read = true);
 
-std::shared_ptr<Object> ReadList(Tokenizer* tokenizer, bool from_open = false);
+// Reads the top-level forms of an input one after another, so inputs with many expressions
+// don't have to be split up. Only the form being read is kept in memory.
+class FormReader {
+public:
+    explicit FormReader(Tokenizer* tokenizer) : tokenizer_(tokenizer) {
+    }
+
+    // Reads the next token of a stream, which can fail like Next().
+    bool IsEnd() {
+        broken_ = true;
+        bool is_end = tokenizer_->IsEnd();
+        broken_ = false;
+        return is_end;
+    }
+
+    std::shared_ptr<Object> Next() {
+        broken_ = true;
+        auto form = Read(tokenizer_, false);
+        broken_ = false;
+        return form;
+    }
+
+    // The last Next() failed in the middle of a form, the rest of the input can't be read
+    // reliably.
+    bool IsBroken() const {
+        return broken_;
+    }
+
+private:
+    Tokenizer* tokenizer_;
+    bool broken_ = false;
+};
@@ -0,0 +1,69 @@
+#include "profile.h"
+#include "object.h"
+
+namespace {
+
+thread_local RuntimeStats runtime_stats;
+
+}  // namespace
+
+RuntimeStats& CurrentRuntimeStats() {
+    return runtime_stats;
+}
+
+void ResetRuntimeStats() {
+    runtime_stats = {};
+}
+
+const char* ObjectTypeName(ObjectType type) {
+    switch (type) {
+        case ObjectType::NUMBER:
+            return "number";
+        case ObjectType::SYMBOL:
+            return "symbol";
+        case ObjectType::BOOLEAN:
+            return "boolean";
+        case ObjectType::CELL:
+            return "cell";
+        case ObjectType::VECTOR:
+            return "vector";
+        case ObjectType::FUNCTION:
+            return "function";
+        case ObjectType::FRAME:
+            return "frame";
+        case ObjectType::LOCAL_REF:
+            return "local-ref";
+        case ObjectType::IF:
+            return "if";
+        case ObjectType::LAMBDA:
+            return "lambda";
+        case ObjectType::DEFINE:
+            return "define";
+        case ObjectType::CALL:
+            return "call";
+        case ObjectType::CONSTANT:
+            return "constant";
+        case ObjectType::HASH_TABLE:
+            return "hash-table";
+        case ObjectType::PROMISE:
+            return "promise";
+    }
+    return "unknown";
+}
+
+void RecordAllocation(ObjectType type) {
+    auto index = static_cast<size_t>(type);
+    if (index >= runtime_stats.allocated.size()) {
+        runtime_stats.allocated.resize(index + 1);
+    }
+    ++runtime_stats.allocated[index];
+}
+
+void RecordBuiltinCall(FunctionKind kind, std::chrono::nanoseconds time) {
+    auto index = static_cast<size_t>(kind);
+    if (index >= runtime_stats.builtins.size()) {
+        runtime_stats.builtins.resize(index + 1);
+    }
+    ++runtime_stats.builtins[index].calls;
+    runtime_stats.builtins[index].time += time;
+}
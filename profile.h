@@ -0,0 +1,78 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Counters of the work done by the interpreter, kept per thread. They are only collected in
+// builds with SCHEME_PROFILING=1, otherwise the hooks below are empty and the counters stay 0.
+#ifndef SCHEME_PROFILING
+#define SCHEME_PROFILING 0
+#endif
+
+enum class ObjectType : uint8_t;
+enum class FunctionKind : uint8_t;
+
+struct BuiltinStats {
+    size_t calls = 0;
+    std::chrono::nanoseconds time{0};
+};
+
+struct RuntimeStats {
+    // Applications and ifs evaluated by walking the tree.
+    size_t evaluated_nodes = 0;
+    size_t tokens = 0;
+    // Objects created with Make, indexed by ObjectType.
+    std::vector<size_t> allocated;
+    // Indexed by FunctionKind, procedures defined with lambda aren't counted.
+    std::vector<BuiltinStats> builtins;
+};
+
+// Statistics of the current thread.
+RuntimeStats& CurrentRuntimeStats();
+
+void ResetRuntimeStats();
+
+// e.g. "cell"
+const char* ObjectTypeName(ObjectType type);
+
+void RecordAllocation(ObjectType type);
+
+void RecordBuiltinCall(FunctionKind kind, std::chrono::nanoseconds time);
+
+inline void CountEvaluatedNode() {
+#if SCHEME_PROFILING
+    ++CurrentRuntimeStats().evaluated_nodes;
+#endif
+}
+
+inline void CountToken() {
+#if SCHEME_PROFILING
+    ++CurrentRuntimeStats().tokens;
+#endif
+}
+
+inline void CountAllocation([[maybe_unused]] ObjectType type) {
+#if SCHEME_PROFILING
+    RecordAllocation(type);
+#endif
+}
+
+// Measures one builtin call, including calls that throw.
+class BuiltinTimer {
+public:
+    explicit BuiltinTimer(FunctionKind kind)
+        : kind_(kind), start_(std::chrono::steady_clock::now()){};
+
+    ~BuiltinTimer() {
+        RecordBuiltinCall(kind_, std::chrono::steady_clock::now() - start_);
+    }
+
+    BuiltinTimer(const BuiltinTimer&) = delete;
+    BuiltinTimer& operator=(const BuiltinTimer&) = delete;
+
+private:
+    FunctionKind kind_;
+    std::chrono::steady_clock::time_point start_;
+};
@@ -1,15 +1,170 @@
 #include "scheme.h"
 
-std::string Interpreter::Run(const std::string &input) {
-    std::stringstream input_stream(input);
-    Tokenizer tokenizer(&input_stream);
-    auto input_ast = Read(&tokenizer);
-    if (input_ast == nullptr) {
+PreparedExpression::PreparedExpression(std::shared_ptr<Object> ast, EvalMode mode,
+                                       std::shared_ptr<Environment> globals)
+    : ast_(std::move(ast)), globals_(std::move(globals)) {
+    if (mode == EvalMode::BYTECODE && ast_ != nullptr) {
+        bytecode_ = std::make_shared<Bytecode>(ast_);
+    }
+}
+
+PreparedExpression::PreparedExpression(const CompiledForm& form,
+                                       std::shared_ptr<Environment> globals)
+    : compiled_(form.run), globals_(std::move(globals)) {
+}
+
+std::string PreparedExpression::Dump() const {
+    if (compiled_ != nullptr) {
+        return "#<compiled>";
+    }
+    return ast_ != nullptr ? ast_->Serialise() : "()";
+}
+
+std::string PreparedExpression::Execute(const RunOptions& options) const {
+    std::string res;
+    Execute(res, options);
+    return res;
+}
+
+void PreparedExpression::Execute(std::string& output, const RunOptions& options) const {
+    if (ast_ == nullptr && compiled_ == nullptr) {
         throw RuntimeError("empty list");
     }
-    auto res_res = input_ast->Eval();
-    if (res_res == nullptr) {
-        return "()";
+    {
+        EnvironmentScope environment(globals_.get());
+        ArenaScope scope;
+        LimitsScope limits(options);
+        auto res = compiled_ ? compiled_() : bytecode_ ? bytecode_->Run() : ast_->Eval();
+        if (res == nullptr) {
+            output += "()";
+        } else {
+            SerialiseTo(res.get(), output);
+        }
+    }
+    Heap::Current().MaybeCollect();
+}
+
+Interpreter::Interpreter(size_t cache_capacity) : cache_capacity_(cache_capacity) {
+}
+
+Interpreter::~Interpreter() {
+    cache_index_.clear();
+    cache_.clear();
+    globals_.reset();
+    Heap::Current().Collect();
+}
+
+PreparedExpression Interpreter::Prepare(std::string_view input) const {
+    return Prepare(input, globals_);
+}
+
+PreparedExpression Interpreter::Prepare(std::string_view input,
+                                        std::shared_ptr<Environment> globals) const {
+    Tokenizer tokenizer(input);
+    // the tree gets its own arena, it lives as long as the prepared expression
+    ArenaScope scope;
+    return PreparedExpression(Resolve(Read(&tokenizer), fold_), mode_, std::move(globals));
+}
+
+PreparedExpression Interpreter::PrepareNext(FormReader* reader) const {
+    ArenaScope scope;
+    return PreparedExpression(Resolve(reader->Next(), fold_), mode_, globals_);
+}
+
+PreparedExpression Interpreter::Prepare(const AstImage& image, size_t form) const {
+    ArenaScope scope;
+    return PreparedExpression(Resolve(image.Form(form), fold_), mode_, globals_);
+}
+
+PreparedExpression Interpreter::Prepare(const CompiledForm& form) const {
+    if (form.run != nullptr) {
+        return PreparedExpression(form, globals_);
+    }
+    ArenaScope scope;
+    return PreparedExpression(Resolve(form.tree(), fold_), mode_, globals_);
+}
+
+size_t Interpreter::CollectGarbage() {
+    return Heap::Current().Collect();
+}
+
+const GcStats &Interpreter::GetGcStats() const {
+    return Heap::Current().Stats();
+}
+
+const RuntimeStats &Interpreter::Stats() const {
+    return CurrentRuntimeStats();
+}
+
+void Interpreter::ResetStats() {
+    ResetRuntimeStats();
+}
+
+void Interpreter::SetEvalMode(EvalMode mode) {
+    mode_ = mode;
+    cache_.clear();
+    cache_index_.clear();
+}
+
+void Interpreter::SetConstantFolding(bool enabled) {
+    fold_ = enabled;
+    cache_.clear();
+    cache_index_.clear();
+}
+
+std::string Interpreter::Run(const std::string &input, const RunOptions &options) {
+    std::string res;
+    Run(input, res, options);
+    return res;
+}
+
+void Interpreter::Run(const std::string &input, std::string &output, const RunOptions &options) {
+    if (cache_capacity_ == 0) {
+        Prepare(input).Execute(output, options);
+    } else {
+        Lookup(input).Execute(output, options);
+    }
+}
+
+std::vector<std::string> Interpreter::RunBatch(std::span<const std::string> inputs,
+                                               const RunOptions &options) {
+    if (pool_ == nullptr) {
+        pool_ = std::make_unique<ThreadPool>();
+    }
+    std::vector<std::string> results(inputs.size());
+    std::vector<std::exception_ptr> errors(inputs.size());
+    // Each expression is read and evaluated by one worker, with that thread's arena and heap.
+    // Builtins, symbols and #t/#f are immortal and never written to. The objects of the globals
+    // are seen by all workers, BatchItemScope keeps the expressions from modifying them.
+    pool_->ParallelFor(inputs.size(), [&](size_t i) {
+        try {
+            BatchItemScope item;
+            results[i] =
+                Prepare(inputs[i], std::make_shared<Environment>(globals_)).Execute(options);
+        } catch (...) {
+            errors[i] = std::current_exception();
+        }
+    });
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    return results;
+}
+
+const PreparedExpression &Interpreter::Lookup(const std::string &input) {
+    auto it = cache_index_.find(input);
+    if (it != cache_index_.end()) {
+        cache_.splice(cache_.begin(), cache_, it->second);
+        return it->second->second;
+    }
+    auto prepared = Prepare(input);
+    if (cache_.size() == cache_capacity_) {
+        cache_index_.erase(cache_.back().first);
+        cache_.pop_back();
     }
-    return res_res->Serialise();
+    cache_.emplace_front(input, std::move(prepared));
+    cache_index_.emplace(cache_.front().first, cache_.begin());
+    return cache_.front().second;
 }
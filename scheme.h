@@ -3,9 +3,114 @@
 #include <string>
 #include "tokenizer.h"
 #include "parser.h"
+#include "ast_image.h"
+#include "bytecode.h"
+#include "compiled.h"
+#include "eval_limits.h"
+#include "special_forms.h"
+#include "thread_pool.h"
 #include <sstream>
+#include <list>
+#include <unordered_map>
+#include <string_view>
+#include <span>
+
+// BYTECODE compiles a form and the bodies of the lambdas in it to Bytecode, procedures keep the
+// mode they were made in. Applications of global names at top level still walk the tree.
+enum class EvalMode { TREE_WALK, BYTECODE };
+
+// Parsed expression that can be executed many times without re-reading the source. Executing
+// doesn't modify the tree (its literals are immutable), each execution sees only the globals.
+class PreparedExpression {
+public:
+    // Definitions go to globals, without it define fails.
+    explicit PreparedExpression(std::shared_ptr<Object> ast, EvalMode mode = EvalMode::TREE_WALK,
+                                std::shared_ptr<Environment> globals = nullptr);
+
+    // A form translated by schemec, the interpreted ones must be prepared from their trees.
+    PreparedExpression(const CompiledForm& form, std::shared_ptr<Environment> globals);
+
+    std::string Execute(const RunOptions& options = {}) const;
+
+    // Appends the result to output, so that one buffer can be reused for many results.
+    void Execute(std::string& output, const RunOptions& options = {}) const;
+
+    // The tree that is evaluated, with resolved forms and folded constants.
+    std::string Dump() const;
+
+private:
+    std::shared_ptr<Object> ast_;
+    std::shared_ptr<const Bytecode> bytecode_;
+    std::shared_ptr<Object> (*compiled_)() = nullptr;
+    std::shared_ptr<Environment> globals_;
+};
 
 class Interpreter {
 public:
-    std::string Run(const std::string& input);
+    // cache_capacity is the number of parsed sources remembered by Run, 0 disables the cache.
+    explicit Interpreter(size_t cache_capacity = 0);
+
+    // Procedures defined by the forms may form cycles with their frames, these are collected
+    // once the definitions are gone.
+    ~Interpreter();
+
+    PreparedExpression Prepare(std::string_view input) const;
+
+    // Prepares the next form of a multi-form input.
+    PreparedExpression PrepareNext(FormReader* reader) const;
+
+    // Form of an image made by AstImageWriter, without tokenizing and reading it again.
+    PreparedExpression Prepare(const AstImage& image, size_t form) const;
+
+    // Form of a program loaded with LoadCompiledProgram, forms that weren't translated are
+    // prepared like the others.
+    PreparedExpression Prepare(const CompiledForm& form) const;
+
+    // A run that reaches a limit of options throws EvaluationAborted, its definitions up to
+    // that point stay.
+    std::string Run(const std::string& input, const RunOptions& options = {});
+    void Run(const std::string& input, std::string& output, const RunOptions& options = {});
+
+    // Evaluates independent expressions on all cores, results are in input order. The cache is
+    // not used. If some expressions fail, the error of the first of them is rethrown. Each
+    // expression sees the interpreter's globals but its own definitions are private, modifying
+    // a vector or hash table of the globals fails and forcing a promise of the globals doesn't
+    // remember its value. The limits apply to every expression on its own, the step limit too.
+    std::vector<std::string> RunBatch(std::span<const std::string> inputs,
+                                      const RunOptions& options = {});
+
+    // Frees unreachable reference cycles, this also happens automatically between runs.
+    size_t CollectGarbage();
+
+    // Statistics of the current thread's heap.
+    const GcStats& GetGcStats() const;
+
+    // Counters of the current thread (empty unless built with SCHEME_PROFILING), RunBatch's
+    // workers keep their own ones. Reset between runs to see the cost of a single run.
+    const RuntimeStats& Stats() const;
+    void ResetStats();
+
+    // Switching the mode drops the cached expressions.
+    void SetEvalMode(EvalMode mode);
+
+    // Constant subtrees are computed once when preparing (on by default). Switching drops the
+    // cached expressions.
+    void SetConstantFolding(bool enabled);
+
+private:
+    using CacheEntry = std::pair<std::string, PreparedExpression>;
+
+    const PreparedExpression& Lookup(const std::string& input);
+    PreparedExpression Prepare(std::string_view input, std::shared_ptr<Environment> globals) const;
+
+    EvalMode mode_ = EvalMode::TREE_WALK;
+    bool fold_ = true;
+    std::shared_ptr<Environment> globals_ = std::make_shared<Environment>();
+    size_t cache_capacity_;
+    // most recently used entries are at the front
+    std::list<CacheEntry> cache_;
+    // keys point into the strings owned by cache_
+    std::unordered_map<std::string_view, std::list<CacheEntry>::iterator> cache_index_;
+    // created by the first RunBatch
+    std::unique_ptr<ThreadPool> pool_;
 };
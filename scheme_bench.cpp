@@ -0,0 +1,303 @@
+#include <scheme.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <string>
+
+// Micro and macro benchmarks on synthetic inputs. Every benchmark prints one CSV line:
+// name, operations measured, ns/op, heap allocations/op, heap bytes/op and interpreter
+// objects/op (objects created with Make, most of them live in arenas and don't show up as
+// heap allocations).
+//
+// usage: scheme_bench [--filter substring] [--min-time ms]
+
+namespace {
+
+// Counted by the replaced operator new below, the benchmarks run on one thread.
+size_t allocation_count = 0;
+size_t allocation_bytes = 0;
+
+struct Options {
+    std::string filter;
+    std::chrono::milliseconds min_time{200};
+};
+
+volatile size_t sink = 0;
+
+// Runs body (which performs ops_per_call operations) until min_time has passed.
+void Benchmark(const Options& options, const std::string& name, size_t ops_per_call,
+               const std::function<void()>& body) {
+    if (name.find(options.filter) == std::string::npos) {
+        return;
+    }
+    body();
+
+    size_t calls = 1;
+    while (true) {
+        size_t allocations_before = allocation_count;
+        size_t bytes_before = allocation_bytes;
+        size_t objects_before = Heap::Current().Stats().objects_allocated;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < calls; ++i) {
+            body();
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed < options.min_time) {
+            calls *= 2;
+            continue;
+        }
+
+        double ops = static_cast<double>(calls * ops_per_call);
+        double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+        std::cout << name << ',' << calls * ops_per_call << ',' << ns / ops << ','
+                  << (allocation_count - allocations_before) / ops << ','
+                  << (allocation_bytes - bytes_before) / ops << ','
+                  << (Heap::Current().Stats().objects_allocated - objects_before) / ops << '\n';
+        return;
+    }
+}
+
+std::string NumberList(size_t size) {
+    std::string res = "(list";
+    for (size_t i = 0; i < size; ++i) {
+        res += ' ' + std::to_string(i);
+    }
+    return res + ')';
+}
+
+std::string QuotedNumbers(size_t size) {
+    std::string res = "'(";
+    for (size_t i = 0; i < size; ++i) {
+        res += std::to_string(i) + ' ';
+    }
+    return res + ')';
+}
+
+std::string VectorOfNumbers(size_t size) {
+    std::string res = "#(";
+    for (size_t i = 0; i < size; ++i) {
+        res += std::to_string(i) + ' ';
+    }
+    return res + ')';
+}
+
+// (name 0 1 ... size-1)
+std::string Application(const std::string& name, size_t size) {
+    std::string res = '(' + name;
+    for (size_t i = 0; i < size; ++i) {
+        res += ' ' + std::to_string(i);
+    }
+    return res + ')';
+}
+
+// (+ 1 (+ 1 (+ 1 ... 0)))
+std::string NestedSum(size_t depth) {
+    std::string res;
+    for (size_t i = 0; i < depth; ++i) {
+        res += "(+ 1 ";
+    }
+    res += '0';
+    return res + std::string(depth, ')');
+}
+
+std::string TokenSoup(size_t tokens) {
+    const char* words[] = {"(", "list-ref", "12345", "'", "#t", "-42", "symbol?", ")", "+", "."};
+    std::string res;
+    for (size_t i = 0; i < tokens; ++i) {
+        res += words[i % std::size(words)];
+        res += ' ';
+    }
+    return res;
+}
+
+std::shared_ptr<Object> ReadAll(const std::string& source) {
+    Tokenizer tokenizer{std::string_view(source)};
+    return Read(&tokenizer);
+}
+
+// Evaluation of the prepared tree only, without serialisation.
+void BenchmarkEval(const Options& options, const std::string& name, const std::string& source) {
+    auto ast = ReadAll(source);
+    Benchmark(options, name, 1, [&] {
+        ArenaScope scope;
+        sink = sink + (ast->Eval() != nullptr);
+    });
+}
+
+void BenchmarkTokenizer(const Options& options) {
+    const size_t tokens = 100000;
+    auto source = TokenSoup(tokens);
+    Benchmark(options, "tokenizer/next", tokens, [&] {
+        Tokenizer tokenizer{std::string_view(source)};
+        while (!tokenizer.IsEnd()) {
+            tokenizer.Next();
+        }
+    });
+}
+
+void BenchmarkReader(const Options& options) {
+    auto deep = NestedSum(500);
+    Benchmark(options, "read/deep_500", 1, [&] {
+        ArenaScope scope;
+        sink = sink + (ReadAll(deep) != nullptr);
+    });
+    auto wide = NumberList(100000);
+    Benchmark(options, "read/wide_100000", 1, [&] {
+        ArenaScope scope;
+        sink = sink + (ReadAll(wide) != nullptr);
+    });
+}
+
+void BenchmarkEvaluator(const Options& options) {
+    BenchmarkEval(options, "eval/arithmetic",
+                  "(+ 1 (* 2 3) (- 10 4) (max 1 2 3) (abs -5) (/ 9 3))");
+    BenchmarkEval(options, "eval/comparison", "(and (< 1 2 3) (= 3 3) (or #f (>= 5 1)) (not #f))");
+    BenchmarkEval(options, "eval/nested_sum_500", NestedSum(500));
+    BenchmarkEval(options, "eval/list_builtins", "(cons (car (list 1 2)) (cdr (list 3 4 5)))");
+    BenchmarkEval(options, "eval/list_100", NumberList(100));
+    BenchmarkEval(options, "list_ref/long_1000", "(list-ref " + QuotedNumbers(1000) + " 999)");
+    BenchmarkEval(options, "list_tail/long_1000", "(list-tail " + QuotedNumbers(1000) + " 999)");
+    BenchmarkEval(options, "vector_ref/long_1000",
+                  "(vector-ref " + VectorOfNumbers(1000) + " 999)");
+    BenchmarkEval(options, "eval/sum_5000", Application("+", 5000));
+    BenchmarkEval(options, "eval/max_5000", Application("max", 5000));
+    BenchmarkEval(options, "eval/increasing_5000", Application("<", 5000));
+}
+
+void BenchmarkSerialiser(const Options& options) {
+    auto list = ReadAll(NumberList(2000))->Eval();
+    Benchmark(options, "serialise/list_2000", 1,
+              [&] { sink = sink + list->Serialise().size(); });
+    std::string buffer;
+    Benchmark(options, "serialise/list_2000_reused_buffer", 1, [&] {
+        buffer.clear();
+        SerialiseTo(list.get(), buffer);
+        sink = sink + buffer.size();
+    });
+    auto nested = ReadAll("'" + std::string(300, '(') + std::string(300, ')'))->Eval();
+    Benchmark(options, "serialise/nested_300", 1,
+              [&] { sink = sink + nested->Serialise().size(); });
+}
+
+// Reading, evaluating and printing as done by Interpreter::Run.
+void BenchmarkEndToEnd(const Options& options) {
+    Interpreter interpreter;
+    std::string source = "(list-tail (list 1 2 3 (+ 4 5) (* 6 7) (max 8 9)) 2)";
+    Benchmark(options, "run/end_to_end", 1, [&] { sink = sink + interpreter.Run(source).size(); });
+    Interpreter cached(16);
+    Benchmark(options, "run/cached", 1, [&] { sink = sink + cached.Run(source).size(); });
+}
+
+// A prepared expression with constant subtrees around a dynamic part, with and without folding.
+void BenchmarkFolding(const Options& options) {
+    std::string source =
+        "((lambda (n) (list (+ n (* 2 3)) (list 1 2 3) (max n (- 10 4)) (abs (- 1 9)))) 4)";
+    std::string buffer;
+    for (bool fold : {false, true}) {
+        Interpreter interpreter;
+        interpreter.SetConstantFolding(fold);
+        auto prepared = interpreter.Prepare(source);
+        Benchmark(options, fold ? "fold/on" : "fold/off", 1, [&] {
+            buffer.clear();
+            prepared.Execute(buffer);
+            sink = sink + buffer.size();
+        });
+    }
+}
+
+// Procedure calls, arithmetic on their arguments and list loops, walking the tree and run as
+// bytecode.
+void BenchmarkProcedures(const Options& options) {
+    std::pair<const char*, const char*> programs[] = {
+        {"fib_20", "(fib 20)"},
+        {"count_100000", "(count 100000 0)"},
+        {"list_sum_10000", "(sum (range 10000 '()) 0)"}};
+    std::string buffer;
+    for (auto mode : {EvalMode::TREE_WALK, EvalMode::BYTECODE}) {
+        Interpreter interpreter;
+        interpreter.SetEvalMode(mode);
+        interpreter.Run("(define (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))");
+        interpreter.Run("(define (count n acc) (if (= n 0) acc (count (- n 1) (+ acc 1))))");
+        interpreter.Run("(define (range n acc) (if (= n 0) acc (range (- n 1) (cons n acc))))");
+        interpreter.Run(
+            "(define (sum list acc) (if (null? list) acc (sum (cdr list) (+ acc (car list)))))");
+        for (auto [name, source] : programs) {
+            auto prepared = interpreter.Prepare(source);
+            std::string suffix = mode == EvalMode::BYTECODE ? "/bytecode" : "/tree";
+            Benchmark(options, "procedures/" + std::string(name) + suffix, 1, [&] {
+                buffer.clear();
+                prepared.Execute(buffer);
+                sink = sink + buffer.size();
+            });
+        }
+    }
+}
+
+// Lookup of a key among 10000, in a hash table and by walking a list.
+void BenchmarkHashTable(const Options& options) {
+    Interpreter interpreter;
+    interpreter.Run(
+        "(define (fill table i)"
+        "  (if (= i 10000) table (fill (hash-table-set! table i i) (+ i 1))))");
+    interpreter.Run("(define table (fill (make-hash-table) 0))");
+    interpreter.Run("(define numbers " + QuotedNumbers(10000) + ")");
+    std::pair<const char*, const char*> lookups[] = {
+        {"hash_table/ref_10000", "(hash-table-ref table 7777)"},
+        {"hash_table/list_ref_10000", "(list-ref numbers 7777)"}};
+    std::string buffer;
+    for (auto [name, source] : lookups) {
+        auto prepared = interpreter.Prepare(source);
+        Benchmark(options, name, 1, [&] {
+            buffer.clear();
+            prepared.Execute(buffer);
+            sink = sink + buffer.size();
+        });
+    }
+}
+
+}  // namespace
+
+void* operator new(size_t size) {
+    ++allocation_count;
+    allocation_bytes += size;
+    if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            options.filter = argv[++i];
+        } else if (std::strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            options.min_time = std::chrono::milliseconds(std::atoi(argv[++i]));
+        } else {
+            std::cerr << "usage: " << argv[0] << " [--filter substring] [--min-time ms]\n";
+            return 2;
+        }
+    }
+
+    std::cout << "benchmark,ops,ns_per_op,allocs_per_op,bytes_per_op,objects_per_op\n";
+    BenchmarkTokenizer(options);
+    BenchmarkReader(options);
+    BenchmarkEvaluator(options);
+    BenchmarkSerialiser(options);
+    BenchmarkEndToEnd(options);
+    BenchmarkFolding(options);
+    BenchmarkHashTable(options);
+    BenchmarkProcedures(options);
+}
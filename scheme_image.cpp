@@ -0,0 +1,65 @@
+#include <scheme.h>
+#include <mapped_file.h>
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// Precompiles source files (or stdin) into one AST image (see ast_image.h) with the forms of all
+// of them in order, which scheme_run and Interpreter::Prepare(image, form) load without
+// tokenizing and reading the text. Nothing is written if a form can't be read.
+//
+// usage: scheme_image -o output file...
+namespace {
+
+void AddForms(Tokenizer* tokenizer, AstImageWriter* writer) {
+    FormReader reader(tokenizer);
+    while (!reader.IsEnd()) {
+        writer->AddForm(reader.Next());
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const char* output = nullptr;
+    std::vector<const char*> paths;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (output == nullptr || paths.empty()) {
+        std::cerr << "usage: " << argv[0] << " -o output file...\n";
+        return 2;
+    }
+
+    AstImageWriter writer;
+    for (const char* path : paths) {
+        try {
+            if (std::strcmp(path, "-") == 0) {
+                Tokenizer tokenizer(&std::cin);
+                AddForms(&tokenizer, &writer);
+            } else {
+                MappedFile file(path);
+                Tokenizer tokenizer(file.View());
+                AddForms(&tokenizer, &writer);
+            }
+        } catch (const std::exception& e) {
+            std::cerr << argv[0] << ": " << path << ": " << e.what() << '\n';
+            return 1;
+        }
+    }
+
+    auto image = writer.Finish();
+    std::ofstream out(output, std::ios::binary);
+    out.write(image.data(), image.size());
+    out.close();
+    if (!out) {
+        std::cerr << argv[0] << ": can't write " << output << '\n';
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,182 @@
+#include <scheme.h>
+#include <mapped_file.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <optional>
+
+// Evaluates every form of a file (or stdin) and prints one result per line. A failing form
+// prints its error and the run goes on, unless the form couldn't be read at all. The file may
+// also be an AST image made by scheme_image, whose forms don't have to be read. With --dump
+// the forms are only prepared and their optimised trees are printed instead. With --stats the
+// runtime statistics are printed to stderr at the end (they are only collected in builds with
+// -DSCHEME_PROFILING=ON, other builds print a note instead). --max-steps and --timeout (in ms)
+// limit the evaluation of every form. --bytecode compiles the forms and procedure bodies to
+// bytecode.
+namespace {
+
+constexpr size_t kFlushSize = 1 << 16;
+
+// 0 is no limit.
+struct FormLimits {
+    size_t max_steps = 0;
+    std::chrono::milliseconds timeout{0};
+};
+
+class TextForms {
+public:
+    TextForms(const Interpreter* interpreter, Tokenizer* tokenizer)
+        : interpreter_(interpreter), reader_(tokenizer) {
+    }
+
+    bool IsEnd() {
+        return reader_.IsEnd();
+    }
+    PreparedExpression PrepareNext() {
+        return interpreter_->PrepareNext(&reader_);
+    }
+    bool IsBroken() const {
+        return reader_.IsBroken();
+    }
+
+private:
+    const Interpreter* interpreter_;
+    FormReader reader_;
+};
+
+class ImageForms {
+public:
+    ImageForms(const Interpreter* interpreter, const AstImage* image)
+        : interpreter_(interpreter), image_(image) {
+    }
+
+    bool IsEnd() {
+        return next_ == image_->Forms();
+    }
+    PreparedExpression PrepareNext() {
+        return interpreter_->Prepare(*image_, next_++);
+    }
+    bool IsBroken() const {
+        return false;
+    }
+
+private:
+    const Interpreter* interpreter_;
+    const AstImage* image_;
+    size_t next_ = 0;
+};
+
+// Results are serialised straight into one buffer which is written out in large blocks, or
+// after every form with flush_size 0: the next form of stdin may only be typed once the result
+// of the previous one was seen, so it is only waited for after that.
+template <class Forms>
+int RunForms(Forms* forms, bool dump, const FormLimits& limits, size_t flush_size,
+             std::ostream* out) {
+    std::string buffer;
+    buffer.reserve(2 * kFlushSize);
+    int status = 0;
+    while (true) {
+        std::optional<PreparedExpression> prepared;
+        size_t line_start = buffer.size();
+        try {
+            if (forms->IsEnd()) {
+                break;
+            }
+            prepared.emplace(forms->PrepareNext());
+            if (dump) {
+                buffer += prepared->Dump();
+            } else {
+                RunOptions options;
+                options.max_steps = limits.max_steps;
+                if (limits.timeout.count() > 0) {
+                    options.deadline = std::chrono::steady_clock::now() + limits.timeout;
+                }
+                prepared->Execute(buffer, options);
+            }
+        } catch (const std::exception& e) {
+            buffer.resize(line_start);
+            buffer.append("error: ").append(e.what());
+            status = 1;
+        }
+        buffer.push_back('\n');
+        if (forms->IsBroken()) {
+            break;
+        }
+        if (buffer.size() >= flush_size) {
+            out->write(buffer.data(), buffer.size());
+            buffer.clear();
+            if (flush_size == 0) {
+                out->flush();
+            }
+        }
+    }
+    out->write(buffer.data(), buffer.size());
+    return status;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Interpreter interpreter;
+    const char* path = nullptr;
+    bool dump = false;
+    bool stats = false;
+    FormLimits limits;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--bytecode") == 0) {
+            interpreter.SetEvalMode(EvalMode::BYTECODE);
+        } else if (std::strcmp(argv[i], "--no-fold") == 0) {
+            interpreter.SetConstantFolding(false);
+        } else if (std::strcmp(argv[i], "--dump") == 0) {
+            dump = true;
+        } else if (std::strcmp(argv[i], "--stats") == 0) {
+            stats = true;
+        } else if (std::strcmp(argv[i], "--max-steps") == 0 && i + 1 < argc) {
+            limits.max_steps = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--timeout") == 0 && i + 1 < argc) {
+            limits.timeout = std::chrono::milliseconds(std::atoll(argv[++i]));
+        } else if (path == nullptr) {
+            path = argv[i];
+        } else {
+            std::cerr << "usage: " << argv[0]
+                      << " [--bytecode] [--no-fold] [--dump] [--stats] [--max-steps n]"
+                         " [--timeout ms] [file]\n";
+            return 2;
+        }
+    }
+
+    std::ios::sync_with_stdio(false);
+
+    int status;
+    try {
+        if (path == nullptr || std::strcmp(path, "-") == 0) {
+            Tokenizer tokenizer(&std::cin);
+            TextForms forms(&interpreter, &tokenizer);
+            status = RunForms(&forms, dump, limits, 0, &std::cout);
+        } else if (auto file = std::make_unique<MappedFile>(path);
+                   AstImage::IsImage(file->View())) {
+            AstImage image(std::move(file), path);
+            ImageForms forms(&interpreter, &image);
+            status = RunForms(&forms, dump, limits, kFlushSize, &std::cout);
+        } else {
+            Tokenizer tokenizer(file->View());
+            TextForms forms(&interpreter, &tokenizer);
+            status = RunForms(&forms, dump, limits, kFlushSize, &std::cout);
+        }
+    } catch (const std::exception& e) {
+        std::cout.flush();
+        std::cerr << argv[0] << ": " << e.what() << '\n';
+        status = 1;
+    }
+    if (stats) {
+        std::cout.flush();
+        if (SCHEME_PROFILING) {
+            std::cerr << RuntimeStatsToList(interpreter.Stats())->Serialise() << '\n';
+        } else {
+            std::cerr << argv[0] << ": --stats needs a build with -DSCHEME_PROFILING=ON\n";
+        }
+    }
+    return status;
+}
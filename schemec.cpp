@@ -0,0 +1,1225 @@
+#include <scheme.h>
+#include <mapped_file.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <unistd.h>
+
+// Translates a program (the forms of a file or stdin) to C++ which evaluates every form like the
+// interpreter does, to be built into a shared object and loaded with LoadCompiledProgram.
+// Builtins are called directly instead of looking up their names, numbers whose type is known
+// stay unboxed, lets become blocks and lambdas C++ functions, where a call of the procedure
+// itself in tail position is a loop (other tail calls go through TailCall). Parts of top-level
+// code that aren't translated (and whole lambdas containing such parts) are evaluated by the
+// interpreter.
+//
+// usage: schemec [-o output.cpp] [file]
+//        schemec --test [file]
+//
+// --test builds the translation with $CXX (SCHEMEC_CXX by default), loads it and runs every
+// form both ways, the results (or errors) must be the same.
+
+#ifndef SCHEMEC_CXX
+#define SCHEMEC_CXX "c++"
+#endif
+
+#ifndef SCHEMEC_INCLUDE_DIR
+#define SCHEMEC_INCLUDE_DIR "."
+#endif
+
+namespace {
+
+enum class Type { OBJECT, INTEGER, BOOLEAN };
+
+// C++ expression of a value, evaluating it has no side effects.
+struct Value {
+    Type type;
+    std::string code;
+    // a variable of its own, it can be moved from
+    bool temporary = false;
+};
+
+// A node that can't be translated, the interpreter evaluates the top-level code around it.
+struct Unsupported : public std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+struct Variable {
+    std::string name;
+    Type type = Type::OBJECT;
+    // assigned by a define, so it is read through copies
+    bool defined = false;
+    // assigned by a define and captured by a procedure, kept in a box they share
+    bool boxed = false;
+};
+
+// Slots of a lambda, which is a procedure or a let inlined into the code around it.
+struct Scope {
+    std::vector<Variable> slots;
+    size_t procedure;
+};
+
+// C++ function being generated, for a lambda or for a whole form.
+struct Procedure {
+    const Lambda* lambda = nullptr;
+    // as (scope, slot), in the order of the procedure's captured values
+    std::vector<std::pair<size_t, size_t>> captures;
+    // the variables that get the arguments, assigned again by a call of the procedure itself
+    std::vector<std::string> params;
+    bool loops = false;
+};
+
+struct SlotUse {
+    std::vector<bool> defined;
+    std::vector<bool> captured;
+};
+
+const char* TypeName(Type type) {
+    switch (type) {
+        case Type::INTEGER:
+            return "int64_t";
+        case Type::BOOLEAN:
+            return "bool";
+        default:
+            return "std::shared_ptr<Object>";
+    }
+}
+
+std::string IntegerLiteral(int64_t value) {
+    if (value == std::numeric_limits<int64_t>::min()) {
+        return "std::numeric_limits<int64_t>::min()";
+    }
+    return "int64_t{" + std::to_string(value) + "}";
+}
+
+std::string StringLiteral(std::string_view text) {
+    std::string res = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            res.push_back('\\');
+        }
+        res.push_back(c);
+    }
+    return res + '"';
+}
+
+std::string Boxed(const Value& value) {
+    switch (value.type) {
+        case Type::INTEGER:
+            return "MakeNumber(" + value.code + ")";
+        case Type::BOOLEAN:
+            return "MakeBoolean(" + value.code + ")";
+        default:
+            return value.temporary ? "std::move(" + value.code + ")" : value.code;
+    }
+}
+
+std::string Converted(const Value& value, Type type) {
+    return type == value.type && type != Type::OBJECT ? value.code : Boxed(value);
+}
+
+std::string Truth(const Value& value) {
+    switch (value.type) {
+        case Type::INTEGER:
+            return "true";
+        case Type::BOOLEAN:
+            return value.code;
+        default:
+            return "IsTrue(" + value.code + ")";
+    }
+}
+
+std::string Indented(const std::string& code) {
+    std::string res;
+    size_t start = 0;
+    while (start < code.size()) {
+        size_t end = code.find('\n', start);
+        res += "    ";
+        res.append(code, start, end + 1 - start);
+        start = end + 1;
+    }
+    return res;
+}
+
+std::string AtomPart(const std::shared_ptr<Object>& obj) {
+    if (obj == nullptr) {
+        return "{EMPTY_LIST}";
+    }
+    if (auto* number = As<Number>(obj)) {
+        auto value = number->GetValue();
+        return "{NUMBER, 0, 0, 0, " + IntegerLiteral(value) + "}";
+    }
+    if (auto* boolean = As<Boolean>(obj)) {
+        return boolean->GetBool() ? "{BOOLEAN, 0, 0, 0, 1}" : "{BOOLEAN}";
+    }
+    return "{SYMBOL, 0, 0, 0, 0, " + StringLiteral(As<Symbol>(obj)->GetName()) + "}";
+}
+
+// A let, whose lambda is called right where it is made, doesn't need a procedure.
+bool IsInlined(const Call* call) {
+    const auto* lambda = As<Lambda>(call->GetFunction());
+    return lambda != nullptr && !lambda->HasRest() &&
+           lambda->GetParams() == call->GetArgs().size();
+}
+
+// Finds the slots of a scope that defines assign and that procedures capture, node is level
+// scopes inside of it.
+void FindSlotUse(const std::shared_ptr<Object>& node, size_t level, bool in_procedure,
+                 SlotUse* use) {
+    if (auto* ref = As<LocalRef>(node)) {
+        if (ref->GetDepth() == level && in_procedure) {
+            use->captured[ref->GetSlot()] = true;
+        }
+    } else if (auto* define = As<Define>(node)) {
+        if (level == 0 && define->GetSlot() != Define::kGlobal) {
+            use->defined[define->GetSlot()] = true;
+        }
+        FindSlotUse(define->GetValue(), level, in_procedure, use);
+    } else if (auto* branch = As<If>(node)) {
+        FindSlotUse(branch->GetTest(), level, in_procedure, use);
+        FindSlotUse(branch->GetConsequent(), level, in_procedure, use);
+        FindSlotUse(branch->GetAlternative(), level, in_procedure, use);
+    } else if (auto* lambda = As<Lambda>(node)) {
+        for (const auto& element : lambda->GetBody()) {
+            FindSlotUse(element, level + 1, true, use);
+        }
+    } else if (auto* call = As<Call>(node)) {
+        if (IsInlined(call)) {
+            for (const auto& element : As<Lambda>(call->GetFunction())->GetBody()) {
+                FindSlotUse(element, level + 1, in_procedure, use);
+            }
+        } else {
+            FindSlotUse(call->GetFunction(), level, in_procedure, use);
+        }
+        for (const auto& arg : call->GetArgs()) {
+            FindSlotUse(arg, level, in_procedure, use);
+        }
+    } else if (Is<Cell>(node) && !As<Cell>(node)->is_quoted) {
+        for (auto rest = node; Is<Cell>(rest); rest = As<Cell>(rest)->GetSecond()) {
+            FindSlotUse(As<Cell>(rest)->GetFirst(), level, in_procedure, use);
+            if (!Is<Cell>(As<Cell>(rest)->GetSecond())) {
+                FindSlotUse(As<Cell>(rest)->GetSecond(), level, in_procedure, use);
+            }
+        }
+    }
+}
+
+class Compiler {
+public:
+    void AddForm(std::shared_ptr<Object> form);
+
+    // The translation unit of the forms added so far.
+    std::string Output() const;
+
+    size_t Forms() const {
+        return forms_.size();
+    }
+    size_t TranslatedForms() const {
+        return std::count(is_translated_.begin(), is_translated_.end(), true);
+    }
+    size_t InterpretedNodes() const {
+        return interpreted_nodes_;
+    }
+
+private:
+    void Line(const std::string& text);
+    std::string NewTemp();
+    std::string NewVariable();
+
+    std::string SymbolConstant(const Symbol* symbol);
+    std::string BuiltinConstant(const Symbol* symbol);
+    std::string Datum(const std::shared_ptr<Object>& obj);
+    uint32_t Part(const std::shared_ptr<Object>& obj);
+
+    // At top level a node that can't be translated is interpreted, elsewhere the exception goes
+    // up to the top-level code.
+    Value Compile(const std::shared_ptr<Object>& node, bool tail);
+    Value CompileChild(const std::shared_ptr<Object>& node, bool tail,
+                       const std::vector<uint32_t>& steps);
+    std::pair<Value, std::string> CompileInBlock(const std::shared_ptr<Object>& node, bool tail,
+                                                 const std::vector<uint32_t>& steps);
+    Value Interpret(const std::string& reason);
+    Value Translate(const std::shared_ptr<Object>& node, bool tail);
+
+    Value Reference(size_t depth, size_t slot);
+    std::string Access(size_t scope, size_t slot);
+    std::string CapturedValue(size_t scope, size_t slot);
+    size_t Capture(size_t procedure, size_t scope, size_t slot);
+
+    Value TranslateApplication(const std::shared_ptr<Object>& node);
+    Value TranslateGlobalApplication(const Symbol* head, const std::shared_ptr<Object>& args);
+    Value TranslateBuiltin(const Symbol* head, const std::shared_ptr<Object>& args);
+    Value TranslateAndOr(const std::vector<std::shared_ptr<Object>>& args,
+                         const std::vector<std::vector<uint32_t>>& paths, bool is_and);
+    Value TranslateIf(const If* node, bool tail);
+    Value TranslateDefine(const Define* node);
+    Value TranslateCall(const Call* node, bool tail);
+    Value TranslateLet(const Call* node, bool tail);
+    Value TranslateLambda(const Lambda* node);
+    // Declares the variables of a new scope, the first values.size() slots get the values.
+    void OpenScope(const Lambda* lambda, const std::vector<Value>& values,
+                   const std::vector<std::string>& params);
+    Value CompileBody(const Lambda* lambda, bool tail);
+    std::string Call(const std::string& function, const std::vector<Value>& args);
+
+    std::vector<std::shared_ptr<Object>> forms_;
+    // objects whose addresses are keys of data_parts_ stay alive
+    std::vector<std::shared_ptr<Object>> resolved_;
+    std::vector<bool> is_translated_;
+    size_t interpreted_nodes_ = 0;
+
+    std::string constants_;
+    std::string parts_;
+    std::string elements_;
+    std::string functions_;
+    std::unordered_map<uint32_t, std::string> symbol_names_;
+    std::unordered_map<uint32_t, std::string> builtin_names_;
+    std::unordered_map<std::string, uint32_t> atom_parts_;
+    std::unordered_map<const Object*, uint32_t> data_parts_;
+    uint32_t part_count_ = 0;
+    uint32_t element_count_ = 0;
+    size_t next_name_ = 0;
+
+    // state of the form being translated
+    std::string tree_;
+    std::string* out_ = nullptr;
+    int indent_ = 0;
+    std::vector<uint32_t> path_;
+    std::vector<Scope> scopes_;
+    std::vector<Procedure> procedures_;
+};
+
+void Compiler::Line(const std::string& text) {
+    out_->append(indent_ * 4, ' ');
+    *out_ += text;
+    out_->push_back('\n');
+}
+
+std::string Compiler::NewTemp() {
+    return "v" + std::to_string(next_name_++);
+}
+
+std::string Compiler::NewVariable() {
+    return "x" + std::to_string(next_name_++);
+}
+
+std::string Compiler::SymbolConstant(const Symbol* symbol) {
+    auto& name = symbol_names_[symbol->GetId()];
+    if (name.empty()) {
+        name = "kSymbol" + std::to_string(symbol_names_.size());
+        constants_ += "const std::shared_ptr<Symbol> " + name + " = Symbol::Intern(" +
+                      StringLiteral(symbol->GetName()) + ");\n";
+    }
+    return name;
+}
+
+std::string Compiler::BuiltinConstant(const Symbol* symbol) {
+    auto& name = builtin_names_[symbol->GetId()];
+    if (name.empty()) {
+        name = "kBuiltin" + std::to_string(builtin_names_.size());
+        constants_ += "const std::shared_ptr<Function> " + name + " = FindBuiltin(" +
+                      StringLiteral(symbol->GetName()) + ");\n";
+    }
+    return name;
+}
+
+std::string Compiler::Datum(const std::shared_ptr<Object>& obj) {
+    return "kConstants[" + std::to_string(Part(obj)) + "]";
+}
+
+// Copies keep the flags of the cells and which parts are shared. The spine of a list is walked
+// in a loop, so long lists don't recurse.
+uint32_t Compiler::Part(const std::shared_ptr<Object>& obj) {
+    std::string key;
+    if (obj == nullptr) {
+        key = "()";
+    } else if (auto* number = As<Number>(obj)) {
+        key = std::to_string(number->GetValue());
+    } else if (auto* boolean = As<Boolean>(obj)) {
+        key = boolean->GetBool() ? "#t" : "#f";
+    } else if (auto* symbol = As<Symbol>(obj)) {
+        key = "'" + std::string(symbol->GetName());
+    } else if (!Is<Cell>(obj) && !Is<Vector>(obj)) {
+        throw Unsupported(std::string("a constant ") + ObjectTypeName(obj->GetType()));
+    }
+    if (!key.empty()) {
+        auto [it, inserted] = atom_parts_.emplace(key, part_count_);
+        if (inserted) {
+            parts_ += "    " + AtomPart(obj) + ",\n";
+            ++part_count_;
+        }
+        return it->second;
+    }
+    if (auto it = data_parts_.find(obj.get()); it != data_parts_.end()) {
+        return it->second;
+    }
+    if (auto* vector = As<Vector>(obj)) {
+        std::vector<uint32_t> indices;
+        for (const auto& element : vector->GetElements()) {
+            indices.push_back(Part(element));
+        }
+        parts_ += "    {VECTOR, " + std::to_string(element_count_) + ", " +
+                  std::to_string(indices.size()) + "},\n";
+        for (uint32_t index : indices) {
+            elements_ += "    " + std::to_string(index) + ",\n";
+        }
+        element_count_ += indices.size();
+        return data_parts_[obj.get()] = part_count_++;
+    }
+    std::vector<Cell*> spine;
+    auto rest = obj;
+    while (Is<Cell>(rest) && !data_parts_.contains(rest.get())) {
+        spine.push_back(As<Cell>(rest));
+        rest = As<Cell>(rest)->GetSecond();
+    }
+    uint32_t second = Part(rest);
+    for (size_t i = spine.size(); i-- > 0;) {
+        uint32_t first = Part(spine[i]->GetFirst());
+        std::string flags;
+        if (spine[i]->IsListMarked()) {
+            flags = "LIST";
+        }
+        if (spine[i]->is_quoted) {
+            flags += flags.empty() ? "QUOTED" : " | QUOTED";
+        }
+        parts_ += "    {CELL, " + std::to_string(first) + ", " + std::to_string(second) +
+                  (flags.empty() ? "" : ", " + flags) + "},\n";
+        second = data_parts_[spine[i]] = part_count_++;
+    }
+    return second;
+}
+
+void Compiler::AddForm(std::shared_ptr<Object> form) {
+    size_t index = forms_.size();
+    forms_.push_back(form);
+    is_translated_.push_back(false);
+    tree_ = Datum(form);
+    functions_ += "const std::shared_ptr<Object>& Tree" + std::to_string(index) + "() {\n" +
+                  "    return " + tree_ + ";\n}\n\n";
+
+    std::shared_ptr<Object> resolved;
+    try {
+        resolved = Resolve(form);
+    } catch (const SyntaxError&) {
+        // fails when it is prepared
+        return;
+    }
+    if (resolved == nullptr) {
+        return;
+    }
+    resolved_.push_back(resolved);
+
+    std::string body;
+    out_ = &body;
+    indent_ = 1;
+    path_.clear();
+    scopes_.clear();
+    procedures_.assign(1, Procedure());
+    auto value = Compile(resolved, false);
+    Line("return " + (value.type == Type::OBJECT ? value.code : Boxed(value)) + ";");
+    functions_ += "std::shared_ptr<Object> Form" + std::to_string(index) + "() {\n" + body +
+                  "}\n\n";
+    is_translated_.back() = true;
+}
+
+std::string Compiler::Output() const {
+    std::string res = "// Generated by schemec, do not edit.\n\n#include <compiled.h>\n\n";
+    res += "namespace {\n\nusing enum ConstantPart::Kind;\nusing enum ConstantPart::Flags;\n\n";
+    res += "const ConstantPart kParts[] = {\n" + (parts_.empty() ? "    {EMPTY_LIST},\n" : parts_) +
+           "};\n\n";
+    res += "const uint32_t kElements[] = {\n" + elements_ + "    0,\n};\n\n";
+    res += "const std::vector<std::shared_ptr<Object>>& kConstants =\n"
+           "    BuildConstants(kParts, std::span(kElements, " +
+           std::to_string(element_count_) + "));\n\n";
+    res += constants_ + '\n' + functions_ + "}  // namespace\n\n";
+    res += "extern \"C\" const CompiledProgram* SchemeCompiledProgram() {\n";
+    if (forms_.empty()) {
+        res += "    static const CompiledProgram kProgram{};\n";
+    } else {
+        res += "    static const CompiledForm kForms[] = {\n";
+        for (size_t i = 0; i < forms_.size(); ++i) {
+            auto index = std::to_string(i);
+            res += "        {" + (is_translated_[i] ? "&Form" + index : "nullptr") + ", &Tree" +
+                   index + "},\n";
+        }
+        res += "    };\n    static const CompiledProgram kProgram{kForms};\n";
+    }
+    res += "    return &kProgram;\n}\n";
+    return res;
+}
+
+Value Compiler::Compile(const std::shared_ptr<Object>& node, bool tail) {
+    if (!scopes_.empty()) {
+        return Translate(node, tail);
+    }
+    std::string code;
+    std::string* out = out_;
+    int indent = indent_;
+    size_t procedures = procedures_.size();
+    size_t functions = functions_.size();
+    out_ = &code;
+    try {
+        auto value = Translate(node, tail);
+        out_ = out;
+        *out_ += code;
+        return value;
+    } catch (const Unsupported& e) {
+        out_ = out;
+        indent_ = indent;
+        scopes_.clear();
+        procedures_.resize(procedures);
+        functions_.resize(functions);
+        ++interpreted_nodes_;
+        return Interpret(e.what());
+    }
+}
+
+Value Compiler::CompileChild(const std::shared_ptr<Object>& node, bool tail,
+                             const std::vector<uint32_t>& steps) {
+    size_t depth = path_.size();
+    path_.insert(path_.end(), steps.begin(), steps.end());
+    auto value = Compile(node, tail);
+    path_.resize(depth);
+    return value;
+}
+
+// The code goes into a block one level deeper, which the caller writes out.
+std::pair<Value, std::string> Compiler::CompileInBlock(const std::shared_ptr<Object>& node,
+                                                       bool tail,
+                                                       const std::vector<uint32_t>& steps) {
+    std::string code;
+    std::string* out = out_;
+    out_ = &code;
+    ++indent_;
+    auto value = CompileChild(node, tail, steps);
+    --indent_;
+    out_ = out;
+    return {std::move(value), std::move(code)};
+}
+
+Value Compiler::Interpret(const std::string& reason) {
+    std::string path;
+    for (uint32_t step : path_) {
+        path += (path.empty() ? "" : ", ") + std::to_string(step);
+    }
+    auto node = "kNode" + std::to_string(next_name_++);
+    auto temp = NewTemp();
+    Line("// interpreted: " + reason);
+    Line("static const std::shared_ptr<Object> " + node + " = ResolvedNode(" + tree_ + ", {" +
+         path + "});");
+    Line("std::shared_ptr<Object> " + temp + " = Evaluate(" + node + ");");
+    return {Type::OBJECT, temp, true};
+}
+
+Value Compiler::Translate(const std::shared_ptr<Object>& node, bool tail) {
+    if (node == nullptr) {
+        return {Type::OBJECT, "nullptr"};
+    }
+    switch (node->GetType()) {
+        case ObjectType::NUMBER:
+            return {Type::INTEGER, IntegerLiteral(As<Number>(node)->GetValue())};
+        case ObjectType::BOOLEAN:
+            return {Type::BOOLEAN, As<Boolean>(node)->GetBool() ? "true" : "false"};
+        case ObjectType::VECTOR:
+            return {Type::OBJECT, Datum(node)};
+        case ObjectType::CONSTANT:
+            return {Type::OBJECT, Datum(As<Constant>(node)->GetValue())};
+        case ObjectType::SYMBOL: {
+            auto* symbol = As<Symbol>(node);
+            if (symbol->IsBuiltin()) {
+                return {Type::OBJECT, BuiltinConstant(symbol)};
+            }
+            auto temp = NewTemp();
+            Line("std::shared_ptr<Object> " + temp + " = " + SymbolConstant(symbol) + "->Eval();");
+            return {Type::OBJECT, temp, true};
+        }
+        case ObjectType::LOCAL_REF:
+            return Reference(As<LocalRef>(node)->GetDepth(), As<LocalRef>(node)->GetSlot());
+        case ObjectType::CELL:
+            if (As<Cell>(node)->is_quoted) {
+                return {Type::OBJECT, Datum(node)};
+            }
+            return TranslateApplication(node);
+        case ObjectType::IF:
+            return TranslateIf(As<If>(node), tail);
+        case ObjectType::DEFINE:
+            return TranslateDefine(As<Define>(node));
+        case ObjectType::CALL:
+            return TranslateCall(As<::Call>(node), tail);
+        case ObjectType::LAMBDA:
+            return TranslateLambda(As<Lambda>(node));
+        default:
+            throw Unsupported(std::string("a ") + ObjectTypeName(node->GetType()));
+    }
+}
+
+//////////////////////////////// Variables
+
+Value Compiler::Reference(size_t depth, size_t slot) {
+    size_t scope = scopes_.size() - 1 - depth;
+    const auto& variable = scopes_[scope].slots[slot];
+    auto code = Access(scope, slot);
+    if (!variable.defined) {
+        return {variable.type, code};
+    }
+    auto temp = NewTemp();
+    Line("std::shared_ptr<Object> " + temp + " = " + code + ";");
+    return {Type::OBJECT, temp, true};
+}
+
+// Current value of a variable in the procedure being generated.
+std::string Compiler::Access(size_t scope, size_t slot) {
+    const auto& variable = scopes_[scope].slots[slot];
+    if (scopes_[scope].procedure == procedures_.size() - 1) {
+        return variable.boxed ? variable.name + "->Get(0, 0)" : variable.name;
+    }
+    auto captured = "self.GetCaptured(" +
+                    std::to_string(Capture(procedures_.size() - 1, scope, slot)) + ")";
+    if (variable.boxed) {
+        return "Unbox(" + captured + ")";
+    }
+    switch (variable.type) {
+        case Type::INTEGER:
+            return "As<Number>(" + captured + ")->GetValue()";
+        case Type::BOOLEAN:
+            return "IsTrue(" + captured + ")";
+        default:
+            return captured;
+    }
+}
+
+// What a procedure made in the one being generated captures for a variable: the box or the
+// boxed value.
+std::string Compiler::CapturedValue(size_t scope, size_t slot) {
+    const auto& variable = scopes_[scope].slots[slot];
+    if (scopes_[scope].procedure == procedures_.size() - 1) {
+        return variable.boxed ? variable.name : Boxed({variable.type, variable.name});
+    }
+    return "self.GetCaptured(" + std::to_string(Capture(procedures_.size() - 1, scope, slot)) +
+           ")";
+}
+
+size_t Compiler::Capture(size_t procedure, size_t scope, size_t slot) {
+    auto& captures = procedures_[procedure].captures;
+    auto it = std::find(captures.begin(), captures.end(), std::make_pair(scope, slot));
+    if (it != captures.end()) {
+        return it - captures.begin();
+    }
+    captures.emplace_back(scope, slot);
+    return captures.size() - 1;
+}
+
+void Compiler::OpenScope(const Lambda* lambda, const std::vector<Value>& values,
+                         const std::vector<std::string>& params) {
+    SlotUse use;
+    use.defined.resize(lambda->GetFrameSize());
+    use.captured.resize(lambda->GetFrameSize());
+    for (const auto& element : lambda->GetBody()) {
+        FindSlotUse(element, 0, false, &use);
+    }
+
+    Scope scope{{}, procedures_.size() - 1};
+    for (size_t slot = 0; slot < lambda->GetFrameSize(); ++slot) {
+        Variable variable;
+        variable.name = NewVariable();
+        variable.defined = use.defined[slot];
+        variable.boxed = use.defined[slot] && use.captured[slot];
+        std::string init;
+        if (slot < params.size()) {
+            init = params[slot];
+        } else if (slot < values.size()) {
+            const auto& value = values[slot];
+            if (!variable.defined) {
+                variable.type = value.type;
+            }
+            init = Converted(value, variable.type);
+        }
+        if (variable.boxed) {
+            Line("std::shared_ptr<Frame> " + variable.name + " = MakeBox(" +
+                 (init.empty() ? "nullptr" : init) + ");");
+        } else if (slot < params.size() && init == params[slot]) {
+            variable.name = params[slot];
+        } else {
+            Line(std::string(TypeName(variable.type)) + ' ' + variable.name +
+                 (init.empty() ? "" : " = " + init) + ";");
+        }
+        scope.slots.push_back(std::move(variable));
+    }
+    scopes_.push_back(std::move(scope));
+}
+
+Value Compiler::CompileBody(const Lambda* lambda, bool tail) {
+    const auto& body = lambda->GetBody();
+    for (size_t i = 0; i + 1 < body.size(); ++i) {
+        Compile(body[i], false);
+    }
+    return Compile(body.back(), tail);
+}
+
+//////////////////////////////// Forms
+
+Value Compiler::TranslateIf(const If* node, bool tail) {
+    auto test = CompileChild(node->GetTest(), false, {0});
+    auto [consequent, consequent_code] = CompileInBlock(node->GetConsequent(), tail, {1});
+    auto [alternative, alternative_code] = CompileInBlock(node->GetAlternative(), tail, {2});
+    Type type = consequent.type == alternative.type ? consequent.type : Type::OBJECT;
+    auto temp = NewTemp();
+    Line(std::string(TypeName(type)) + ' ' + temp + ";");
+    Line("if (" + Truth(test) + ") {");
+    *out_ += consequent_code;
+    Line("    " + temp + " = " + Converted(consequent, type) + ";");
+    Line("} else {");
+    *out_ += alternative_code;
+    Line("    " + temp + " = " + Converted(alternative, type) + ";");
+    Line("}");
+    return {type, temp, true};
+}
+
+Value Compiler::TranslateDefine(const Define* node) {
+    auto value = CompileChild(node->GetValue(), false, {0});
+    auto name = SymbolConstant(node->GetName().get());
+    if (node->GetSlot() == Define::kGlobal) {
+        Line("DefineGlobal(" + name + ", " + Boxed(value) + ");");
+        return {Type::OBJECT, name};
+    }
+    const auto& variable = scopes_.back().slots[node->GetSlot()];
+    if (variable.boxed) {
+        Line(variable.name + "->Set(0, " + Boxed(value) + ");");
+    } else {
+        Line(variable.name + " = " + Boxed(value) + ";");
+    }
+    return {Type::OBJECT, name};
+}
+
+Value Compiler::TranslateCall(const ::Call* node, bool tail) {
+    if (IsInlined(node)) {
+        return TranslateLet(node, tail);
+    }
+    Line("LimitsScope::CountStep();");
+    auto function = CompileChild(node->GetFunction(), false, {0});
+    if (function.type != Type::OBJECT) {
+        auto temp = NewTemp();
+        Line("std::shared_ptr<Object> " + temp + " = " + Boxed(function) + ";");
+        function = {Type::OBJECT, temp, true};
+    }
+    std::vector<Value> args;
+    for (size_t i = 0; i < node->GetArgs().size(); ++i) {
+        args.push_back(CompileChild(node->GetArgs()[i], false, {static_cast<uint32_t>(i + 1)}));
+    }
+
+    auto& procedure = procedures_.back();
+    bool is_tail = tail && node->IsTail() && procedure.lambda != nullptr;
+    if (is_tail && !procedure.lambda->HasRest() && args.size() == procedure.lambda->GetParams()) {
+        // the arguments may refer to the parameters, so they are all evaluated first
+        procedure.loops = true;
+        Line("if (" + function.code + ".get() == &self) {");
+        std::vector<std::string> temps;
+        for (const auto& arg : args) {
+            temps.push_back(NewTemp());
+            Line("    std::shared_ptr<Object> " + temps.back() + " = " + Boxed(arg) + ";");
+        }
+        for (size_t i = 0; i < args.size(); ++i) {
+            Line("    " + procedure.params[i] + " = std::move(" + temps[i] + ");");
+        }
+        Line("    continue;");
+        Line("}");
+        for (auto& arg : args) {
+            arg.temporary = false;
+        }
+    }
+    auto temp = NewTemp();
+    Line("std::shared_ptr<Object> " + temp + " = " +
+         Call((is_tail ? "TailCall(" : "CallProcedure(") + function.code, args) + ";");
+    return {Type::OBJECT, temp, true};
+}
+
+Value Compiler::TranslateLet(const ::Call* node, bool tail) {
+    const auto* lambda = As<Lambda>(node->GetFunction());
+    std::vector<Value> values;
+    for (size_t i = 0; i < node->GetArgs().size(); ++i) {
+        values.push_back(CompileChild(node->GetArgs()[i], false, {static_cast<uint32_t>(i + 1)}));
+    }
+    std::string code;
+    std::string* out = out_;
+    out_ = &code;
+    ++indent_;
+    OpenScope(lambda, values, {});
+    auto value = CompileBody(lambda, tail);
+    scopes_.pop_back();
+    --indent_;
+    out_ = out;
+
+    auto temp = NewTemp();
+    Line(std::string(TypeName(value.type)) + ' ' + temp + ";");
+    Line("{");
+    *out_ += code;
+    Line("    " + temp + " = " + Converted(value, value.type) + ";");
+    Line("}");
+    return {value.type, temp, true};
+}
+
+Value Compiler::TranslateLambda(const Lambda* node) {
+    auto name = "Procedure" + std::to_string(next_name_++);
+    std::string code;
+    std::string* out = out_;
+    int indent = indent_;
+    out_ = &code;
+    indent_ = 1;
+    procedures_.emplace_back();
+    procedures_.back().lambda = node;
+
+    size_t fixed = node->HasRest() ? node->GetParams() - 1 : node->GetParams();
+    std::vector<std::string> params;
+    for (size_t i = 0; i < node->GetParams(); ++i) {
+        params.push_back(NewVariable());
+        Line("std::shared_ptr<Object> " + params.back() + " = " +
+             (i < fixed ? "args[" + std::to_string(i) + "]"
+                        : "RestArguments(args.subspan(" + std::to_string(fixed) + "))") +
+             ";");
+    }
+    procedures_.back().params = params;
+    std::string body;
+    out_ = &body;
+    Line("LimitsScope::CountStep();");
+    OpenScope(node, {}, params);
+    auto value = CompileBody(node, true);
+    Line("return " + (value.type == Type::OBJECT ? value.code : Boxed(value)) + ";");
+    scopes_.pop_back();
+
+    auto procedure = std::move(procedures_.back());
+    procedures_.pop_back();
+    out_ = out;
+    indent_ = indent;
+    functions_ += "std::shared_ptr<Object> " + name +
+                  "([[maybe_unused]] const CompiledProcedure& self,\n" +
+                  std::string(name.size() + 25, ' ') +
+                  "std::span<const std::shared_ptr<Object>> args) {\n" +
+                  "    CheckArgumentCount(args.size(), " + std::to_string(node->GetParams()) +
+                  ", " + (node->HasRest() ? "true" : "false") + ");\n" + code;
+    if (procedure.loops) {
+        functions_ += "    while (true) {\n" + Indented(body) + "    }\n";
+    } else {
+        functions_ += body;
+    }
+    functions_ += "}\n\n";
+
+    std::string captured;
+    for (const auto& [scope, slot] : procedure.captures) {
+        captured += (captured.empty() ? "" : ", ") + CapturedValue(scope, slot);
+    }
+    auto temp = NewTemp();
+    Line("std::shared_ptr<Object> " + temp + " = Make<CompiledProcedure>(&" + name +
+         ", std::vector<std::shared_ptr<Object>>{" + captured + "});");
+    return {Type::OBJECT, temp, true};
+}
+
+//////////////////////////////// Applications
+
+// Arguments go into an array on the native stack.
+std::string Compiler::Call(const std::string& function, const std::vector<Value>& args) {
+    if (args.empty()) {
+        return function + ", {})";
+    }
+    auto array = NewTemp();
+    std::string elements;
+    for (const auto& arg : args) {
+        elements += (elements.empty() ? "" : ", ") + Boxed(arg);
+    }
+    Line("const std::shared_ptr<Object> " + array + "[] = {" + elements + "};");
+    return function + ", " + array + ")";
+}
+
+Value Compiler::TranslateApplication(const std::shared_ptr<Object>& node) {
+    const auto* head = As<Symbol>(As<Cell>(node)->GetFirst());
+    if (head == nullptr) {
+        throw Unsupported("an application of something that isn't a name");
+    }
+    if (head->IsBuiltin()) {
+        return TranslateBuiltin(head, As<Cell>(node)->GetSecond());
+    }
+    // only applications at top level stay cells
+    if (!scopes_.empty()) {
+        throw Unsupported("an application of a global name in a procedure");
+    }
+    return TranslateGlobalApplication(head, As<Cell>(node)->GetSecond());
+}
+
+// Evaluated like Cell::Eval does, applying a value that isn't a procedure is left to it.
+Value Compiler::TranslateGlobalApplication(const Symbol* head,
+                                           const std::shared_ptr<Object>& args) {
+    auto function = NewTemp();
+    auto temp = NewTemp();
+    Line("std::shared_ptr<Object> " + function + " = " + SymbolConstant(head) + "->Eval();");
+    Line("std::shared_ptr<Object> " + temp + ";");
+    Line("if (Is<Function>(" + function + ")) {");
+    ++indent_;
+    std::vector<Value> values;
+    std::vector<uint32_t> steps = {1};
+    auto rest = args;
+    for (; Is<Cell>(rest); rest = As<Cell>(rest)->GetSecond()) {
+        steps.push_back(0);
+        values.push_back(CompileChild(As<Cell>(rest)->GetFirst(), false, steps));
+        steps.back() = 1;
+    }
+    if (rest != nullptr) {
+        values.push_back(CompileChild(rest, false, steps));
+    }
+    Line(temp + " = " + Call("Invoke(As<Function>(" + function + ")", values) + ";");
+    --indent_;
+    Line("} else {");
+    ++indent_;
+    auto interpreted = Interpret("application of something that isn't a procedure");
+    Line(temp + " = std::move(" + interpreted.code + ");");
+    --indent_;
+    Line("}");
+    return {Type::OBJECT, temp, true};
+}
+
+Value Compiler::TranslateBuiltin(const Symbol* head, const std::shared_ptr<Object>& args_node) {
+    auto kind = FunctionsMap()[head->GetId()].function->GetKind();
+    if (kind == FunctionKind::QUOTE) {
+        return {Type::OBJECT, Datum(args_node)};
+    }
+
+    // a dotted tail is one more argument
+    std::vector<std::shared_ptr<Object>> args;
+    std::vector<std::vector<uint32_t>> paths;
+    std::vector<uint32_t> steps = {1};
+    auto rest = args_node;
+    for (; Is<Cell>(rest); rest = As<Cell>(rest)->GetSecond()) {
+        args.push_back(As<Cell>(rest)->GetFirst());
+        steps.push_back(0);
+        paths.push_back(steps);
+        steps.back() = 1;
+    }
+    if (rest != nullptr) {
+        args.push_back(rest);
+        paths.push_back(steps);
+    }
+    if (kind == FunctionKind::AND || kind == FunctionKind::OR) {
+        return TranslateAndOr(args, paths, kind == FunctionKind::AND);
+    }
+
+    std::vector<Value> values;
+    for (size_t i = 0; i < args.size(); ++i) {
+        values.push_back(CompileChild(args[i], false, paths[i]));
+    }
+    auto builtin = BuiltinConstant(head);
+    auto temp = NewTemp();
+
+    // numbers may be unboxed when the builtin throws for anything else, or always gives a
+    // boolean
+    const char* fold = nullptr;
+    const char* order = nullptr;
+    size_t min_args = 1;
+    size_t max_args = SIZE_MAX;
+    switch (kind) {
+        case FunctionKind::SUM:
+            fold = "WrappingAdd";
+            min_args = 0;
+            break;
+        case FunctionKind::SUBTRACTION:
+            fold = "WrappingSubtract";
+            break;
+        case FunctionKind::PRODUCT:
+            fold = "WrappingMultiply";
+            min_args = 0;
+            break;
+        case FunctionKind::DIVISION:
+            fold = "Divide";
+            break;
+        case FunctionKind::MAX:
+            fold = "std::max";
+            break;
+        case FunctionKind::MIN:
+            fold = "std::min";
+            break;
+        case FunctionKind::ABS:
+            fold = "WrappingAbs";
+            max_args = 1;
+            break;
+        case FunctionKind::INCREASING:
+            order = " < ";
+            break;
+        case FunctionKind::INCREASING_OR_EQUAL:
+            order = " <= ";
+            break;
+        case FunctionKind::DECREASING:
+            order = " > ";
+            break;
+        case FunctionKind::DECREASING_OR_EQUAL:
+            order = " >= ";
+            break;
+        case FunctionKind::EQUAL:
+            order = " == ";
+            break;
+        default:
+            break;
+    }
+    if ((fold != nullptr || order != nullptr) && values.size() >= min_args &&
+        values.size() <= max_args) {
+        std::vector<std::string> numbers;
+        std::string checks;
+        bool possible = true;
+        for (const auto& value : values) {
+            if (value.type == Type::INTEGER) {
+                numbers.push_back(value.code);
+            } else if (value.type == Type::OBJECT) {
+                numbers.push_back("As<Number>(" + value.code + ")->GetValue()");
+                checks += (checks.empty() ? "" : " && ") + ("Is<Number>(" + value.code + ")");
+            } else {
+                possible = false;
+            }
+        }
+        std::string expression;
+        if (numbers.empty()) {
+            expression = kind == FunctionKind::SUM ? "0" : "1";
+        } else if (order != nullptr) {
+            for (size_t i = 0; i + 1 < numbers.size(); ++i) {
+                expression += (expression.empty() ? "" : " && ") + numbers[i] + order +
+                              numbers[i + 1];
+            }
+            if (expression.empty()) {
+                expression = "true";
+            }
+        } else if (kind == FunctionKind::ABS) {
+            expression = "WrappingAbs(" + numbers[0] + ")";
+        } else {
+            expression = numbers[0];
+            for (size_t i = 1; i < numbers.size(); ++i) {
+                expression = std::string(fold) + "(" + expression + ", " + numbers[i] + ")";
+            }
+        }
+        Type type = order != nullptr ? Type::BOOLEAN : Type::INTEGER;
+        std::string fallback = Call(order != nullptr ? "ApplyForTest(" + builtin + ".get()"
+                                                     : "ApplyForNumber(" + builtin + ".get()",
+                                    {});
+        if (possible && checks.empty()) {
+            Line(std::string(TypeName(type)) + ' ' + temp + " = " + expression + ";");
+        } else {
+            std::string boxed;
+            for (const auto& value : values) {
+                boxed += (boxed.empty() ? "" : ", ") + Boxed(value);
+            }
+            fallback = (order != nullptr ? "ApplyForTest(" : "ApplyForNumber(") + builtin +
+                       ".get(), {" + boxed + "})";
+            if (!possible) {
+                Line(std::string(TypeName(type)) + ' ' + temp + " = " + fallback + ";");
+            } else {
+                Line(std::string(TypeName(type)) + ' ' + temp + ";");
+                Line("if (" + checks + ") {");
+                Line("    " + temp + " = " + expression + ";");
+                Line("} else {");
+                Line("    " + temp + " = " + fallback + ";");
+                Line("}");
+            }
+        }
+        return {type, temp, true};
+    }
+
+    // predicates that only look at their first argument
+    if (!values.empty()) {
+        const auto& value = values.front();
+        std::string test;
+        bool single = values.size() == 1;
+        switch (kind) {
+            case FunctionKind::INTEGER_PREDICATE:
+                test = value.type == Type::OBJECT ? "Is<Number>(" + value.code + ")"
+                       : value.type == Type::INTEGER ? "true"
+                                                     : "false";
+                break;
+            case FunctionKind::BOOLEAN_PREDICATE:
+                if (single) {
+                    test = value.type == Type::OBJECT ? "Is<Boolean>(" + value.code + ")"
+                           : value.type == Type::BOOLEAN ? "true"
+                                                         : "false";
+                }
+                break;
+            case FunctionKind::NOT:
+                if (single) {
+                    test = value.type == Type::OBJECT    ? "!IsTrue(" + value.code + ")"
+                           : value.type == Type::BOOLEAN ? "!" + value.code
+                                                         : "false";
+                }
+                break;
+            case FunctionKind::NULL_PREDICATE:
+                test = value.type == Type::OBJECT ? value.code + " == nullptr" : "false";
+                break;
+            case FunctionKind::PAIR_PREDICATE:
+                test = value.type == Type::OBJECT ? "Is<Cell>(" + value.code + ")" : "false";
+                break;
+            case FunctionKind::VECTOR_PREDICATE:
+                if (single) {
+                    test = value.type == Type::OBJECT ? "Is<Vector>(" + value.code + ")" : "false";
+                }
+                break;
+            default:
+                break;
+        }
+        if (!test.empty()) {
+            Line("bool " + temp + " = " + test + ";");
+            return {Type::BOOLEAN, temp, true};
+        }
+    }
+
+    Line("std::shared_ptr<Object> " + temp + " = " + Call("Invoke(" + builtin + ".get()", values) +
+         ";");
+    return {Type::OBJECT, temp, true};
+}
+
+// The arguments after the first one are evaluated in nested blocks, as long as the ones before
+// them allow.
+Value Compiler::TranslateAndOr(const std::vector<std::shared_ptr<Object>>& args,
+                               const std::vector<std::vector<uint32_t>>& paths, bool is_and) {
+    if (args.empty()) {
+        return {Type::BOOLEAN, is_and ? "true" : "false"};
+    }
+    std::vector<std::pair<Value, std::string>> parts;
+    int indent = indent_;
+    for (size_t i = 0; i < args.size(); ++i) {
+        indent_ = indent + i - 1;
+        parts.push_back(CompileInBlock(args[i], false, paths[i]));
+    }
+    indent_ = indent;
+    Type type = Type::BOOLEAN;
+    for (const auto& [value, code] : parts) {
+        if (value.type != Type::BOOLEAN) {
+            type = Type::OBJECT;
+        }
+    }
+    auto temp = NewTemp();
+    Line(std::string(TypeName(type)) + ' ' + temp + ";");
+    for (size_t i = 0; i < parts.size(); ++i) {
+        *out_ += parts[i].second;
+        Line(std::string(i * 4, ' ') + temp + " = " + Converted(parts[i].first, type) + ";");
+        if (i + 1 < parts.size()) {
+            Value current{type, temp};
+            Line(std::string(i * 4, ' ') + "if (" + (is_and ? "" : "!") + Truth(current) + ") {");
+        }
+    }
+    for (size_t i = parts.size() - 1; i-- > 0;) {
+        Line(std::string(i * 4, ' ') + "}");
+    }
+    return {type, temp, true};
+}
+
+//////////////////////////////// Driver
+
+std::string ReadInput(const char* path) {
+    if (path == nullptr || std::strcmp(path, "-") == 0) {
+        return std::string(std::istreambuf_iterator<char>(std::cin),
+                           std::istreambuf_iterator<char>());
+    }
+    MappedFile file(path);
+    return std::string(file.View());
+}
+
+void Translate(const std::string& source, Compiler* compiler) {
+    Tokenizer tokenizer{std::string_view(source)};
+    FormReader reader(&tokenizer);
+    while (!reader.IsEnd()) {
+        compiler->AddForm(reader.Next());
+    }
+}
+
+std::string Result(const std::function<PreparedExpression()>& prepare) {
+    std::string res;
+    try {
+        prepare().Execute(res);
+    } catch (const std::exception& e) {
+        res = std::string("error: ") + e.what();
+    }
+    return res;
+}
+
+// Returns the number of forms whose results differ.
+size_t Test(const std::string& source, const Compiler& compiler) {
+    auto directory =
+        std::filesystem::temp_directory_path() / ("schemec-" + std::to_string(getpid()));
+    std::filesystem::create_directories(directory);
+    auto cpp = (directory / "program.cpp").string();
+    auto library = (directory / "program.so").string();
+    std::ofstream(cpp) << compiler.Output();
+
+    const char* cxx = std::getenv("CXX");
+    const char* flags = std::getenv("CXXFLAGS");
+    std::string command = std::string(cxx != nullptr ? cxx : SCHEMEC_CXX) +
+                          " -std=c++20 -O2 -fPIC -shared -DSCHEME_PROFILING=" +
+                          std::to_string(SCHEME_PROFILING) + " -I" + SCHEMEC_INCLUDE_DIR + ' ' +
+                          (flags != nullptr ? flags : "") + ' ' + cpp + " -o " + library;
+    int status = std::system(command.c_str());
+    const CompiledProgram* program = nullptr;
+    if (status == 0) {
+        program = &LoadCompiledProgram(library);
+    }
+    std::filesystem::remove_all(directory);
+    if (program == nullptr) {
+        throw std::runtime_error("failed: " + command);
+    }
+
+    Interpreter interpreted;
+    Interpreter compiled;
+    Tokenizer tokenizer{std::string_view(source)};
+    FormReader reader(&tokenizer);
+    size_t differences = 0;
+    for (const auto& form : program->forms) {
+        auto expected = Result([&] { return interpreted.PrepareNext(&reader); });
+        auto actual = Result([&] { return compiled.Prepare(form); });
+        if (actual != expected) {
+            std::cout << "form " << &form - program->forms.data() << ": interpreted " << expected
+                      << ", compiled " << actual << '\n';
+            ++differences;
+        }
+    }
+    return differences;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const char* path = nullptr;
+    const char* output = nullptr;
+    bool test = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--test") == 0) {
+            test = true;
+        } else if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (path == nullptr) {
+            path = argv[i];
+        } else {
+            std::cerr << "usage: " << argv[0] << " [-o output.cpp] [file]\n"
+                      << "       " << argv[0] << " --test [file]\n";
+            return 2;
+        }
+    }
+
+    try {
+        auto source = ReadInput(path);
+        Compiler compiler;
+        Translate(source, &compiler);
+        if (test) {
+            size_t differences = Test(source, compiler);
+            std::cout << compiler.Forms() << " forms, " << compiler.TranslatedForms()
+                      << " translated, " << compiler.InterpretedNodes()
+                      << " parts interpreted, ";
+            if (differences != 0) {
+                std::cout << differences << " results differ\n";
+                return 1;
+            }
+            std::cout << "all results match\n";
+        } else if (output != nullptr) {
+            std::ofstream(output) << compiler.Output();
+        } else {
+            std::cout << compiler.Output();
+        }
+    } catch (const std::exception& e) {
+        std::cerr << argv[0] << ": " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
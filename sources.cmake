@@ -2,6 +2,73 @@ add_library(scheme_basic
     tokenizer.cpp
     parser.cpp
     scheme.cpp
+    bytecode.cpp
+    arena.cpp
+    gc.cpp
+    mapped_file.cpp
+    thread_pool.cpp
+    special_forms.cpp
+    kernels.cpp
+    hash_table.cpp
+    profile.cpp
+    eval_limits.cpp
+    compiled.cpp
+    ast_image.cpp
+    stream.cpp
     
     # maybe more .cpp files here
         object.cpp)
+
+find_package(Threads REQUIRED)
+target_link_libraries(scheme_basic Threads::Threads ${CMAKE_DL_LIBS})
+
+# Counters behind (runtime-stats) and Interpreter::Stats, see profile.h.
+option(SCHEME_PROFILING "Collect runtime statistics" OFF)
+if (SCHEME_PROFILING)
+    target_compile_definitions(scheme_basic PUBLIC SCHEME_PROFILING=1)
+endif()
+
+add_executable(scheme_run scheme_run.cpp)
+target_link_libraries(scheme_run scheme_basic)
+
+add_executable(scheme_bench scheme_bench.cpp)
+target_link_libraries(scheme_bench scheme_basic)
+
+add_executable(scheme_image scheme_image.cpp)
+target_link_libraries(scheme_image scheme_basic)
+
+# Translates programs to C++, see schemec.cpp. Its --test mode loads the built translation, which
+# links against the executable's own copy of the library.
+add_executable(schemec schemec.cpp)
+target_link_libraries(schemec scheme_basic)
+set_target_properties(schemec PROPERTIES ENABLE_EXPORTS ON)
+target_compile_definitions(schemec PRIVATE
+    SCHEMEC_CXX="${CMAKE_CXX_COMPILER}"
+    SCHEMEC_INCLUDE_DIR="${CMAKE_CURRENT_SOURCE_DIR}")
+
+# Behaviour tests, built when GoogleTest is installed.
+find_package(GTest)
+if (GTest_FOUND)
+    enable_testing()
+    add_executable(scheme_tests
+        tests/arithmetic_test.cpp
+        tests/ast_image_test.cpp
+        tests/batch_test.cpp
+        tests/bytecode_test.cpp
+        tests/cache_test.cpp
+        tests/fold_test.cpp
+        tests/gc_test.cpp
+        tests/hash_table_test.cpp
+        tests/limits_test.cpp
+        tests/literal_pool_test.cpp
+        tests/parser_test.cpp
+        tests/profile_test.cpp
+        tests/serialise_test.cpp
+        tests/special_forms_test.cpp
+        tests/stream_test.cpp
+        tests/tail_call_test.cpp
+        tests/vector_test.cpp)
+    target_link_libraries(scheme_tests scheme_basic GTest::gtest_main)
+    include(GoogleTest)
+    gtest_discover_tests(scheme_tests)
+endif()
@@ -0,0 +1,808 @@
+#include "special_forms.h"
+#include "bytecode.h"
+#include "eval_limits.h"
+
+#include <algorithm>
+#include <type_traits>
+
+namespace {
+
+thread_local Environment* current_environment = nullptr;
+thread_local Frame* current_frame = nullptr;
+
+class FrameScope {
+public:
+    explicit FrameScope(Frame* frame) : previous_(current_frame) {
+        current_frame = frame;
+    }
+    ~FrameScope() {
+        current_frame = previous_;
+    }
+
+private:
+    Frame* previous_;
+};
+
+// A call in tail position leaves its evaluated callee and arguments here and returns, the
+// Closure::Apply loop below it picks them up.
+struct PendingCall {
+    std::shared_ptr<Closure> closure;
+    std::vector<std::shared_ptr<Object>> args;
+};
+
+thread_local PendingCall pending_call;
+
+}  // namespace
+
+//////////////////////////////// Environment
+
+Environment::Environment(std::shared_ptr<const Environment> parent) : parent_(std::move(parent)) {
+}
+
+const std::shared_ptr<Object>* Environment::Find(uint32_t id) const {
+    if (id < defined_.size() && defined_[id]) {
+        return &values_[id];
+    }
+    return parent_ != nullptr ? parent_->Find(id) : nullptr;
+}
+
+void Environment::Define(uint32_t id, std::shared_ptr<Object> value) {
+    if (id >= values_.size()) {
+        values_.resize(id + 1);
+        defined_.resize(id + 1);
+    }
+    values_[id] = std::move(value);
+    defined_[id] = true;
+}
+
+Environment* Environment::Current() {
+    return current_environment;
+}
+
+EnvironmentScope::EnvironmentScope(Environment* environment) : previous_(current_environment) {
+    current_environment = environment;
+}
+
+EnvironmentScope::~EnvironmentScope() {
+    current_environment = previous_;
+}
+
+//////////////////////////////// Frames
+
+void Frame::Set(size_t slot, std::shared_ptr<Object> value) {
+    slots_[slot] = std::move(value);
+    Heap::Current().RememberMutation(this);
+}
+
+void Frame::GetChildren(std::vector<Object*>& children) const {
+    if (parent_ != nullptr) {
+        children.push_back(parent_.get());
+    }
+    for (const auto& slot : slots_) {
+        if (slot != nullptr) {
+            children.push_back(slot.get());
+        }
+    }
+}
+
+void Frame::ClearChildren() {
+    parent_.reset();
+    slots_.clear();
+}
+
+Frame* Frame::Current() {
+    return current_frame;
+}
+
+//////////////////////////////// Eval
+
+std::shared_ptr<Object> LocalRef::Eval() {
+    return current_frame->Get(depth_, slot_);
+}
+
+std::shared_ptr<Object> If::Eval() {
+    CountEvaluatedNode();
+    LimitsScope::CountStep();
+    auto test = Evaluate(test_);
+    if (Is<Boolean>(test) && !As<Boolean>(test)->GetBool()) {
+        return Evaluate(alternative_);
+    }
+    return Evaluate(consequent_);
+}
+
+std::shared_ptr<Object> Lambda::Eval() {
+    std::shared_ptr<Frame> frame;
+    if (current_frame != nullptr) {
+        frame = std::static_pointer_cast<Frame>(current_frame->Self());
+    }
+    return Make<Closure>(std::static_pointer_cast<Lambda>(Self()), std::move(frame));
+}
+
+std::shared_ptr<Object> Define::Eval() {
+    auto value = Evaluate(value_);
+    if (local_slot_ != kGlobal) {
+        current_frame->Set(local_slot_, std::move(value));
+    } else if (current_environment != nullptr) {
+        current_environment->Define(name_->GetId(), std::move(value));
+    } else {
+        throw RuntimeError("define outside of an interpreter");
+    }
+    return name_;
+}
+
+std::shared_ptr<Object> Call::Eval() {
+    CountEvaluatedNode();
+    LimitsScope::CountStep();
+    auto function = Evaluate(function_);
+    Arguments args(args_.size());
+    auto slots = args.Slots();
+    for (size_t i = 0; i < args_.size(); ++i) {
+        slots[i] = Evaluate(args_[i]);
+    }
+    if (tail_ && Is<Closure>(function)) {
+        Closure::TailCall(std::static_pointer_cast<Closure>(std::move(function)), slots);
+        return nullptr;
+    }
+    if (auto* closure = As<Closure>(function)) {
+        return closure->ApplyMoving(slots);
+    }
+    if (!Is<Function>(function)) {
+        throw RuntimeError("not a procedure");
+    }
+    return Invoke(As<Function>(function), slots);
+}
+
+std::shared_ptr<Object> Constant::Eval() {
+    return value_;
+}
+
+//////////////////////////////// Closures
+
+template <class Args>
+std::shared_ptr<Frame> Closure::MakeFrame(Args args, std::shared_ptr<Frame> reused) const {
+    constexpr bool kMove = !std::is_const_v<typename Args::element_type>;
+    auto take = [](auto& arg) -> std::shared_ptr<Object> {
+        if constexpr (kMove) {
+            return std::move(arg);
+        } else {
+            return arg;
+        }
+    };
+    size_t params = lambda_->params_;
+    if (lambda_->rest_ ? args.size() + 1 < params : args.size() != params) {
+        throw RuntimeError("wrong number of arguments");
+    }
+
+    // nothing captured the finished call's frame, so it is refilled instead of allocating
+    std::vector<std::shared_ptr<Object>> slots;
+    if (reused != nullptr && reused.use_count() == 1) {
+        slots.swap(reused->slots_);
+        slots.clear();
+    } else {
+        reused = nullptr;
+        slots.reserve(lambda_->frame_size_);
+    }
+    size_t fixed = lambda_->rest_ ? params - 1 : params;
+    for (size_t i = 0; i < fixed; ++i) {
+        slots.push_back(take(args[i]));
+    }
+    if (lambda_->rest_) {
+        std::shared_ptr<Cell> rest = nullptr;
+        for (size_t i = args.size(); i-- > fixed;) {
+            rest = Make<Cell>(take(args[i]), rest);
+        }
+        if (rest != nullptr) {
+            rest->IsList();
+        }
+        slots.push_back(std::move(rest));
+    }
+    slots.resize(lambda_->frame_size_);
+
+    if (reused != nullptr) {
+        reused->parent_ = frame_;
+        reused->slots_.swap(slots);
+        return reused;
+    }
+    return Make<Frame>(frame_, std::move(slots));
+}
+
+std::shared_ptr<Object> Closure::Apply(std::span<const std::shared_ptr<Object>> args) {
+    return Run(MakeFrame(args, nullptr));
+}
+
+std::shared_ptr<Object> Closure::ApplyMoving(std::span<std::shared_ptr<Object>> args) {
+    return Run(MakeFrame(args, nullptr));
+}
+
+void Closure::TailCall(std::shared_ptr<Closure> closure, std::span<std::shared_ptr<Object>> args) {
+    pending_call.closure = std::move(closure);
+    pending_call.args.assign(std::make_move_iterator(args.begin()),
+                             std::make_move_iterator(args.end()));
+}
+
+std::shared_ptr<Object> Closure::Run(std::shared_ptr<Frame> frame) const {
+    const Closure* closure = this;
+    std::shared_ptr<Closure> tail_callee;
+    while (true) {
+        pending_call.args.clear();
+        std::shared_ptr<Object> result;
+        {
+            FrameScope scope(frame.get());
+            if (const auto* code = closure->lambda_->code_.get()) {
+                result = code->Run();
+            } else {
+                const auto& body = closure->lambda_->body_;
+                for (size_t i = 0; i + 1 < body.size(); ++i) {
+                    Evaluate(body[i]);
+                }
+                result = Evaluate(body.back());
+            }
+        }
+        if (pending_call.closure == nullptr) {
+            return result;
+        }
+        tail_callee = std::move(pending_call.closure);
+        closure = tail_callee.get();
+        frame = closure->MakeFrame(std::span(pending_call.args), std::move(frame));
+    }
+}
+
+// The tree of a procedure is one of its children too, so that whatever its nodes hold is
+// accounted for like the frame.
+void Closure::GetChildren(std::vector<Object*>& children) const {
+    if (lambda_ != nullptr) {
+        children.push_back(lambda_.get());
+    }
+    if (frame_ != nullptr) {
+        children.push_back(frame_.get());
+    }
+}
+
+void Closure::ClearChildren() {
+    lambda_.reset();
+    frame_.reset();
+}
+
+//////////////////////////////// Children of the tree
+
+namespace {
+
+void AddChild(const std::shared_ptr<Object>& child, std::vector<Object*>& children) {
+    if (child != nullptr) {
+        children.push_back(child.get());
+    }
+}
+
+}  // namespace
+
+void If::GetChildren(std::vector<Object*>& children) const {
+    AddChild(test_, children);
+    AddChild(consequent_, children);
+    AddChild(alternative_, children);
+}
+
+void If::ClearChildren() {
+    test_.reset();
+    consequent_.reset();
+    alternative_.reset();
+}
+
+void Lambda::GetChildren(std::vector<Object*>& children) const {
+    for (const auto& node : body_) {
+        AddChild(node, children);
+    }
+}
+
+void Lambda::ClearChildren() {
+    body_.clear();
+    // the code holds the nodes of the body as constants
+    code_ = nullptr;
+}
+
+// the name is an interned symbol, which has no children
+void Define::GetChildren(std::vector<Object*>& children) const {
+    AddChild(value_, children);
+}
+
+void Define::ClearChildren() {
+    value_.reset();
+}
+
+void Call::GetChildren(std::vector<Object*>& children) const {
+    AddChild(function_, children);
+    for (const auto& arg : args_) {
+        AddChild(arg, children);
+    }
+}
+
+void Call::ClearChildren() {
+    function_.reset();
+    args_.clear();
+}
+
+void Constant::GetChildren(std::vector<Object*>& children) const {
+    AddChild(value_, children);
+}
+
+void Constant::ClearChildren() {
+    value_.reset();
+}
+
+//////////////////////////////// Serialise
+
+namespace {
+
+void AppendNode(const std::shared_ptr<Object>& node, std::string& out) {
+    if (node == nullptr) {
+        out += "()";
+    } else {
+        SerialiseTo(node.get(), out);
+    }
+}
+
+}  // namespace
+
+std::string LocalRef::Serialise() {
+    return "#<local " + std::to_string(depth_) + ' ' + std::to_string(slot_) + '>';
+}
+
+std::string If::Serialise() {
+    std::string res = "(if ";
+    AppendNode(test_, res);
+    res.push_back(' ');
+    AppendNode(consequent_, res);
+    if (alternative_ != nullptr) {
+        res.push_back(' ');
+        AppendNode(alternative_, res);
+    }
+    res.push_back(')');
+    return res;
+}
+
+std::string Lambda::Serialise() {
+    std::string res = "(lambda #<" + std::to_string(params_) + " params, ";
+    if (rest_) {
+        res += "the last one is the rest, ";
+    }
+    res += std::to_string(frame_size_) + " slots>";
+    for (const auto& node : body_) {
+        res.push_back(' ');
+        AppendNode(node, res);
+    }
+    res.push_back(')');
+    return res;
+}
+
+std::string Define::Serialise() {
+    std::string res = "(define ";
+    if (local_slot_ == kGlobal) {
+        res += name_->GetName();
+    } else {
+        res += "#<local 0 " + std::to_string(local_slot_) + '>';
+    }
+    res.push_back(' ');
+    AppendNode(value_, res);
+    res.push_back(')');
+    return res;
+}
+
+std::string Call::Serialise() {
+    std::string res = tail_ ? "(tail-call " : "(call ";
+    AppendNode(function_, res);
+    for (const auto& arg : args_) {
+        res.push_back(' ');
+        AppendNode(arg, res);
+    }
+    res.push_back(')');
+    return res;
+}
+
+std::string Constant::Serialise() {
+    std::string res = "'";
+    AppendNode(value_, res);
+    return res;
+}
+
+//////////////////////////////// Resolve
+
+namespace {
+
+struct Scope {
+    // slot i holds the variable with symbol id names[i]
+    std::vector<uint32_t> names;
+};
+
+// Elements of a proper list, anything else is a syntax error of the given form.
+std::vector<std::shared_ptr<Object>> Elements(std::shared_ptr<Object> list, const char* form) {
+    std::vector<std::shared_ptr<Object>> res;
+    while (Is<Cell>(list)) {
+        res.push_back(As<Cell>(list)->GetFirst());
+        list = As<Cell>(list)->GetSecond();
+    }
+    if (list != nullptr) {
+        throw SyntaxError(std::string("bad ") + form);
+    }
+    return res;
+}
+
+// (builtin args...) as the reader would make it.
+std::shared_ptr<Object> Application(const char* builtin,
+                                    std::vector<std::shared_ptr<Object>> args) {
+    std::shared_ptr<Object> list = nullptr;
+    for (size_t i = args.size(); i-- > 0;) {
+        list = Make<Cell>(std::move(args[i]), std::move(list));
+    }
+    auto application = Make<Cell>(Symbol::Intern(builtin), std::move(list));
+    application->IsList();
+    return application;
+}
+
+class Resolver {
+public:
+    explicit Resolver(bool fold) : fold_(fold) {
+    }
+
+    std::shared_ptr<Object> Resolve(const std::shared_ptr<Object>& node, bool tail);
+
+private:
+    bool FindLocal(const Symbol* symbol, size_t* depth, size_t* slot) const;
+    // Head of a special form (or quote) unless a local variable hides it.
+    bool IsForm(const std::shared_ptr<Object>& head, const std::shared_ptr<Symbol>& form) const;
+    bool IsForm(const std::shared_ptr<Object>& head) const;
+
+    std::shared_ptr<Object> ResolveDefine(const std::shared_ptr<Object>& args);
+    std::shared_ptr<Lambda> ResolveLambda(const std::vector<std::shared_ptr<Object>>& params,
+                                          bool rest, const std::shared_ptr<Object>& body);
+    std::shared_ptr<Object> ResolveLambdaForm(const std::shared_ptr<Object>& args);
+    std::shared_ptr<Object> ResolveLet(const std::shared_ptr<Object>& args, bool tail);
+    std::shared_ptr<Object> ResolveIf(const std::shared_ptr<Object>& args, bool tail);
+    std::shared_ptr<Object> ResolveDelay(const std::shared_ptr<Object>& args);
+    std::shared_ptr<Object> ResolveConsStream(const std::shared_ptr<Object>& args);
+    std::shared_ptr<Object> ResolveCall(std::shared_ptr<Object> function,
+                                        const std::shared_ptr<Object>& args, bool tail);
+    std::shared_ptr<Object> ResolveArgs(const std::shared_ptr<Object>& node);
+
+    bool IsConstant(const std::shared_ptr<Object>& node) const;
+    std::shared_ptr<Object> Fold(const std::shared_ptr<Object>& node) const;
+
+    bool fold_;
+    std::vector<Scope> scopes_;
+    const std::shared_ptr<Symbol> quote_ = Symbol::Intern("quote");
+    const std::shared_ptr<Symbol> define_ = Symbol::Intern("define");
+    const std::shared_ptr<Symbol> lambda_ = Symbol::Intern("lambda");
+    const std::shared_ptr<Symbol> let_ = Symbol::Intern("let");
+    const std::shared_ptr<Symbol> if_ = Symbol::Intern("if");
+    const std::shared_ptr<Symbol> delay_ = Symbol::Intern("delay");
+    const std::shared_ptr<Symbol> cons_stream_ = Symbol::Intern("cons-stream");
+    const std::shared_ptr<Symbol> and_ = Symbol::Intern("and");
+    const std::shared_ptr<Symbol> or_ = Symbol::Intern("or");
+};
+
+bool Resolver::FindLocal(const Symbol* symbol, size_t* depth, size_t* slot) const {
+    for (size_t i = scopes_.size(); i-- > 0;) {
+        const auto& names = scopes_[i].names;
+        auto it = std::find(names.begin(), names.end(), symbol->GetId());
+        if (it != names.end()) {
+            *depth = scopes_.size() - 1 - i;
+            *slot = it - names.begin();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Resolver::IsForm(const std::shared_ptr<Object>& head,
+                      const std::shared_ptr<Symbol>& form) const {
+    size_t depth, slot;
+    return head == form && !FindLocal(form.get(), &depth, &slot);
+}
+
+bool Resolver::IsForm(const std::shared_ptr<Object>& head) const {
+    return IsForm(head, quote_) || IsForm(head, define_) || IsForm(head, lambda_) ||
+           IsForm(head, let_) || IsForm(head, if_) || IsForm(head, delay_) ||
+           IsForm(head, cons_stream_);
+}
+
+std::shared_ptr<Object> Resolver::Resolve(const std::shared_ptr<Object>& node, bool tail) {
+    if (Is<Symbol>(node)) {
+        size_t depth, slot;
+        if (FindLocal(As<Symbol>(node), &depth, &slot)) {
+            return Make<LocalRef>(depth, slot);
+        }
+        // their builtins take the arguments unevaluated, applied to values they would fail or
+        // evaluate data
+        if (node == quote_ || node == and_ || node == or_) {
+            throw SyntaxError(As<Symbol>(node)->GetName() + " is not a value");
+        }
+        return node;
+    }
+    if (!Is<Cell>(node) || As<Cell>(node)->is_quoted) {
+        return node;
+    }
+
+    const auto& head = As<Cell>(node)->GetFirst();
+    const auto& args = As<Cell>(node)->GetSecond();
+    if (IsForm(head, quote_)) {
+        return node;
+    }
+    if (IsForm(head, define_)) {
+        return ResolveDefine(args);
+    }
+    if (IsForm(head, lambda_)) {
+        return ResolveLambdaForm(args);
+    }
+    if (IsForm(head, let_)) {
+        return ResolveLet(args, tail);
+    }
+    if (IsForm(head, if_)) {
+        return ResolveIf(args, tail);
+    }
+    if (IsForm(head, delay_)) {
+        return ResolveDelay(args);
+    }
+    if (IsForm(head, cons_stream_)) {
+        return ResolveConsStream(args);
+    }
+
+    // Outside of procedures applications of global names stay cells, so that they evaluate as
+    // they always did, and builtins are applied by Cell::Eval everywhere.
+    if (Is<Symbol>(head)) {
+        size_t depth, slot;
+        bool local = FindLocal(As<Symbol>(head), &depth, &slot);
+        if (local || (!scopes_.empty() && !As<Symbol>(head)->IsBuiltin())) {
+            return ResolveCall(head, args, tail);
+        }
+        return Fold(ResolveArgs(node));
+    }
+    auto function = Resolve(head, false);
+    if (function != head) {
+        return ResolveCall(std::move(function), args, tail);
+    }
+    return ResolveArgs(node);
+}
+
+std::shared_ptr<Object> Resolver::ResolveDefine(const std::shared_ptr<Object>& args) {
+    auto elements = Elements(args, "define");
+    if (elements.empty()) {
+        throw SyntaxError("bad define");
+    }
+    std::shared_ptr<Object> target = elements.front();
+    std::shared_ptr<Object> value;
+    if (Is<Cell>(target)) {
+        // (define (name params...) body...)
+        auto signature = As<Cell>(target);
+        target = signature->GetFirst();
+        if (!Is<Symbol>(target)) {
+            throw SyntaxError("bad define");
+        }
+        std::vector<std::shared_ptr<Object>> params;
+        auto param = signature->GetSecond();
+        while (Is<Cell>(param)) {
+            params.push_back(As<Cell>(param)->GetFirst());
+            param = As<Cell>(param)->GetSecond();
+        }
+        bool rest = param != nullptr;
+        if (rest) {
+            params.push_back(param);
+        }
+        value = ResolveLambda(params, rest, As<Cell>(args)->GetSecond());
+    } else if (Is<Symbol>(target) && elements.size() == 2) {
+        value = Resolve(elements[1], false);
+    } else {
+        throw SyntaxError("bad define");
+    }
+
+    auto name = std::static_pointer_cast<Symbol>(target);
+    if (name->IsBuiltin() || IsForm(name)) {
+        throw SyntaxError("can't redefine " + name->GetName());
+    }
+    if (scopes_.empty()) {
+        return Make<Define>(std::move(name), Define::kGlobal, std::move(value));
+    }
+    auto& names = scopes_.back().names;
+    auto it = std::find(names.begin(), names.end(), name->GetId());
+    size_t slot = it - names.begin();
+    if (it == names.end()) {
+        names.push_back(name->GetId());
+    }
+    return Make<Define>(std::move(name), slot, std::move(value));
+}
+
+std::shared_ptr<Lambda> Resolver::ResolveLambda(const std::vector<std::shared_ptr<Object>>& params,
+                                                bool rest, const std::shared_ptr<Object>& body) {
+    auto body_elements = Elements(body, "lambda body");
+    if (body_elements.empty()) {
+        throw SyntaxError("empty lambda body");
+    }
+
+    Scope scope;
+    for (const auto& param : params) {
+        if (!Is<Symbol>(param)) {
+            throw SyntaxError("bad lambda parameter");
+        }
+        uint32_t id = As<Symbol>(param)->GetId();
+        if (std::find(scope.names.begin(), scope.names.end(), id) != scope.names.end()) {
+            throw SyntaxError("duplicate lambda parameter");
+        }
+        scope.names.push_back(id);
+    }
+    scopes_.push_back(std::move(scope));
+
+    // Names defined in the body get their slots first, so the body's procedures can call each
+    // other.
+    for (const auto& element : body_elements) {
+        if (!Is<Cell>(element) || !IsForm(As<Cell>(element)->GetFirst(), define_)) {
+            continue;
+        }
+        auto target = As<Cell>(element)->GetSecond();
+        target = Is<Cell>(target) ? As<Cell>(target)->GetFirst() : nullptr;
+        if (Is<Cell>(target)) {
+            target = As<Cell>(target)->GetFirst();
+        }
+        auto& names = scopes_.back().names;
+        if (Is<Symbol>(target) &&
+            std::find(names.begin(), names.end(), As<Symbol>(target)->GetId()) == names.end()) {
+            names.push_back(As<Symbol>(target)->GetId());
+        }
+    }
+
+    for (size_t i = 0; i < body_elements.size(); ++i) {
+        body_elements[i] = Resolve(body_elements[i], i + 1 == body_elements.size());
+    }
+    size_t frame_size = scopes_.back().names.size();
+    scopes_.pop_back();
+    return Make<Lambda>(params.size(), rest, frame_size, std::move(body_elements));
+}
+
+// (lambda (params...) body...), (lambda (params... . rest) body...) or (lambda args body...)
+std::shared_ptr<Object> Resolver::ResolveLambdaForm(const std::shared_ptr<Object>& args) {
+    if (!Is<Cell>(args)) {
+        throw SyntaxError("bad lambda");
+    }
+    std::vector<std::shared_ptr<Object>> params;
+    auto param = As<Cell>(args)->GetFirst();
+    while (Is<Cell>(param)) {
+        params.push_back(As<Cell>(param)->GetFirst());
+        param = As<Cell>(param)->GetSecond();
+    }
+    bool rest = param != nullptr;
+    if (rest) {
+        params.push_back(param);
+    }
+    return ResolveLambda(params, rest, As<Cell>(args)->GetSecond());
+}
+
+// (let ((name value)...) body...) is a call of (lambda (name...) body...).
+std::shared_ptr<Object> Resolver::ResolveLet(const std::shared_ptr<Object>& args, bool tail) {
+    if (!Is<Cell>(args)) {
+        throw SyntaxError("bad let");
+    }
+    std::vector<std::shared_ptr<Object>> names;
+    std::vector<std::shared_ptr<Object>> values;
+    for (const auto& binding : Elements(As<Cell>(args)->GetFirst(), "let")) {
+        auto pair = Elements(binding, "let binding");
+        if (pair.size() != 2) {
+            throw SyntaxError("bad let binding");
+        }
+        names.push_back(pair[0]);
+        values.push_back(Resolve(pair[1], false));
+    }
+    auto lambda = ResolveLambda(names, false, As<Cell>(args)->GetSecond());
+    return Make<Call>(std::move(lambda), std::move(values), tail);
+}
+
+std::shared_ptr<Object> Resolver::ResolveIf(const std::shared_ptr<Object>& args, bool tail) {
+    auto elements = Elements(args, "if");
+    if (elements.size() != 2 && elements.size() != 3) {
+        throw SyntaxError("bad if");
+    }
+    auto test = Resolve(elements[0], false);
+    auto consequent = Resolve(elements[1], tail);
+    auto alternative = elements.size() == 3 ? Resolve(elements[2], tail) : nullptr;
+    if (fold_ && IsConstant(test)) {
+        auto value = Evaluate(test);
+        const auto& taken =
+            Is<Boolean>(value) && !As<Boolean>(value)->GetBool() ? alternative : consequent;
+        return taken != nullptr ? taken : Make<Constant>(nullptr);
+    }
+    return Make<If>(std::move(test), std::move(consequent), std::move(alternative));
+}
+
+// (delay expr) is (delay-thunk (lambda () expr)), which all evaluators run as an application of
+// a builtin.
+std::shared_ptr<Object> Resolver::ResolveDelay(const std::shared_ptr<Object>& args) {
+    if (Elements(args, "delay").size() != 1) {
+        throw SyntaxError("bad delay");
+    }
+    return Application("delay-thunk", {ResolveLambda({}, false, args)});
+}
+
+// (cons-stream first rest) is (cons first (delay rest)).
+std::shared_ptr<Object> Resolver::ResolveConsStream(const std::shared_ptr<Object>& args) {
+    auto elements = Elements(args, "cons-stream");
+    if (elements.size() != 2) {
+        throw SyntaxError("bad cons-stream");
+    }
+    auto first = Resolve(elements[0], false);
+    return Application("cons", {std::move(first), ResolveDelay(As<Cell>(args)->GetSecond())});
+}
+
+std::shared_ptr<Object> Resolver::ResolveCall(std::shared_ptr<Object> function,
+                                              const std::shared_ptr<Object>& args, bool tail) {
+    std::vector<std::shared_ptr<Object>> values;
+    TreeToVectorNoEval(args, values);
+    for (auto& value : values) {
+        value = Resolve(value, false);
+    }
+    return Make<Call>(Resolve(function, false), std::move(values), tail);
+}
+
+// Copies the cells of an application whose arguments changed, keeping how they are printed.
+std::shared_ptr<Object> Resolver::ResolveArgs(const std::shared_ptr<Object>& node) {
+    std::vector<Cell*> cells;
+    std::vector<std::shared_ptr<Object>> resolved;
+    bool changed = false;
+    std::shared_ptr<Object> rest = As<Cell>(node)->GetSecond();
+    while (Is<Cell>(rest)) {
+        cells.push_back(As<Cell>(rest));
+        resolved.push_back(Resolve(As<Cell>(rest)->GetFirst(), false));
+        changed = changed || resolved.back() != As<Cell>(rest)->GetFirst();
+        rest = As<Cell>(rest)->GetSecond();
+    }
+    auto tail = Resolve(rest, false);
+    if (!changed && tail == rest) {
+        return node;
+    }
+    for (size_t i = cells.size(); i-- > 0;) {
+        auto copy = Make<Cell>(*cells[i]);
+        copy->InitFirst(std::move(resolved[i]));
+        copy->InitSecond(std::move(tail));
+        tail = std::move(copy);
+    }
+    auto copy = Make<Cell>(*As<Cell>(node));
+    copy->InitSecond(std::move(tail));
+    return copy;
+}
+
+bool Resolver::IsConstant(const std::shared_ptr<Object>& node) const {
+    if (node == nullptr || Is<Number>(node) || Is<Boolean>(node) || Is<Vector>(node) ||
+        Is<Constant>(node)) {
+        return true;
+    }
+    return Is<Cell>(node) &&
+           (As<Cell>(node)->is_quoted || IsForm(As<Cell>(node)->GetFirst(), quote_));
+}
+
+// node is an application of a global name with resolved arguments.
+std::shared_ptr<Object> Resolver::Fold(const std::shared_ptr<Object>& node) const {
+    const auto* head = As<Symbol>(As<Cell>(node)->GetFirst());
+    if (!fold_ || !head->IsBuiltin() || !FunctionsMap()[head->GetId()].pure) {
+        return node;
+    }
+    auto arg = As<Cell>(node)->GetSecond();
+    for (; Is<Cell>(arg); arg = As<Cell>(arg)->GetSecond()) {
+        if (!IsConstant(As<Cell>(arg)->GetFirst())) {
+            return node;
+        }
+    }
+    if (arg != nullptr) {
+        return node;
+    }
+
+    std::shared_ptr<Object> value;
+    try {
+        value = node->Eval();
+    } catch (const std::exception&) {
+        return node;
+    }
+    if (Is<Number>(value) || Is<Boolean>(value)) {
+        return value;
+    }
+    return Make<Constant>(std::move(value));
+}
+
+}  // namespace
+
+std::shared_ptr<Object> Resolve(const std::shared_ptr<Object>& ast, bool fold) {
+    return Resolver(fold).Resolve(ast, false);
+}
@@ -0,0 +1,324 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "object.h"
+
+class Bytecode;
+
+// Global variables of an interpreter, indexed by symbol id. Evaluation reads the environment
+// of the innermost EnvironmentScope on the thread.
+class Environment {
+public:
+    // Names not defined here are looked up in parent, which is only read.
+    explicit Environment(std::shared_ptr<const Environment> parent = nullptr);
+
+    // nullptr if the name isn't defined.
+    const std::shared_ptr<Object>* Find(uint32_t id) const;
+
+    void Define(uint32_t id, std::shared_ptr<Object> value);
+
+    static Environment* Current();
+
+private:
+    std::shared_ptr<const Environment> parent_;
+    std::vector<std::shared_ptr<Object>> values_;
+    std::vector<bool> defined_;
+};
+
+class EnvironmentScope {
+public:
+    explicit EnvironmentScope(Environment* environment);
+    ~EnvironmentScope();
+
+    EnvironmentScope(const EnvironmentScope&) = delete;
+    EnvironmentScope& operator=(const EnvironmentScope&) = delete;
+
+private:
+    Environment* previous_;
+};
+
+// Arguments and internal definitions of one procedure call, locals are addressed by
+// (number of frames up, slot) resolved after reading.
+class Frame final : public Object {
+public:
+    static constexpr ObjectType kType = ObjectType::FRAME;
+
+    Frame(std::shared_ptr<Frame> parent, std::vector<std::shared_ptr<Object>> slots)
+        : Object(kType), parent_(std::move(parent)), slots_(std::move(slots)){};
+
+    const std::shared_ptr<Object>& Get(size_t depth, size_t slot) const {
+        const Frame* frame = this;
+        for (; depth > 0; --depth) {
+            frame = frame->parent_.get();
+        }
+        return frame->slots_[slot];
+    }
+
+    void Set(size_t slot, std::shared_ptr<Object> value);
+
+    void GetChildren(std::vector<Object*>& children) const override;
+
+    void ClearChildren() override;
+
+    // Frame of the procedure being evaluated on this thread, nullptr at top level.
+    static Frame* Current();
+
+private:
+    friend class Closure;
+
+    std::shared_ptr<Frame> parent_;
+    std::vector<std::shared_ptr<Object>> slots_;
+};
+
+class LocalRef final : public Object {
+public:
+    static constexpr ObjectType kType = ObjectType::LOCAL_REF;
+
+    LocalRef(size_t depth, size_t slot) : Object(kType), depth_(depth), slot_(slot){};
+
+    size_t GetDepth() const {
+        return depth_;
+    }
+    size_t GetSlot() const {
+        return slot_;
+    }
+
+    std::shared_ptr<Object> Eval() override;
+
+    std::string Serialise() override;
+
+private:
+    size_t depth_;
+    size_t slot_;
+};
+
+// (if test consequent alternative), only #f is false.
+class If final : public Object {
+public:
+    static constexpr ObjectType kType = ObjectType::IF;
+
+    If(std::shared_ptr<Object> test, std::shared_ptr<Object> consequent,
+       std::shared_ptr<Object> alternative)
+        : Object(kType),
+          test_(std::move(test)),
+          consequent_(std::move(consequent)),
+          alternative_(std::move(alternative)){};
+
+    const std::shared_ptr<Object>& GetTest() const {
+        return test_;
+    }
+    const std::shared_ptr<Object>& GetConsequent() const {
+        return consequent_;
+    }
+    // nullptr without one
+    const std::shared_ptr<Object>& GetAlternative() const {
+        return alternative_;
+    }
+
+    void GetChildren(std::vector<Object*>& children) const override;
+
+    void ClearChildren() override;
+
+    std::shared_ptr<Object> Eval() override;
+
+    std::string Serialise() override;
+
+private:
+    std::shared_ptr<Object> test_;
+    std::shared_ptr<Object> consequent_;
+    std::shared_ptr<Object> alternative_;
+};
+
+class Lambda final : public Object {
+public:
+    static constexpr ObjectType kType = ObjectType::LAMBDA;
+
+    // With rest the arguments after the first params - 1 ones are passed as a list. The frame
+    // also has slots for the body's definitions.
+    Lambda(size_t params, bool rest, size_t frame_size, std::vector<std::shared_ptr<Object>> body)
+        : Object(kType),
+          params_(params),
+          rest_(rest),
+          frame_size_(frame_size),
+          body_(std::move(body)){};
+
+    size_t GetParams() const {
+        return params_;
+    }
+    bool HasRest() const {
+        return rest_;
+    }
+    size_t GetFrameSize() const {
+        return frame_size_;
+    }
+    const std::vector<std::shared_ptr<Object>>& GetBody() const {
+        return body_;
+    }
+
+    // The compiled body of a lambda prepared for EvalMode::BYTECODE, nullptr otherwise.
+    const Bytecode* GetCode() const {
+        return code_.get();
+    }
+    void SetCode(std::shared_ptr<const Bytecode> code) {
+        code_ = std::move(code);
+    }
+
+    void GetChildren(std::vector<Object*>& children) const override;
+
+    void ClearChildren() override;
+
+    // Creates a closure over the current frame.
+    std::shared_ptr<Object> Eval() override;
+
+    std::string Serialise() override;
+
+private:
+    friend class Closure;
+
+    size_t params_;
+    bool rest_;
+    size_t frame_size_;
+    std::vector<std::shared_ptr<Object>> body_;
+    std::shared_ptr<const Bytecode> code_;
+};
+
+class Closure final : public Function {
+public:
+    static constexpr FunctionKind kKind = FunctionKind::CLOSURE;
+
+    Closure(std::shared_ptr<Lambda> lambda, std::shared_ptr<Frame> frame)
+        : Function(kKind), lambda_(std::move(lambda)), frame_(std::move(frame)){};
+
+    // Calls in tail position of the body don't return here but replace the running call, so
+    // loops written as tail recursion run in constant native stack.
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
+
+    // Apply for the evaluators' own argument slots: the arguments are moved into the frame, so
+    // the caller doesn't keep them alive during the call (e.g. the head of a stream the
+    // procedure walks through).
+    std::shared_ptr<Object> ApplyMoving(std::span<std::shared_ptr<Object>> args);
+
+    // For a call in tail position: the running body returns (its result is ignored) and the
+    // Apply loop below it calls closure with args, which are moved from.
+    static void TailCall(std::shared_ptr<Closure> closure, std::span<std::shared_ptr<Object>> args);
+
+    void GetChildren(std::vector<Object*>& children) const override;
+
+    void ClearChildren() override;
+
+private:
+    // Args is a span of arguments to copy, or of ones to move if they aren't const.
+    template <class Args>
+    std::shared_ptr<Frame> MakeFrame(Args args, std::shared_ptr<Frame> reused) const;
+
+    std::shared_ptr<Object> Run(std::shared_ptr<Frame> frame) const;
+
+    std::shared_ptr<Lambda> lambda_;
+    std::shared_ptr<Frame> frame_;
+};
+
+// (define name value) at top level or in a procedure body.
+class Define final : public Object {
+public:
+    static constexpr ObjectType kType = ObjectType::DEFINE;
+
+    // A global definition if local_slot is kGlobal.
+    static constexpr size_t kGlobal = -1;
+
+    Define(std::shared_ptr<Symbol> name, size_t local_slot, std::shared_ptr<Object> value)
+        : Object(kType),
+          name_(std::move(name)),
+          local_slot_(local_slot),
+          value_(std::move(value)){};
+
+    const std::shared_ptr<Symbol>& GetName() const {
+        return name_;
+    }
+    size_t GetSlot() const {
+        return local_slot_;
+    }
+    const std::shared_ptr<Object>& GetValue() const {
+        return value_;
+    }
+
+    // Evaluates to the name.
+    void GetChildren(std::vector<Object*>& children) const override;
+
+    void ClearChildren() override;
+
+    std::shared_ptr<Object> Eval() override;
+
+    std::string Serialise() override;
+
+private:
+    std::shared_ptr<Symbol> name_;
+    size_t local_slot_;
+    std::shared_ptr<Object> value_;
+};
+
+// Application of something that isn't a builtin's name, e.g. a local or a lambda.
+class Call final : public Object {
+public:
+    static constexpr ObjectType kType = ObjectType::CALL;
+
+    Call(std::shared_ptr<Object> function, std::vector<std::shared_ptr<Object>> args, bool tail)
+        : Object(kType), function_(std::move(function)), args_(std::move(args)), tail_(tail){};
+
+    const std::shared_ptr<Object>& GetFunction() const {
+        return function_;
+    }
+    const std::vector<std::shared_ptr<Object>>& GetArgs() const {
+        return args_;
+    }
+    bool IsTail() const {
+        return tail_;
+    }
+
+    void GetChildren(std::vector<Object*>& children) const override;
+
+    void ClearChildren() override;
+
+    std::shared_ptr<Object> Eval() override;
+
+    std::string Serialise() override;
+
+private:
+    std::shared_ptr<Object> function_;
+    std::vector<std::shared_ptr<Object>> args_;
+    bool tail_;
+};
+
+// Value computed when the expression was prepared, e.g. of (list 1 2) or (car '(a b)). Numbers
+// and booleans are put into the tree as they are.
+class Constant final : public Object {
+public:
+    static constexpr ObjectType kType = ObjectType::CONSTANT;
+
+    explicit Constant(std::shared_ptr<Object> value) : Object(kType), value_(std::move(value)){};
+
+    const std::shared_ptr<Object>& GetValue() const {
+        return value_;
+    }
+
+    void GetChildren(std::vector<Object*>& children) const override;
+
+    void ClearChildren() override;
+
+    std::shared_ptr<Object> Eval() override;
+
+    std::string Serialise() override;
+
+private:
+    std::shared_ptr<Object> value_;
+};
+
+// Turns define, lambda, let and if into their nodes and local variables into slot references,
+// delay and cons-stream into applications of builtins (see stream.h). Trees without these forms
+// are returned as they are. quote, and and or take their arguments unevaluated, so they can't
+// be used as values (a SyntaxError) unless a local variable hides them.
+//
+// With fold, applications of pure builtins (see BuiltinFunction) to constants are replaced by
+// their values and ifs with a constant test by the branch taken. Applications that fail are
+// kept, so they fail when evaluated. Serialising the result shows the resolved tree.
+std::shared_ptr<Object> Resolve(const std::shared_ptr<Object>& ast, bool fold = true);
@@ -0,0 +1,190 @@
+#include "stream.h"
+#include "eval_limits.h"
+
+namespace {
+
+bool IsFalse(const std::shared_ptr<Object>& obj) {
+    return Is<Boolean>(obj) && !As<Boolean>(obj)->GetBool();
+}
+
+Function* ProcedureArg(std::span<const std::shared_ptr<Object>> args, size_t count,
+                       const char* name) {
+    if (args.size() != count || !Is<Function>(args.front())) {
+        throw RuntimeError(std::string("bad args for ") + name);
+    }
+    return As<Function>(args.front());
+}
+
+// () or a pair, a promise is forced first.
+std::shared_ptr<Object> StreamArg(const std::shared_ptr<Object>& arg, const char* name) {
+    auto stream = Is<Promise>(arg) ? As<Promise>(arg)->Force() : arg;
+    if (stream != nullptr && !Is<Cell>(stream)) {
+        throw RuntimeError(std::string("not a stream in ") + name);
+    }
+    return stream;
+}
+
+// (first . promise of (builtin args...))
+std::shared_ptr<Object> MakeStreamPair(std::shared_ptr<Object> first, Function* builtin,
+                                       std::vector<std::shared_ptr<Object>> args) {
+    auto rest = Make<Promise>(std::static_pointer_cast<Function>(builtin->Self()), std::move(args));
+    auto pair = Make<Cell>(std::move(first), std::move(rest));
+    pair->IsList();
+    return pair;
+}
+
+}  // namespace
+
+//////////////////////////////// Promise
+
+std::shared_ptr<Object> Promise::Force() {
+    if (procedure_ == nullptr) {
+        return value_;
+    }
+    // the procedure may force this promise again, which mustn't free what is being applied
+    auto procedure = procedure_;
+    auto args = args_;
+    auto value = Invoke(procedure.get(), args);
+    if (!BatchItemScope::MayModify(batch_item_)) {
+        return value;
+    }
+    if (procedure_ != nullptr) {
+        value_ = std::move(value);
+        procedure_.reset();
+        args_.clear();
+        Heap::Current().RememberMutation(this);
+    }
+    return value_;
+}
+
+void Promise::GetChildren(std::vector<Object*>& children) const {
+    if (procedure_ != nullptr) {
+        children.push_back(procedure_.get());
+    }
+    for (const auto& arg : args_) {
+        if (arg != nullptr) {
+            children.push_back(arg.get());
+        }
+    }
+    if (value_ != nullptr) {
+        children.push_back(value_.get());
+    }
+}
+
+void Promise::ClearChildren() {
+    procedure_.reset();
+    args_.clear();
+    value_.reset();
+}
+
+std::shared_ptr<Object> Promise::Eval() {
+    return Self();
+}
+
+std::string Promise::Serialise() {
+    return "#<promise>";
+}
+
+//////////////////////////////// Builtins
+
+std::shared_ptr<Object> DelayThunk::Apply(std::span<const std::shared_ptr<Object>> args) {
+    ProcedureArg(args, 1, "delay-thunk");
+    return Make<Promise>(std::static_pointer_cast<Function>(args.front()),
+                         std::vector<std::shared_ptr<Object>>());
+}
+
+std::shared_ptr<Object> Force::Apply(std::span<const std::shared_ptr<Object>> args) {
+    if (args.size() != 1) {
+        throw RuntimeError("bad args for force");
+    }
+    if (auto* promise = As<Promise>(args.front())) {
+        return promise->Force();
+    }
+    return args.front();
+}
+
+std::shared_ptr<Object> PromisePredicate::Apply(std::span<const std::shared_ptr<Object>> args) {
+    if (args.size() != 1) {
+        throw RuntimeError("bad args for promise?");
+    }
+    return MakeBoolean(Is<Promise>(args.front()));
+}
+
+std::shared_ptr<Object> StreamCar::Apply(std::span<const std::shared_ptr<Object>> args) {
+    if (args.size() != 1 || !Is<Cell>(args.front())) {
+        throw RuntimeError("stream-car of not a pair");
+    }
+    return As<Cell>(args.front())->GetFirst();
+}
+
+std::shared_ptr<Object> StreamCdr::Apply(std::span<const std::shared_ptr<Object>> args) {
+    if (args.size() != 1 || !Is<Cell>(args.front())) {
+        throw RuntimeError("stream-cdr of not a pair");
+    }
+    return StreamArg(As<Cell>(args.front())->GetSecond(), "stream-cdr");
+}
+
+std::shared_ptr<Object> StreamMap::Apply(std::span<const std::shared_ptr<Object>> args) {
+    auto* procedure = ProcedureArg(args, 2, "stream-map");
+    auto stream = StreamArg(args[1], "stream-map");
+    if (stream == nullptr) {
+        return nullptr;
+    }
+    auto* pair = As<Cell>(stream);
+    auto first = Invoke(procedure, {&pair->GetFirst(), 1});
+    return MakeStreamPair(std::move(first), this, {args[0], pair->GetSecond()});
+}
+
+// Skipped elements are forced in a loop, so long runs of them don't nest calls.
+std::shared_ptr<Object> StreamFilter::Apply(std::span<const std::shared_ptr<Object>> args) {
+    auto* predicate = ProcedureArg(args, 2, "stream-filter");
+    auto stream = StreamArg(args[1], "stream-filter");
+    while (stream != nullptr) {
+        LimitsScope::CountStep();
+        auto* pair = As<Cell>(stream);
+        if (!IsFalse(Invoke(predicate, {&pair->GetFirst(), 1}))) {
+            return MakeStreamPair(pair->GetFirst(), this, {args[0], pair->GetSecond()});
+        }
+        stream = StreamArg(pair->GetSecond(), "stream-filter");
+    }
+    return nullptr;
+}
+
+std::shared_ptr<Object> StreamTake::Apply(std::span<const std::shared_ptr<Object>> args) {
+    if (args.size() != 2 || !Is<Number>(args.front())) {
+        throw RuntimeError("bad args for stream-take");
+    }
+    int64_t count = As<Number>(args.front())->GetValue();
+    if (count <= 0) {
+        return nullptr;
+    }
+    auto stream = StreamArg(args[1], "stream-take");
+    if (stream == nullptr) {
+        return nullptr;
+    }
+    auto* pair = As<Cell>(stream);
+    return MakeStreamPair(pair->GetFirst(), this, {MakeNumber(count - 1), pair->GetSecond()});
+}
+
+std::shared_ptr<Object> StreamToList::Apply(std::span<const std::shared_ptr<Object>> args) {
+    if (args.size() != 1) {
+        throw RuntimeError("bad args for stream->list");
+    }
+    std::shared_ptr<Cell> head;
+    Cell* tail = nullptr;
+    auto stream = StreamArg(args.front(), "stream->list");
+    while (stream != nullptr) {
+        LimitsScope::CountStep();
+        auto* pair = As<Cell>(stream);
+        auto cell = Make<Cell>(pair->GetFirst(), nullptr);
+        if (tail == nullptr) {
+            cell->IsList();
+            head = cell;
+        } else {
+            tail->InitSecond(cell);
+        }
+        tail = cell.get();
+        stream = StreamArg(pair->GetSecond(), "stream->list");
+    }
+    return head;
+}
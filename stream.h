@@ -0,0 +1,136 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "object.h"
+
+// Delayed application of a procedure to arguments, done when the promise is first forced. Later
+// forces return the same value. (delay expr) is a promise of a procedure without arguments, the
+// stream builtins make promises of themselves applied to the rest of their work.
+class Promise final : public Object {
+public:
+    static constexpr ObjectType kType = ObjectType::PROMISE;
+
+    Promise(std::shared_ptr<Function> procedure, std::vector<std::shared_ptr<Object>> args)
+        : Object(kType), procedure_(std::move(procedure)), args_(std::move(args)){};
+
+    bool IsForced() const {
+        return procedure_ == nullptr;
+    }
+
+    // The procedure and its arguments are dropped once the value is known. A batch item forcing
+    // a promise of the globals doesn't keep the value, see BatchItemScope.
+    std::shared_ptr<Object> Force();
+
+    void GetChildren(std::vector<Object*>& children) const override;
+
+    void ClearChildren() override;
+
+    std::shared_ptr<Object> Eval() override;
+
+    std::string Serialise() override;
+
+private:
+    // unlinks long chains of forced streams, see ~Cell
+    friend class Cell;
+
+    std::shared_ptr<Function> procedure_;
+    std::vector<std::shared_ptr<Object>> args_;
+    std::shared_ptr<Object> value_;
+    const uint32_t batch_item_ = BatchItemScope::Current();
+};
+
+// A stream is () or a pair whose rest is a promise of a stream, (cons-stream a b) is
+// (cons a (delay b)). Builtins taking a stream also take a promise of one, and lists, so only
+// the part of a stream that is used gets computed, and the part that was used is freed unless
+// something still refers to it.
+
+// (delay-thunk procedure) is a promise of (procedure), (delay expr) is resolved to
+// (delay-thunk (lambda () expr)).
+class DelayThunk final : public Function {
+public:
+    static constexpr FunctionKind kKind = FunctionKind::DELAY_THUNK;
+
+    DelayThunk() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
+};
+
+// Anything that isn't a promise is returned as it is.
+class Force final : public Function {
+public:
+    static constexpr FunctionKind kKind = FunctionKind::FORCE;
+
+    Force() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
+};
+
+class PromisePredicate final : public Function {
+public:
+    static constexpr FunctionKind kKind = FunctionKind::PROMISE_PREDICATE;
+
+    PromisePredicate() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
+};
+
+class StreamCar final : public Function {
+public:
+    static constexpr FunctionKind kKind = FunctionKind::STREAM_CAR;
+
+    StreamCar() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
+};
+
+// Forces the rest of the pair.
+class StreamCdr final : public Function {
+public:
+    static constexpr FunctionKind kKind = FunctionKind::STREAM_CDR;
+
+    StreamCdr() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
+};
+
+// (stream-map procedure stream), the procedure is applied to an element when the pair holding
+// its result is made.
+class StreamMap final : public Function {
+public:
+    static constexpr FunctionKind kKind = FunctionKind::STREAM_MAP;
+
+    StreamMap() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
+};
+
+// (stream-filter predicate stream)
+class StreamFilter final : public Function {
+public:
+    static constexpr FunctionKind kKind = FunctionKind::STREAM_FILTER;
+
+    StreamFilter() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
+};
+
+// (stream-take n stream), the first n elements.
+class StreamTake final : public Function {
+public:
+    static constexpr FunctionKind kKind = FunctionKind::STREAM_TAKE;
+
+    StreamTake() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
+};
+
+// Forces the whole stream, which must be finite.
+class StreamToList final : public Function {
+public:
+    static constexpr FunctionKind kKind = FunctionKind::STREAM_TO_LIST;
+
+    StreamToList() : Function(kKind){};
+
+    std::shared_ptr<Object> Apply(std::span<const std::shared_ptr<Object>> args) override;
+};
@@ -0,0 +1,32 @@
+#include <scheme.h>
+
+#include <gtest/gtest.h>
+
+// Integers are 64 bits and wrap around instead of overflowing.
+TEST(ArithmeticTest, Wraps) {
+    Interpreter interpreter;
+    interpreter.Run("(define largest 9223372036854775807)");
+    interpreter.Run("(define smallest (+ largest 1))");
+    EXPECT_EQ(interpreter.Run("smallest"), "-9223372036854775808");
+    EXPECT_EQ(interpreter.Run("(- smallest 1)"), "9223372036854775807");
+    EXPECT_EQ(interpreter.Run("(- 0 smallest)"), "-9223372036854775808");
+    EXPECT_EQ(interpreter.Run("(- largest -1 -1)"), "-9223372036854775807");
+    EXPECT_EQ(interpreter.Run("(* largest 2)"), "-2");
+    EXPECT_EQ(interpreter.Run("(abs smallest)"), "-9223372036854775808");
+    EXPECT_EQ(interpreter.Run("(abs (- 0 largest))"), "9223372036854775807");
+    EXPECT_THROW(interpreter.Run("(/ smallest -1)"), RuntimeError);
+}
+
+TEST(ArithmeticTest, NoArguments) {
+    Interpreter interpreter;
+    EXPECT_EQ(interpreter.Run("(+)"), "0");
+    EXPECT_EQ(interpreter.Run("(*)"), "1");
+    for (std::string name : {"/", "max", "min"}) {
+        try {
+            interpreter.Run("(" + name + ")");
+            ADD_FAILURE() << name;
+        } catch (const RuntimeError& error) {
+            EXPECT_EQ(std::string(error.what()), "No args for " + name);
+        }
+    }
+}
@@ -0,0 +1,188 @@
+#include <scheme.h>
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+namespace {
+
+constexpr std::string_view kSource =
+    "(define (square x) (* x x))\n"
+    "(square -12)\n"
+    "'(1 (2 . 3) #t #f sym (1 (2 . 3)))\n"
+    "#(1 #(2 3) (4 5))\n"
+    "(list 9223372036854775807 -9223372036854775808 0)\n"
+    "'()\n"
+    "(if #f 1 (quote (a . b)))\n";
+
+std::vector<std::shared_ptr<Object>> ReadForms(std::string_view source) {
+    Tokenizer tokenizer(source);
+    FormReader reader(&tokenizer);
+    std::vector<std::shared_ptr<Object>> forms;
+    while (!reader.IsEnd()) {
+        forms.push_back(reader.Next());
+    }
+    return forms;
+}
+
+std::string Serialise(const std::shared_ptr<Object>& form) {
+    return form != nullptr ? form->Serialise() : "()";
+}
+
+// Images are read in place and must be aligned like a mapped file.
+class AlignedImage {
+public:
+    explicit AlignedImage(std::string_view data)
+        : words_((data.size() + sizeof(uint64_t) - 1) / sizeof(uint64_t)), size_(data.size()) {
+        std::memcpy(words_.data(), data.data(), data.size());
+    }
+
+    char* Data() {
+        return reinterpret_cast<char*>(words_.data());
+    }
+
+    std::string_view View(size_t size) const {
+        return std::string_view(reinterpret_cast<const char*>(words_.data()), size);
+    }
+    std::string_view View() const {
+        return View(size_);
+    }
+
+private:
+    std::vector<uint64_t> words_;
+    size_t size_;
+};
+
+std::string MakeImage(std::string_view source) {
+    AstImageWriter writer;
+    for (const auto& form : ReadForms(source)) {
+        writer.AddForm(form);
+    }
+    return writer.Finish();
+}
+
+std::string ErrorOf(std::string_view data) {
+    try {
+        AstImage image(data, "image");
+        for (size_t i = 0; i < image.Forms(); ++i) {
+            image.Form(i);
+        }
+    } catch (const std::runtime_error& e) {
+        return e.what();
+    }
+    return "no error";
+}
+
+}  // namespace
+
+TEST(AstImageTest, RoundTrip) {
+    AlignedImage data(MakeImage(kSource));
+    ASSERT_TRUE(AstImage::IsImage(data.View()));
+    AstImage image(data.View(), "image");
+    auto forms = ReadForms(kSource);
+    ASSERT_EQ(image.Forms(), forms.size());
+    for (size_t i = 0; i < forms.size(); ++i) {
+        EXPECT_EQ(Serialise(image.Form(i)), Serialise(forms[i])) << "form " << i;
+    }
+}
+
+TEST(AstImageTest, EvaluatesLikeTheSource) {
+    AlignedImage data(MakeImage(kSource));
+    AstImage image(data.View(), "image");
+    Interpreter from_image;
+    Interpreter from_source;
+    Tokenizer tokenizer(kSource);
+    FormReader reader(&tokenizer);
+    for (size_t i = 0; i < image.Forms(); ++i) {
+        std::string expected;
+        std::string actual;
+        try {
+            expected = from_source.PrepareNext(&reader).Execute();
+        } catch (const std::exception& e) {
+            expected = e.what();
+        }
+        try {
+            actual = from_image.Prepare(image, i).Execute();
+        } catch (const std::exception& e) {
+            actual = e.what();
+        }
+        EXPECT_EQ(actual, expected) << "form " << i;
+    }
+}
+
+TEST(AstImageTest, RejectsTruncatedImages) {
+    std::string image = MakeImage(kSource);
+    AlignedImage data(image);
+    EXPECT_EQ(ErrorOf(data.View(sizeof(ImageHeader))), "image: truncated AST image");
+    EXPECT_EQ(ErrorOf(data.View(image.size() - 1)), "image: truncated AST image");
+    for (size_t size = 0; size < image.size(); ++size) {
+        EXPECT_NE(ErrorOf(data.View(size)), "no error") << "size " << size;
+    }
+}
+
+TEST(AstImageTest, RejectsCorruptHeaders) {
+    std::string image = MakeImage(kSource);
+    {
+        AlignedImage data(image);
+        data.Data()[0] = 'X';
+        EXPECT_FALSE(AstImage::IsImage(data.View()));
+        EXPECT_EQ(ErrorOf(data.View()), "image: not an AST image");
+    }
+    {
+        AlignedImage data(image);
+        reinterpret_cast<ImageHeader*>(data.Data())->version = kImageVersion + 1;
+        EXPECT_EQ(ErrorOf(data.View()), "image: unsupported AST image version");
+    }
+    {
+        AlignedImage data(image);
+        reinterpret_cast<ImageHeader*>(data.Data())->forms += 1;
+        EXPECT_NE(ErrorOf(data.View()), "no error");
+    }
+    {
+        AlignedImage data(image);
+        reinterpret_cast<ImageHeader*>(data.Data())->names_size += 1;
+        EXPECT_NE(ErrorOf(data.View()), "no error");
+    }
+}
+
+TEST(AstImageTest, RejectsCorruptNodes) {
+    std::string image = MakeImage(kSource);
+    const auto* header = reinterpret_cast<const ImageHeader*>(image.data());
+    // the nodes follow the header and the form starts, each part aligned to 8
+    size_t nodes = (sizeof(ImageHeader) + (header->forms + 1) * sizeof(uint32_t) + 7) / 8 * 8;
+    for (uint32_t i = 0; i < header->nodes; ++i) {
+        AlignedImage data(image);
+        auto* node = reinterpret_cast<ImageNode*>(data.Data() + nodes) + i;
+        node->kind = static_cast<ImageNodeKind>(100);
+        EXPECT_EQ(ErrorOf(data.View()), "image: corrupt node in AST image") << "node " << i;
+    }
+    for (uint32_t i = 0; i < header->nodes; ++i) {
+        AlignedImage data(image);
+        auto* node = reinterpret_cast<ImageNode*>(data.Data() + nodes) + i;
+        if (node->kind == ImageNodeKind::CELL) {
+            node->a = header->nodes;
+            EXPECT_EQ(ErrorOf(data.View()), "image: corrupt node in AST image") << "node " << i;
+        }
+    }
+}
+
+TEST(AstImageTest, RejectsNodesUsedTwice) {
+    std::string image = MakeImage(kSource);
+    const auto* header = reinterpret_cast<const ImageHeader*>(image.data());
+    size_t nodes = (sizeof(ImageHeader) + (header->forms + 1) * sizeof(uint32_t) + 7) / 8 * 8;
+    int corrupted = 0;
+    for (uint32_t i = 0; i < header->nodes; ++i) {
+        AlignedImage data(image);
+        auto* all = reinterpret_cast<ImageNode*>(data.Data() + nodes);
+        auto* node = all + i;
+        if (node->kind != ImageNodeKind::CELL || node->a == kImageEmptyList ||
+            all[node->a].flags & ImageNode::SHARED) {
+            continue;
+        }
+        // the second of the cell is now its first as well, which was only stored once
+        node->b = node->a;
+        EXPECT_EQ(ErrorOf(data.View()), "image: corrupt image") << "node " << i;
+        ++corrupted;
+    }
+    EXPECT_GT(corrupted, 0);
+}
@@ -0,0 +1,81 @@
+#include <scheme.h>
+
+#include <gtest/gtest.h>
+
+TEST(BatchTest, ResultsInInputOrder) {
+    Interpreter interpreter;
+    interpreter.Run("(define x 10)");
+    std::vector<std::string> inputs;
+    for (int i = 0; i < 100; ++i) {
+        inputs.push_back("(+ x " + std::to_string(i) + ")");
+    }
+    auto results = interpreter.RunBatch(inputs);
+    ASSERT_EQ(results.size(), inputs.size());
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(results[i], std::to_string(10 + i));
+    }
+}
+
+TEST(BatchTest, FirstFailingItemIsRethrown) {
+    Interpreter interpreter;
+    std::vector<std::string> inputs = {"(+ 1 2)", "(car 1)", "undefined-variable", "(+ 3 4)"};
+    EXPECT_THROW(interpreter.RunBatch(inputs), RuntimeError);
+    // the interpreter is still usable afterwards
+    EXPECT_EQ(interpreter.RunBatch(std::vector<std::string>{"(+ 1 2)"}).front(), "3");
+}
+
+TEST(BatchTest, DefinitionsArePrivate) {
+    Interpreter interpreter;
+    std::vector<std::string> inputs = {"(define y 1)", "(define y 2)"};
+    interpreter.RunBatch(inputs);
+    EXPECT_THROW(interpreter.Run("(+ y 1)"), RuntimeError);
+}
+
+TEST(BatchTest, SharedVectorIsNotModified) {
+    Interpreter interpreter;
+    interpreter.Run("(define v (make-vector 2))");
+    interpreter.Run("(define (put i x) (vector-set! v i x))");
+    std::vector<std::string> inputs = {"(vector-set! v 0 1)", "(put 1 2)"};
+    EXPECT_THROW(interpreter.RunBatch(inputs), RuntimeError);
+    inputs = {"(put 0 1)", "(put 1 2)"};
+    EXPECT_THROW(interpreter.RunBatch(inputs), RuntimeError);
+    EXPECT_EQ(interpreter.Run("v"), "#(0 0)");
+    // outside of batches the globals can be modified as before
+    interpreter.Run("(put 0 5)");
+    EXPECT_EQ(interpreter.Run("v"), "#(5 0)");
+}
+
+TEST(BatchTest, SharedHashTableIsNotModified) {
+    Interpreter interpreter;
+    interpreter.Run("(define table (make-hash-table))");
+    interpreter.Run("(hash-table-set! table 1 1)");
+    EXPECT_THROW(interpreter.RunBatch(std::vector<std::string>{"(hash-table-set! table 2 2)"}),
+                 RuntimeError);
+    EXPECT_THROW(interpreter.RunBatch(std::vector<std::string>{"(hash-table-delete! table 1)"}),
+                 RuntimeError);
+    EXPECT_EQ(interpreter.Run("(hash-table-count table)"), "1");
+}
+
+TEST(BatchTest, ItemsModifyTheirOwnObjects) {
+    Interpreter interpreter;
+    interpreter.Run("(define (fill v i) "
+                    "(if (= i (vector-length v)) v (fill (vector-set! v i i) (+ i 1))))");
+    std::vector<std::string> inputs = {
+        "(fill (make-vector 3) 0)", "(vector-set! (vector 1 2) 0 5)",
+        "(hash-table-count (hash-table-set! (make-hash-table) 1 2))"};
+    auto results = interpreter.RunBatch(inputs);
+    EXPECT_EQ(results[0], "#(0 1 2)");
+    EXPECT_EQ(results[1], "#(5 2)");
+    EXPECT_EQ(results[2], "1");
+}
+
+TEST(BatchTest, SharedPromisesAreForcedByEachItem) {
+    Interpreter interpreter;
+    interpreter.Run("(define (from n) (cons-stream n (from (+ n 1))))");
+    interpreter.Run("(define naturals (from 0))");
+    std::vector<std::string> inputs(8, "(stream->list (stream-take 5 naturals))");
+    for (const auto& result : interpreter.RunBatch(inputs)) {
+        EXPECT_EQ(result, "(0 1 2 3 4)");
+    }
+    EXPECT_EQ(interpreter.Run("(stream->list (stream-take 3 naturals))"), "(0 1 2)");
+}
@@ -0,0 +1,75 @@
+#include <scheme.h>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+// Results of the inputs run in order, "error" for the ones that fail.
+std::vector<std::string> RunAll(EvalMode mode, const std::vector<std::string>& inputs) {
+    Interpreter interpreter;
+    interpreter.SetEvalMode(mode);
+    std::vector<std::string> results;
+    for (const auto& input : inputs) {
+        try {
+            results.push_back(interpreter.Run(input));
+        } catch (const std::runtime_error&) {
+            results.push_back("error");
+        }
+    }
+    return results;
+}
+
+}  // namespace
+
+// Top-level applications of global names and forms the compiler doesn't know run on the tree
+// walker, the results must be the same either way.
+TEST(BytecodeTest, SameResultsAsTreeWalk) {
+    std::vector<std::string> inputs = {
+        "(+ 1 (* 2 3) (- 10 (/ 8 2)))",
+        "(max 1 (min 5 3) (abs -4))",
+        "(and (< 1 2 3) (or #f (>= 5 5)) (not #f))",
+        "(and)",
+        "(or)",
+        "(and 1 #f (car '()))",
+        "(or #f 2 (car '()))",
+        "'(1 (2 . 3) #(4))",
+        "(car (cdr (list 1 2 3)))",
+        "(list-tail (cons 1 (list 2 3)) 1)",
+        "(vector-ref (vector 1 (+ 1 1)) 1)",
+        "(define x 10)",
+        "(+ x (if (> x 5) 1 2))",
+        "(define (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))",
+        "(+ (fib 10) (fib 5))",
+        "((lambda (a b) (list b a)) 1 2)",
+        "(let ((v (make-vector 2))) (vector-set! v 0 x) v)",
+        "(+ 1 #t)",
+        "(car '())",
+        "(undefined-name 1)",
+        "(vector-set! #(1) 0 2)",
+        "(define (count n acc) (if (= n 0) acc (count (- n 1) (+ acc 1))))",
+        "(count 100000 0)",
+        "(define (adder n) (lambda (m) (+ n m)))",
+        "((adder 3) 4)",
+        "(define (scaled-sum l k) "
+        "(define (go l acc) (if (null? l) acc (go (cdr l) (+ acc (* k (car l)))))) (go l 0))",
+        "(scaled-sum '(1 2 3) 2)",
+        "(define (rest a . more) (list a more))",
+        "(rest 1 2 3)",
+        "(rest)",
+        "(define (pick n) (and (> n 0) (or (= n 1) (< n 0) 'many)))",
+        "(list (pick 0) (pick 1) (pick 5))",
+        "(define (bad n) (+ n 'a))",
+        "(bad 1)",
+        "((lambda (n) (< n #t)) 1)",
+        "((lambda (n) (- n 9223372036854775807 2)) 0)",
+        "(adder 1 2)",
+        "x"};
+    auto tree_walk = RunAll(EvalMode::TREE_WALK, inputs);
+    EXPECT_EQ(RunAll(EvalMode::BYTECODE, inputs), tree_walk);
+    EXPECT_EQ(tree_walk[0], "13");
+    EXPECT_EQ(tree_walk[14], "60");
+    EXPECT_EQ(tree_walk[22], "100000");
+    EXPECT_EQ(tree_walk[26], "12");
+    EXPECT_EQ(tree_walk[31], "(#f #t many)");
+    EXPECT_EQ(tree_walk.back(), "10");
+}
@@ -0,0 +1,74 @@
+#include <scheme.h>
+
+#include <gtest/gtest.h>
+
+TEST(CacheTest, ReusedInputBuffer) {
+    Interpreter interpreter(2);
+    // the same buffer is overwritten in place, the cache must not refer to it
+    std::string input = "(+ 1 0)";
+    EXPECT_EQ(interpreter.Run(input), "1");
+    input.replace(5, 1, "1");
+    EXPECT_EQ(interpreter.Run(input), "2");
+    for (int round = 0; round < 3; ++round) {
+        for (char digit = '0'; digit <= '9'; ++digit) {
+            input[5] = digit;
+            EXPECT_EQ(interpreter.Run(input), std::to_string(1 + digit - '0')) << input;
+        }
+    }
+}
+
+TEST(CacheTest, EvictsLeastRecentlyUsed) {
+    Interpreter interpreter(2);
+    EXPECT_EQ(interpreter.Run("(define x 1)"), "x");
+    EXPECT_EQ(interpreter.Run("x"), "1");
+    EXPECT_EQ(interpreter.Run("(+ x 1)"), "2");
+    EXPECT_EQ(interpreter.Run("x"), "1");
+    EXPECT_EQ(interpreter.Run("(* x 3)"), "3");
+    EXPECT_EQ(interpreter.Run("(+ x 1)"), "2");
+    EXPECT_EQ(interpreter.Run("x"), "1");
+}
+
+namespace {
+
+// Results of the inputs, run in order twice, "error" for the ones that fail.
+std::vector<std::string> RunTwice(Interpreter* interpreter, const std::vector<std::string>& inputs) {
+    std::vector<std::string> results;
+    for (int round = 0; round < 2; ++round) {
+        for (const auto& input : inputs) {
+            try {
+                results.push_back(interpreter->Run(input));
+            } catch (const RuntimeError&) {
+                results.push_back("error");
+            }
+        }
+    }
+    return results;
+}
+
+}  // namespace
+
+TEST(CacheTest, SameResultsAsWithoutCache) {
+    std::vector<std::string> inputs = {
+        "(vector-set! counter 0 (+ 1 (vector-ref counter 0)))",
+        "(let ((v (vector 0))) (vector-set! v 0 (+ 1 (vector-ref v 0))) (vector-ref v 0))",
+        "(let ((v #(0))) (vector-set! v 0 (+ 1 (vector-ref v 0))) (vector-ref v 0))",
+        "(vector-set! (car '(#(0))) 0 1)",
+        "(vector-ref counter 0)"};
+    Interpreter uncached;
+    Interpreter cached(8);
+    uncached.Run("(define counter (make-vector 1))");
+    cached.Run("(define counter (make-vector 1))");
+    auto expected = RunTwice(&uncached, inputs);
+    EXPECT_EQ(RunTwice(&cached, inputs), expected);
+    EXPECT_EQ(expected, std::vector<std::string>({"#(1)", "1", "error", "error", "1", "#(2)", "1",
+                                                  "error", "error", "2"}));
+}
+
+TEST(CacheTest, PreparedExpressionGivesTheSameResult) {
+    Interpreter interpreter;
+    auto prepared = interpreter.Prepare(
+        "(let ((v #(0))) (vector-set! (vector 1) 0 (vector-ref v 0)) (vector-ref v 0))");
+    for (int run = 0; run < 3; ++run) {
+        EXPECT_EQ(prepared.Execute(), "0");
+    }
+}
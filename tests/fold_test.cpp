@@ -0,0 +1,32 @@
+#include <scheme.h>
+
+#include <gtest/gtest.h>
+
+TEST(FoldTest, PureCallsFold) {
+    Interpreter interpreter;
+    EXPECT_EQ(interpreter.Prepare("(+ 1 2)").Dump(), "3");
+    EXPECT_EQ(interpreter.Prepare("(+ (* 2 3) (- 10 4))").Dump(), "12");
+    EXPECT_EQ(interpreter.Prepare("(if (< 1 2) 1 2)").Dump(), "1");
+    EXPECT_EQ(interpreter.Prepare("(lambda (x) (* (+ 1 2) x))").Dump(),
+              "(lambda #<1 params, 1 slots> (* 3 #<local 0 0>))");
+    EXPECT_EQ(interpreter.Run("((lambda (x) (* (+ 1 2) x)) 5)"), "15");
+}
+
+TEST(FoldTest, ImpureCallsStay) {
+    Interpreter interpreter;
+    EXPECT_EQ(interpreter.Prepare("(vector-ref #(1 2) 0)").Dump(), "(vector-ref #(1 2) 0)");
+    EXPECT_EQ(interpreter.Run("(vector-ref #(1 2) 0)"), "1");
+}
+
+TEST(FoldTest, FailingCallsThrowWhenRun) {
+    Interpreter interpreter;
+    EXPECT_EQ(interpreter.Prepare("(car 1)").Dump(), "(car 1)");
+    EXPECT_THROW(interpreter.Run("(car 1)"), RuntimeError);
+}
+
+TEST(FoldTest, CanBeDisabled) {
+    Interpreter interpreter;
+    interpreter.SetConstantFolding(false);
+    EXPECT_EQ(interpreter.Prepare("(+ 1 2)").Dump(), "(+ 1 2)");
+    EXPECT_EQ(interpreter.Run("(+ 1 2)"), "3");
+}
@@ -0,0 +1,39 @@
+#include <scheme.h>
+
+#include <gtest/gtest.h>
+
+TEST(GcTest, CycleThroughFrame) {
+    Interpreter interpreter;
+    // the procedure's frame holds the procedure
+    interpreter.Run("((lambda () (define (self) self) (self)))");
+    EXPECT_GT(interpreter.CollectGarbage(), 0u);
+    EXPECT_EQ(interpreter.CollectGarbage(), 0u);
+}
+
+TEST(GcTest, CycleThroughVector) {
+    Interpreter interpreter;
+    interpreter.Run("(define v (make-vector 1))");
+    interpreter.Run("(vector-set! (vector-set! (make-vector 1) 0 v) 0 1)");
+    interpreter.Run("((lambda (w) (vector-set! w 0 w)) (make-vector 1))");
+    EXPECT_GT(interpreter.CollectGarbage(), 0u);
+}
+
+TEST(GcTest, CycleThroughVectorOfBody) {
+    Interpreter interpreter;
+    // a vector made by the body of the procedure ends up holding the procedure, which is in its
+    // own frame as well
+    interpreter.Run("((lambda () (define (self) (vector-set! (vector 0) 0 self)) (self) 0))");
+    EXPECT_GT(interpreter.CollectGarbage(), 0u);
+    EXPECT_EQ(interpreter.CollectGarbage(), 0u);
+}
+
+TEST(GcTest, LiveProceduresStay) {
+    Interpreter interpreter;
+    interpreter.Run("(define (make) (define (self) (vector-set! (vector 0) 0 self)) self)");
+    interpreter.Run("(define f (make))");
+    interpreter.Run("(f)");
+    interpreter.CollectGarbage();
+    // the vector holds the procedure, which still works
+    interpreter.Run("(define g (vector-ref (f) 0))");
+    EXPECT_EQ(interpreter.Run("(vector-length (g))"), "1");
+}
@@ -0,0 +1,64 @@
+#include <scheme.h>
+
+#include <gtest/gtest.h>
+
+TEST(HashTableTest, SetAndRef) {
+    Interpreter interpreter;
+    interpreter.Run("(define table (make-hash-table))");
+    interpreter.Run("(hash-table-set! table 1 'one)");
+    interpreter.Run("(hash-table-set! table 'two 2)");
+    EXPECT_EQ(interpreter.Run("(hash-table-ref table 1)"), "one");
+    EXPECT_EQ(interpreter.Run("(hash-table-ref table 'two)"), "2");
+    EXPECT_EQ(interpreter.Run("(hash-table-ref table 3 #f)"), "#f");
+    EXPECT_THROW(interpreter.Run("(hash-table-ref table 3)"), RuntimeError);
+    interpreter.Run("(hash-table-set! table 1 'uno)");
+    EXPECT_EQ(interpreter.Run("(hash-table-ref table 1)"), "uno");
+    EXPECT_EQ(interpreter.Run("(hash-table-count table)"), "2");
+}
+
+// Numbers are equal keys when their values are, other objects only when they are the same.
+TEST(HashTableTest, KeyEquality) {
+    Interpreter interpreter;
+    interpreter.Run("(define table (make-hash-table))");
+    interpreter.Run("(hash-table-set! table 123456789 'big)");
+    interpreter.Run("(hash-table-set! table '(1 2) 'list)");
+    EXPECT_EQ(interpreter.Run("(hash-table-ref table (* 3 41152263))"), "big");
+    EXPECT_EQ(interpreter.Run("(hash-table-ref table '(1 2) 'other)"), "other");
+}
+
+TEST(HashTableTest, GrowsAndDeletes) {
+    Interpreter interpreter;
+    interpreter.Run("(define table (make-hash-table 4))");
+    interpreter.Run("(define (then x y) y)");
+    interpreter.Run("(define (fill i n) (if (= i n) table "
+                    "(fill (then (hash-table-set! table i (* i i)) (+ i 1)) n)))");
+    interpreter.Run("(define (drop i n) "
+                    "(if (>= i n) table (drop (then (hash-table-delete! table i) (+ i 3)) n)))");
+    interpreter.Run("(define (check i n) (if (= i n) #t "
+                    "(if (= (hash-table-ref table i -1) (if (= (- i (* (/ i 3) 3)) 0) -1 (* i i))) "
+                    "(check (+ i 1) n) i)))");
+    interpreter.Run("(fill 0 10000)");
+    EXPECT_EQ(interpreter.Run("(hash-table-count table)"), "10000");
+    interpreter.Run("(drop 0 10000)");
+    EXPECT_EQ(interpreter.Run("(hash-table-count table)"), "6666");
+    // every key that is left is still found after the deletions moved entries around
+    EXPECT_EQ(interpreter.Run("(check 0 10000)"), "#t");
+    interpreter.Run("(drop 0 10000)");
+    EXPECT_EQ(interpreter.Run("(hash-table-count table)"), "6666");
+}
+
+TEST(HashTableTest, BadArguments) {
+    Interpreter interpreter;
+    EXPECT_THROW(interpreter.Run("(make-hash-table -1)"), RuntimeError);
+    EXPECT_THROW(interpreter.Run("(hash-table-set! 1 2 3)"), RuntimeError);
+    EXPECT_THROW(interpreter.Run("(hash-table-count (make-hash-table) 1)"), RuntimeError);
+}
+
+TEST(HashTableTest, CyclesAreCollected) {
+    Interpreter interpreter;
+    interpreter.Run("(define (make-cycle) "
+                    "((lambda (table) (hash-table-set! table 'self table)) (make-hash-table)))");
+    interpreter.Run("(make-cycle)");
+    interpreter.Run("(make-cycle)");
+    EXPECT_GE(interpreter.CollectGarbage(), 2u);
+}
@@ -0,0 +1,93 @@
+#include <scheme.h>
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+namespace {
+
+constexpr const char* kLoop = "(define (loop n) (if (= n 0) 0 (loop (- n 1))))";
+
+std::string AbortMessage(Interpreter* interpreter, const std::string& input,
+                         const RunOptions& options) {
+    try {
+        interpreter->Run(input, options);
+    } catch (const EvaluationAborted& e) {
+        return e.what();
+    }
+    return "not aborted";
+}
+
+}  // namespace
+
+TEST(LimitsTest, StepLimit) {
+    Interpreter interpreter;
+    interpreter.Run(kLoop);
+    RunOptions options;
+    options.max_steps = 10000;
+    EXPECT_EQ(interpreter.Run("(loop 100)", options), "0");
+    EXPECT_EQ(AbortMessage(&interpreter, "(loop 1000000)", options), "step limit exceeded");
+    // every run gets the whole budget again
+    EXPECT_EQ(interpreter.Run("(loop 100)", options), "0");
+}
+
+TEST(LimitsTest, StepLimitOfBuiltins) {
+    Interpreter interpreter;
+    interpreter.Run("(define (from n) (cons-stream n (from (+ n 1))))");
+    RunOptions options;
+    options.max_steps = 10000;
+    EXPECT_EQ(AbortMessage(&interpreter, "(stream-filter (lambda (x) #f) (from 0))", options),
+              "step limit exceeded");
+}
+
+TEST(LimitsTest, Deadline) {
+    Interpreter interpreter;
+    interpreter.Run(kLoop);
+    RunOptions options;
+    options.deadline = std::chrono::steady_clock::now();
+    EXPECT_EQ(AbortMessage(&interpreter, "(loop 100000000)", options), "deadline exceeded");
+    options.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(20);
+    EXPECT_EQ(AbortMessage(&interpreter, "(loop 1000000000)", options), "deadline exceeded");
+}
+
+TEST(LimitsTest, Cancellation) {
+    Interpreter interpreter;
+    interpreter.Run(kLoop);
+    CancellationToken token;
+    RunOptions options;
+    options.cancellation = &token;
+    EXPECT_EQ(interpreter.Run("(loop 100)", options), "0");
+    std::thread canceller([&token] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        token.Cancel();
+    });
+    EXPECT_EQ(AbortMessage(&interpreter, "(loop 1000000000)", options), "evaluation cancelled");
+    canceller.join();
+}
+
+TEST(LimitsTest, DefinitionsBeforeTheAbortStay) {
+    Interpreter interpreter;
+    interpreter.Run(kLoop);
+    RunOptions options;
+    options.max_steps = 10000;
+    EXPECT_THROW(interpreter.Run("(define x (loop 1000000))", options), EvaluationAborted);
+    // an unknown name evaluates to itself
+    EXPECT_EQ(interpreter.Run("x"), "x");
+    interpreter.Run("(define y (loop 10))", options);
+    EXPECT_EQ(interpreter.Run("y"), "0");
+    // the interpreter goes on without limits
+    EXPECT_EQ(interpreter.Run("(loop 1000000)"), "0");
+}
+
+TEST(LimitsTest, BatchItemsHaveTheirOwnLimits) {
+    Interpreter interpreter;
+    interpreter.Run(kLoop);
+    RunOptions options;
+    options.max_steps = 10000;
+    std::vector<std::string> inputs(4, "(loop 1000)");
+    for (const auto& result : interpreter.RunBatch(inputs, options)) {
+        EXPECT_EQ(result, "0");
+    }
+    inputs.push_back("(loop 1000000)");
+    EXPECT_THROW(interpreter.RunBatch(inputs, options), EvaluationAborted);
+}
@@ -0,0 +1,63 @@
+#include <scheme.h>
+#include <parser.h>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+std::shared_ptr<Object> ReadForm(std::string_view source) {
+    Tokenizer tokenizer{source};
+    return Read(&tokenizer);
+}
+
+// The datum of the n-th argument of a call, which is written as 'datum.
+Object* QuotedArg(const std::shared_ptr<Object>& form, int n) {
+    auto node = form;
+    for (int i = 0; i < n; ++i) {
+        node = As<Cell>(node)->GetSecond();
+    }
+    auto* quote = As<Cell>(As<Cell>(node)->GetFirst().get());
+    return quote->GetSecond().get();
+}
+
+}  // namespace
+
+TEST(LiteralPoolTest, SmallNumbersAndBooleansAreShared) {
+    EXPECT_EQ(MakeNumber(5).get(), MakeNumber(5).get());
+    EXPECT_EQ(MakeNumber(kMinSharedNumber).get(), MakeNumber(kMinSharedNumber).get());
+    EXPECT_EQ(MakeNumber(kMaxSharedNumber).get(), MakeNumber(kMaxSharedNumber).get());
+    EXPECT_NE(MakeNumber(kMaxSharedNumber + 1).get(), MakeNumber(kMaxSharedNumber + 1).get());
+    EXPECT_EQ(MakeBoolean(true).get(), MakeBoolean(true).get());
+    EXPECT_EQ(MakeBoolean(false).get(), MakeBoolean(false).get());
+}
+
+TEST(LiteralPoolTest, EqualQuotedDataAreShared) {
+    auto form = ReadForm("(list '(1 2) '(1 2))");
+    EXPECT_EQ(QuotedArg(form, 1), QuotedArg(form, 2));
+    EXPECT_EQ(QuotedArg(form, 1)->Serialise(), "(1 2)");
+
+    form = ReadForm("(list '(5000 (6000)) '(5000 (6000)))");
+    EXPECT_EQ(QuotedArg(form, 1), QuotedArg(form, 2));
+    auto* first = As<Cell>(QuotedArg(form, 1));
+    EXPECT_EQ(first->GetFirst()->Serialise(), "5000");
+}
+
+TEST(LiteralPoolTest, DifferentQuotedDataAreNotShared) {
+    auto form = ReadForm("(list '(1 2) '(1 3))");
+    auto* first = QuotedArg(form, 1);
+    auto* second = QuotedArg(form, 2);
+    EXPECT_NE(first, second);
+    EXPECT_EQ(first->Serialise(), "(1 2)");
+    EXPECT_EQ(second->Serialise(), "(1 3)");
+    // both start with the same shared 1
+    EXPECT_EQ(As<Cell>(first)->GetFirst().get(), As<Cell>(second)->GetFirst().get());
+}
+
+TEST(LiteralPoolTest, SharedDataEvaluateAsBefore) {
+    Interpreter interpreter;
+    EXPECT_EQ(interpreter.Run("(list '(1 2) '(1 2))"), "((1 2) (1 2))");
+    EXPECT_EQ(interpreter.Run("(list '(5000 6000) '(5000 6000) '(5000))"),
+              "((5000 6000) (5000 6000) (5000))");
+    interpreter.Run("(define (f) '(1 2))");
+    EXPECT_EQ(interpreter.Run("(list (f) '(1 2))"), "((1 2) (1 2))");
+}
@@ -0,0 +1,68 @@
+#include <scheme.h>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+// (0 1 2 ... size-1)
+std::string LongList(size_t size) {
+    std::string list = "(";
+    for (size_t i = 0; i < size; ++i) {
+        list += std::to_string(i);
+        list += i + 1 < size ? " " : ")";
+    }
+    return list;
+}
+
+// (1 (1 (1 ... (1))))
+std::string Nested(size_t depth) {
+    std::string nested;
+    for (size_t i = 0; i < depth; ++i) {
+        nested += i + 1 < depth ? "(1 " : "(1";
+    }
+    return nested + std::string(depth, ')');
+}
+
+}  // namespace
+
+TEST(ParserTest, LongList) {
+    Interpreter interpreter;
+    interpreter.Run("(define l '" + LongList(1000000) + ")");
+    EXPECT_EQ(interpreter.Run("(list-ref l 999999)"), "999999");
+    EXPECT_EQ(interpreter.Run("(car (list-tail l 500000))"), "500000");
+    EXPECT_EQ(interpreter.Run("(vector-length (list->vector l))"), "1000000");
+}
+
+TEST(ParserTest, DeepNesting) {
+    constexpr size_t kDepth = 200000;
+    Interpreter interpreter;
+    interpreter.Run("(define d '" + Nested(kDepth) + ")");
+    EXPECT_EQ(interpreter.Run("d"), Nested(kDepth));
+    EXPECT_EQ(interpreter.Run("(car (cdr d))"), Nested(kDepth - 1));
+    std::string vectors;
+    for (size_t i = 0; i < kDepth; ++i) {
+        vectors += "#(";
+    }
+    vectors += std::string(kDepth, ')');
+    EXPECT_EQ(interpreter.Run(vectors), vectors);
+}
+
+TEST(ParserTest, SyntaxErrors) {
+    Interpreter interpreter;
+    EXPECT_THROW(interpreter.Run("'" + std::string(100000, '(')), SyntaxError);
+    EXPECT_THROW(interpreter.Run("'(1 2"), SyntaxError);
+    EXPECT_THROW(interpreter.Run("'(1 . 2 3)"), SyntaxError);
+    EXPECT_THROW(interpreter.Run("(+ 1 2))"), SyntaxError);
+    EXPECT_THROW(interpreter.Run("99999999999999999999"), SyntaxError);
+}
+
+TEST(ParserTest, Forms) {
+    std::string source = "(define x 1) (list 1 2) #(1 2) (+ x 1)";
+    Tokenizer tokenizer{std::string_view(source)};
+    FormReader reader(&tokenizer);
+    std::vector<std::string> forms;
+    while (!reader.IsEnd()) {
+        forms.push_back(reader.Next()->Serialise());
+    }
+    EXPECT_EQ(forms, (std::vector<std::string>{"(define x 1)", "(list 1 2)", "#(1 2)", "(+ x 1)"}));
+}
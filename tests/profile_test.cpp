@@ -0,0 +1,17 @@
+#include <scheme.h>
+
+#include <gtest/gtest.h>
+
+TEST(ProfileTest, RuntimeStats) {
+    Interpreter interpreter;
+    interpreter.ResetStats();
+    interpreter.Run("(+ 1 2)");
+    auto stats = interpreter.Run("(runtime-stats)");
+    if (SCHEME_PROFILING) {
+        EXPECT_EQ(stats.rfind("((evaluated-nodes ", 0), 0u) << stats;
+    } else {
+        // nothing is collected, so there are no counters to report
+        EXPECT_EQ(stats, "#f");
+    }
+    EXPECT_THROW(interpreter.Run("(runtime-stats 1)"), RuntimeError);
+}
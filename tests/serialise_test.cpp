@@ -0,0 +1,71 @@
+#include <scheme.h>
+
+#include <gtest/gtest.h>
+
+TEST(SerialiseTest, Values) {
+    Interpreter interpreter;
+    EXPECT_EQ(interpreter.Run("(cons 1 2)"), "(1 . 2)");
+    EXPECT_EQ(interpreter.Run("'(1 2 . 3)"), "(1 2 . 3)");
+    EXPECT_EQ(interpreter.Run("(list 1 (list 2 3) #t #f -4)"), "(1 (2 3) #t #f -4)");
+    EXPECT_EQ(interpreter.Run("(vector 1 '(a . b) #())"), "#(1 (a . b) #())");
+    EXPECT_EQ(interpreter.Run("(list)"), "()");
+}
+
+TEST(SerialiseTest, Procedures) {
+    Interpreter interpreter;
+    EXPECT_EQ(interpreter.Run("(lambda (x) x)"), "#<procedure>");
+    interpreter.Run("(define (f) 1)");
+    EXPECT_EQ(interpreter.Run("f"), "#<procedure>");
+    EXPECT_EQ(interpreter.Run("(list f car)"), "(#<procedure> #<procedure>)");
+    EXPECT_EQ(interpreter.Run("+"), "#<procedure>");
+}
+
+TEST(SerialiseTest, AppendsToCallersBuffer) {
+    Interpreter interpreter;
+    std::string output = "results:";
+    interpreter.Run("(list 1 2)", output);
+    output += ' ';
+    interpreter.Run("(+ 1 2)", output);
+    EXPECT_EQ(output, "results:(1 2) 3");
+    auto prepared = interpreter.Prepare("(vector 1 2)");
+    output.clear();
+    prepared.Execute(output);
+    prepared.Execute(output);
+    EXPECT_EQ(output, "#(1 2)#(1 2)");
+}
+
+TEST(SerialiseTest, LongList) {
+    Interpreter interpreter;
+    std::string expected = "(";
+    for (int i = 0; i < 1000000; ++i) {
+        expected += i + 1 < 1000000 ? "7 " : "7)";
+    }
+    EXPECT_EQ(interpreter.Run("(vector->list (make-vector 1000000 7))"), expected);
+}
+
+TEST(SerialiseTest, DeepNesting) {
+    constexpr int kDepth = 200000;
+    Interpreter interpreter;
+    interpreter.Run("(define (nest n acc) (if (= n 0) acc (nest (- n 1) (list 1 acc))))");
+    interpreter.Run("(define (nest-vectors n acc) "
+                    "(if (= n 0) acc (nest-vectors (- n 1) (vector acc))))");
+    std::string expected;
+    for (int i = 0; i < kDepth; ++i) {
+        expected += "(1 ";
+    }
+    expected += "()" + std::string(kDepth, ')');
+    EXPECT_EQ(interpreter.Run("(nest 200000 '())"), expected);
+    expected.clear();
+    for (int i = 0; i < kDepth; ++i) {
+        expected += "#(";
+    }
+    expected += "0" + std::string(kDepth, ')');
+    EXPECT_EQ(interpreter.Run("(nest-vectors 200000 0)"), expected);
+}
+
+TEST(SerialiseTest, VectorHoldingItself) {
+    Interpreter interpreter;
+    interpreter.Run("(define v (make-vector 2))");
+    interpreter.Run("(vector-set! v 1 v)");
+    EXPECT_EQ(interpreter.Run("v"), "#(0 #(...))");
+}
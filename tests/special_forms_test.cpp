@@ -0,0 +1,28 @@
+#include <scheme.h>
+
+#include <gtest/gtest.h>
+
+TEST(SpecialFormsTest, FormsAreNotValues) {
+    Interpreter interpreter;
+    EXPECT_THROW(interpreter.Run("((lambda (q) (q)) quote)"), SyntaxError);
+    interpreter.Run("(define (g h) (h 1 (list '+ 1 2)))");
+    // the list would be evaluated as code
+    EXPECT_THROW(interpreter.Run("(g and)"), SyntaxError);
+    EXPECT_THROW(interpreter.Run("(g or)"), SyntaxError);
+    EXPECT_THROW(interpreter.Run("(list and)"), SyntaxError);
+    EXPECT_THROW(interpreter.Run("(define x or)"), SyntaxError);
+    EXPECT_THROW(interpreter.Run("quote"), SyntaxError);
+    // applications and quoted data stay as they were
+    EXPECT_EQ(interpreter.Run("(and 1 (list '+ 1 2))"), "(+ 1 2)");
+    EXPECT_EQ(interpreter.Run("(or #f 2)"), "2");
+    EXPECT_EQ(interpreter.Run("'(and or quote)"), "(and or quote)");
+    // local variables hide them
+    EXPECT_EQ(interpreter.Run("((lambda (and) (and 1 2)) +)"), "3");
+}
+
+TEST(SpecialFormsTest, QuoteTakesOneArgument) {
+    Quote quote;
+    EXPECT_THROW(quote.Apply({}), RuntimeError);
+    std::shared_ptr<Object> value = MakeNumber(1);
+    EXPECT_EQ(quote.Apply(std::span(&value, 1)), value);
+}
@@ -0,0 +1,69 @@
+#include <scheme.h>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+void DefineNaturals(Interpreter* interpreter) {
+    interpreter->Run("(define (from n) (cons-stream n (from (+ n 1))))");
+}
+
+}  // namespace
+
+TEST(StreamTest, ForceIsMemoised) {
+    Interpreter interpreter;
+    interpreter.Run("(define calls (make-vector 1))");
+    interpreter.Run("(define p (delay (vector-ref (vector-set! calls 0 "
+                    "(+ (vector-ref calls 0) 1)) 0)))");
+    EXPECT_EQ(interpreter.Run("(promise? p)"), "#t");
+    EXPECT_EQ(interpreter.Run("(vector-ref calls 0)"), "0");
+    EXPECT_EQ(interpreter.Run("(force p)"), "1");
+    EXPECT_EQ(interpreter.Run("(force p)"), "1");
+    EXPECT_EQ(interpreter.Run("(vector-ref calls 0)"), "1");
+    // anything else is forced to itself
+    EXPECT_EQ(interpreter.Run("(force 5)"), "5");
+}
+
+TEST(StreamTest, TakeOfInfiniteStream) {
+    Interpreter interpreter;
+    DefineNaturals(&interpreter);
+    EXPECT_EQ(interpreter.Run("(stream->list (stream-take 5 (from 0)))"), "(0 1 2 3 4)");
+    EXPECT_EQ(interpreter.Run("(stream->list (stream-take 0 (from 0)))"), "()");
+    EXPECT_EQ(interpreter.Run("(stream-car (stream-cdr (stream-cdr (from 7))))"), "9");
+    EXPECT_EQ(interpreter.Run("(stream->list (stream-take 3 "
+                              "(stream-map (lambda (x) (* x x)) (from 1))))"),
+              "(1 4 9)");
+}
+
+TEST(StreamTest, FilterSkipsLongRuns) {
+    Interpreter interpreter;
+    DefineNaturals(&interpreter);
+    // the skipped elements are forced in a loop, not in nested calls
+    EXPECT_EQ(interpreter.Run("(stream-car (stream-filter (lambda (x) (= x 1000000)) (from 0)))"),
+              "1000000");
+    EXPECT_EQ(interpreter.Run("(stream->list (stream-take 3 "
+                              "(stream-filter (lambda (x) (> x 500000)) (from 0))))"),
+              "(500001 500002 500003)");
+}
+
+TEST(StreamTest, ImproperTail) {
+    Interpreter interpreter;
+    try {
+        interpreter.Run("(stream->list (cons 1 2))");
+        FAIL() << "no error";
+    } catch (const RuntimeError& e) {
+        EXPECT_STREQ(e.what(), "not a stream in stream->list");
+    }
+    EXPECT_THROW(interpreter.Run("(stream-cdr (cons 1 2))"), RuntimeError);
+    EXPECT_THROW(interpreter.Run("(stream-car 1)"), RuntimeError);
+    // lists are streams too
+    EXPECT_EQ(interpreter.Run("(stream->list '(1 2 3))"), "(1 2 3)");
+}
+
+TEST(StreamTest, LongTraversal) {
+    Interpreter interpreter;
+    DefineNaturals(&interpreter);
+    // the walked part isn't kept alive, so a long walk doesn't keep the whole stream
+    interpreter.Run("(define (nth s n) (if (= n 0) (stream-car s) (nth (stream-cdr s) (- n 1))))");
+    EXPECT_EQ(interpreter.Run("(nth (from 0) 1000000)"), "1000000");
+}
@@ -0,0 +1,42 @@
+#include <scheme.h>
+
+#include <gtest/gtest.h>
+
+// Far deeper than the native stack would allow if every call nested.
+constexpr const char* kDepth = "1000000";
+
+class TailCallTest : public ::testing::TestWithParam<EvalMode> {};
+
+TEST_P(TailCallTest, SelfCall) {
+    Interpreter interpreter;
+    interpreter.SetEvalMode(GetParam());
+    interpreter.Run("(define (count n acc) (if (= n 0) acc (count (- n 1) (+ acc 1))))");
+    EXPECT_EQ(interpreter.Run(std::string("(count ") + kDepth + " 0)"), kDepth);
+}
+
+TEST_P(TailCallTest, MutualCalls) {
+    Interpreter interpreter;
+    interpreter.SetEvalMode(GetParam());
+    interpreter.Run("(define (even? n) (if (= n 0) #t (odd? (- n 1))))");
+    interpreter.Run("(define (odd? n) (if (= n 0) #f (even? (- n 1))))");
+    EXPECT_EQ(interpreter.Run(std::string("(even? ") + kDepth + ")"), "#t");
+    EXPECT_EQ(interpreter.Run(std::string("(odd? ") + kDepth + ")"), "#f");
+}
+
+TEST_P(TailCallTest, CallOfLambdaArgument) {
+    Interpreter interpreter;
+    interpreter.SetEvalMode(GetParam());
+    interpreter.Run("(define (repeat f n x) (if (= n 0) x (repeat f (- n 1) (f x))))");
+    EXPECT_EQ(interpreter.Run(std::string("(repeat (lambda (x) (+ x 2)) ") + kDepth + " 0)"),
+              "2000000");
+}
+
+TEST_P(TailCallTest, NonTailCall) {
+    Interpreter interpreter;
+    interpreter.SetEvalMode(GetParam());
+    interpreter.Run("(define (sum n) (if (= n 0) 0 (+ n (sum (- n 1)))))");
+    EXPECT_EQ(interpreter.Run("(sum 1000)"), "500500");
+}
+
+INSTANTIATE_TEST_SUITE_P(Modes, TailCallTest,
+                         ::testing::Values(EvalMode::TREE_WALK, EvalMode::BYTECODE));
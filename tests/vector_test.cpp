@@ -0,0 +1,68 @@
+#include <scheme.h>
+
+#include <gtest/gtest.h>
+
+TEST(VectorTest, Literals) {
+    Interpreter interpreter;
+    EXPECT_EQ(interpreter.Run("#()"), "#()");
+    EXPECT_EQ(interpreter.Run("#(1 #t sym (1 2) #(3))"), "#(1 #t sym (1 2) #(3))");
+    // the elements are data, not evaluated
+    EXPECT_EQ(interpreter.Run("#((+ 1 2) x)"), "#((+ 1 2) x)");
+    EXPECT_EQ(interpreter.Run("(vector-length #(1 2 3))"), "3");
+    EXPECT_EQ(interpreter.Run("(vector-ref #(1 (2 3)) 1)"), "(2 3)");
+    EXPECT_THROW(interpreter.Run("#(1 2"), SyntaxError);
+}
+
+TEST(VectorTest, Builtins) {
+    Interpreter interpreter;
+    EXPECT_EQ(interpreter.Run("(vector 1 (+ 1 1) 'x)"), "#(1 2 x)");
+    EXPECT_EQ(interpreter.Run("(vector->list #(1 2 3))"), "(1 2 3)");
+    EXPECT_EQ(interpreter.Run("(list->vector '(1 2 3))"), "#(1 2 3)");
+    EXPECT_EQ(interpreter.Run("(vector? #())"), "#t");
+    EXPECT_EQ(interpreter.Run("(vector? '(1))"), "#f");
+    interpreter.Run("(define v (vector 1 2 3))");
+    EXPECT_EQ(interpreter.Run("(vector-set! v 2 'c)"), "#(1 2 c)");
+    EXPECT_EQ(interpreter.Run("v"), "#(1 2 c)");
+}
+
+TEST(VectorTest, MakeVector) {
+    Interpreter interpreter;
+    EXPECT_EQ(interpreter.Run("(make-vector 0)"), "#()");
+    EXPECT_EQ(interpreter.Run("(make-vector 3)"), "#(0 0 0)");
+    EXPECT_EQ(interpreter.Run("(make-vector 2 'x)"), "#(x x)");
+    EXPECT_EQ(interpreter.Run("(vector-length (make-vector 100000))"), "100000");
+    EXPECT_THROW(interpreter.Run("(make-vector -1)"), RuntimeError);
+    EXPECT_THROW(interpreter.Run("(make-vector 'a)"), RuntimeError);
+    EXPECT_THROW(interpreter.Run("(make-vector 1 2 3)"), RuntimeError);
+    // sizes that can't be allocated are bad arguments too
+    EXPECT_THROW(interpreter.Run("(make-vector 4611686018427387904)"), RuntimeError);
+    EXPECT_THROW(interpreter.Run("(make-vector 9223372036854775807)"), RuntimeError);
+}
+
+TEST(VectorTest, Bounds) {
+    Interpreter interpreter;
+    interpreter.Run("(define v (make-vector 3))");
+    EXPECT_EQ(interpreter.Run("(vector-ref v 2)"), "0");
+    EXPECT_THROW(interpreter.Run("(vector-ref v 3)"), RuntimeError);
+    EXPECT_THROW(interpreter.Run("(vector-ref v -1)"), RuntimeError);
+    EXPECT_THROW(interpreter.Run("(vector-ref v 'a)"), RuntimeError);
+    EXPECT_THROW(interpreter.Run("(vector-ref #() 0)"), RuntimeError);
+    EXPECT_THROW(interpreter.Run("(vector-set! v 3 1)"), RuntimeError);
+    EXPECT_THROW(interpreter.Run("(vector-set! v -1 1)"), RuntimeError);
+    EXPECT_THROW(interpreter.Run("(vector-set! '(1 2) 0 1)"), RuntimeError);
+    EXPECT_EQ(interpreter.Run("v"), "#(0 0 0)");
+}
+
+TEST(VectorTest, LiteralsAreImmutable) {
+    // the literal belongs to the cached tree, modifying it would change later runs
+    Interpreter interpreter(8);
+    const std::string input =
+        "(let ((v #(0))) (vector-set! v 0 (+ 1 (vector-ref v 0))) (vector-ref v 0))";
+    for (int run = 0; run < 3; ++run) {
+        EXPECT_THROW(interpreter.Run(input), RuntimeError);
+    }
+    EXPECT_THROW(interpreter.Run("(vector-set! (car '(#(0))) 0 1)"), RuntimeError);
+    EXPECT_EQ(interpreter.Run("(let ((v #(0))) (vector-ref v 0))"), "0");
+    // copies can be modified
+    EXPECT_EQ(interpreter.Run("(vector-set! (list->vector (vector->list #(0))) 0 1)"), "#(1)");
+}
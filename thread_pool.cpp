@@ -0,0 +1,128 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <utility>
+
+ThreadPool::ThreadPool(size_t threads) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        queues_.push_back(std::make_unique<Range>());
+    }
+    // the calling thread works as worker 0
+    for (size_t i = 1; i < threads; ++i) {
+        workers_.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(mutex_);
+        stop_ = true;
+    }
+    start_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& task) {
+    if (count == 0) {
+        return;
+    }
+    size_t threads = queues_.size();
+    for (size_t i = 0; i < threads; ++i) {
+        std::lock_guard lock(queues_[i]->mutex);
+        queues_[i]->begin = count * i / threads;
+        queues_[i]->end = count * (i + 1) / threads;
+    }
+    {
+        std::lock_guard lock(mutex_);
+        task_ = &task;
+        error_ = nullptr;
+        running_ = workers_.size();
+        ++generation_;
+    }
+    start_.notify_all();
+
+    Drain(0);
+
+    std::unique_lock lock(mutex_);
+    done_.wait(lock, [this] { return running_ == 0; });
+    task_ = nullptr;
+    if (error_) {
+        std::rethrow_exception(std::exchange(error_, nullptr));
+    }
+}
+
+void ThreadPool::WorkerLoop(size_t id) {
+    size_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock lock(mutex_);
+            start_.wait(lock, [&] { return stop_ || generation_ != seen; });
+            if (stop_) {
+                return;
+            }
+            seen = generation_;
+        }
+        Drain(id);
+        {
+            std::lock_guard lock(mutex_);
+            --running_;
+        }
+        done_.notify_one();
+    }
+}
+
+void ThreadPool::Drain(size_t id) {
+    size_t index;
+    do {
+        while (PopFront(id, &index)) {
+            try {
+                (*task_)(index);
+            } catch (...) {
+                std::lock_guard lock(mutex_);
+                if (!error_) {
+                    error_ = std::current_exception();
+                }
+            }
+        }
+    } while (Steal(id));
+}
+
+bool ThreadPool::PopFront(size_t id, size_t* index) {
+    Range& range = *queues_[id];
+    std::lock_guard lock(range.mutex);
+    if (range.begin == range.end) {
+        return false;
+    }
+    *index = range.begin++;
+    return true;
+}
+
+bool ThreadPool::Steal(size_t id) {
+    size_t threads = queues_.size();
+    for (size_t shift = 1; shift < threads; ++shift) {
+        Range& victim = *queues_[(id + shift) % threads];
+        size_t begin, end;
+        {
+            std::lock_guard lock(victim.mutex);
+            size_t left = victim.end - victim.begin;
+            if (left == 0) {
+                continue;
+            }
+            // a single remaining index is taken whole, the owner may be about to pop it
+            end = victim.end;
+            begin = end - (left + 1) / 2;
+            victim.end = begin;
+        }
+        Range& own = *queues_[id];
+        std::lock_guard lock(own.mutex);
+        own.begin = begin;
+        own.end = end;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of workers running index ranges. Every worker starts with an equal share of the
+// range and takes from its front, a worker that runs dry steals the back half of the next
+// non-empty share.
+class ThreadPool {
+public:
+    // threads == 0 uses one worker per hardware thread.
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t Size() const {
+        return queues_.size();
+    }
+
+    // Calls task(i) for every i in [0, count) and waits for all of them. The first exception
+    // thrown by a task is rethrown here, remaining indices are still processed.
+    void ParallelFor(size_t count, const std::function<void(size_t)>& task);
+
+private:
+    struct Range {
+        std::mutex mutex;
+        size_t begin = 0;
+        size_t end = 0;
+    };
+
+    void WorkerLoop(size_t id);
+    void Drain(size_t id);
+    bool PopFront(size_t id, size_t* index);
+    bool Steal(size_t id);
+
+    std::vector<std::unique_ptr<Range>> queues_;
+    std::vector<std::thread> workers_;
+
+    std::mutex mutex_;
+    std::condition_variable start_;
+    std::condition_variable done_;
+    const std::function<void(size_t)>* task_ = nullptr;
+    size_t generation_ = 0;
+    size_t running_ = 0;
+    bool stop_ = false;
+    std::exception_ptr error_;
+};
@@ -1,27 +1,90 @@
 #include <tokenizer.h>
 #include <error.h>
+#include <profile.h>
+
+#include <array>
+#include <limits>
+
+namespace {
+
+std::array<bool, 256> MakeCharTable(const std::string& chars) {
+    std::array<bool, 256> table{};
+    for (char c : chars) {
+        table[static_cast<unsigned char>(c)] = true;
+    }
+    return table;
+}
+
+const std::array<bool, 256> kSymbolStart = MakeCharTable(kSymbolStartConst);
+const std::array<bool, 256> kSymbolInside = MakeCharTable(kSymbolInsideConst);
+
+bool IsSymbolStart(int c) {
+    return c != EOF && kSymbolStart[static_cast<unsigned char>(c)];
+}
+
+bool IsSymbolInside(int c) {
+    return c != EOF && kSymbolInside[static_cast<unsigned char>(c)];
+}
+
+}  // namespace
+
 ////////////////////////////////////////////////////
 
 Tokenizer::Tokenizer(std::istream *in) {
     input_stream_ = in;
+    buffer_ = in->rdbuf();
+    Next();
+}
+
+Tokenizer::Tokenizer(std::string_view source) {
+    position_ = source.data();
+    end_ = source.data() + source.size();
     Next();
 }
 
+// In stream mode characters come straight from the streambuf, skipping istream's sentries.
+int Tokenizer::Peek() {
+    if (buffer_ == nullptr) {
+        return position_ != end_ ? static_cast<unsigned char>(*position_) : EOF;
+    }
+    return buffer_->sgetc();
+}
+
+char Tokenizer::Get() {
+    if (buffer_ == nullptr) {
+        return *position_++;
+    }
+    return static_cast<char>(buffer_->sbumpc());
+}
+
 bool Tokenizer::IsEnd() {
+    if (pending_) {
+        pending_ = false;
+        ReadToken();
+    }
     return is_end_;
 }
 
 void Tokenizer::Next() {
-    while (isspace(input_stream_->peek())) {
-        input_stream_->get();
+    if (buffer_ != nullptr) {
+        pending_ = true;
+    } else {
+        ReadToken();
     }
-    if (input_stream_->peek() == EOF) {
+}
+
+void Tokenizer::ReadToken() {
+    while (isspace(Peek())) {
+        Get();
+    }
+    if (Peek() == EOF) {
         is_end_ = true;
         return;
     }
+    CountToken();
 
-    char curr_char;
-    input_stream_->get(curr_char);
+    const char* token_start = position_;
+    char curr_char = Get();
 
     // Quote
     if (curr_char == '\'') {
@@ -45,34 +108,45 @@ void Tokenizer::Next() {
         return;
     }
 
-    // Bool
+    // Bool or vector
     if (curr_char == '#') {
-        if (input_stream_->peek() == 't') {
-            input_stream_->get(curr_char);
+        if (Peek() == '(') {
+            Get();
+            current_token_ = BracketToken::VECTOR_OPEN;
+            return;
+        }
+        if (Peek() == 't') {
+            Get();
             current_token_ = BoolToken{true};
             return;
         }
-        if (input_stream_->peek() == 'f') {
-            input_stream_->get(curr_char);
+        if (Peek() == 'f') {
+            Get();
             current_token_ = BoolToken{false};
             return;
         }
     }
 
     // Symbol
-    if (kSymbolStartConst.find(curr_char) != std::string::npos) {
-        std::string str;
-        str.push_back(curr_char);
-        while (input_stream_->peek() != EOF && !isspace(input_stream_->peek()) &&
-               input_stream_->peek() != ')') {
-            input_stream_->get(curr_char);
-            if (kSymbolInsideConst.find(curr_char) != std::string::npos) {
-                str.push_back(curr_char);
-            } else {
+    if (IsSymbolStart(curr_char)) {
+        if (buffer_ != nullptr) {
+            symbol_.clear();
+            symbol_.push_back(curr_char);
+        }
+        while (Peek() != EOF && !isspace(Peek()) && Peek() != ')') {
+            if (!IsSymbolInside(Peek())) {
                 throw SyntaxError("SyntaxError");
             }
+            curr_char = Get();
+            if (buffer_ != nullptr) {
+                symbol_.push_back(curr_char);
+            }
+        }
+        if (buffer_ != nullptr) {
+            current_token_ = SymbolToken{symbol_};
+        } else {
+            current_token_ = SymbolToken{std::string_view(token_start, position_ - token_start)};
         }
-        current_token_ = SymbolToken{str};
         return;
     }
 
@@ -84,45 +158,47 @@ void Tokenizer::Next() {
 
     //+
     if (curr_char == '+') {
-        if (!isdigit(input_stream_->peek())) {
+        if (!isdigit(Peek())) {
             current_token_ = SymbolToken{"+"};
             return;
         }
-        input_stream_->get(curr_char);
-        current_token_ = ConstantToken{GetNum(curr_char)};
+        current_token_ = ConstantToken{GetNum(Get())};
         return;
     }
 
     //-
     if (curr_char == '-') {
-        if (!isdigit(input_stream_->peek())) {
+        if (!isdigit(Peek())) {
             current_token_ = SymbolToken{"-"};
             return;
         }
-        input_stream_->get(curr_char);
-        current_token_ = ConstantToken{-GetNum(curr_char)};
+        current_token_ = ConstantToken{GetNum(Get(), true)};
         return;
     }
 
     throw SyntaxError("SyntaxError");
 }
 
-Token Tokenizer::GetToken() {
+const Token &Tokenizer::GetToken() {
+    if (pending_) {
+        pending_ = false;
+        ReadToken();
+    }
     return current_token_;
 }
 
-int Tokenizer::GetNum(char curr_char) {
-    std::string num;
-    num.push_back(curr_char);
-    while (input_stream_->peek() != EOF && !isspace(input_stream_->peek())) {
-        if (isdigit(input_stream_->peek())) {
-            input_stream_->get(curr_char);
-            num.push_back(curr_char);
-        } else {
-            break;
+// Digits are accumulated in place, numbers that don't fit into int64_t are a syntax error.
+int64_t Tokenizer::GetNum(char curr_char, bool negative) {
+    uint64_t limit = static_cast<uint64_t>(std::numeric_limits<int64_t>::max()) + negative;
+    uint64_t value = curr_char - '0';
+    while (isdigit(Peek())) {
+        uint64_t digit = Get() - '0';
+        if (value > (limit - digit) / 10) {
+            throw SyntaxError("number is too big");
         }
+        value = value * 10 + digit;
     }
-    return std::stoi(num);
+    return negative ? static_cast<int64_t>(0 - value) : static_cast<int64_t>(value);
 }
 
 ////////////////////////////////////////////////////
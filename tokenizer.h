@@ -1,14 +1,19 @@
 #pragma once
 
+#include <cstdint>
 #include <variant>
 #include <optional>
 #include <istream>
+#include <string>
+#include <string_view>
 const std::string kSymbolStartConst = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ<=>*/#";
 const std::string kSymbolInsideConst =
     "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ<=>*/#0123456789?!-";
 
+// The name points into the source buffer (or the tokenizer's own buffer when reading a stream)
+// and is only valid until the next call to Next().
 struct SymbolToken {
-    std::string name;
+    std::string_view name;
     bool operator==(const SymbolToken& other) const;
 };
 
@@ -25,10 +30,11 @@ struct BoolToken {
     bool operator==(const BoolToken& other) const;
 };
 
-enum class BracketToken { OPEN, CLOSE };
+// VECTOR_OPEN is #(
+enum class BracketToken { OPEN, CLOSE, VECTOR_OPEN };
 
 struct ConstantToken {
-    int value;
+    int64_t value;
     bool operator==(const ConstantToken& other) const;
 };
 
@@ -39,16 +45,32 @@ class Tokenizer {
 public:
     Tokenizer(std::istream* in);
 
+    // Reads directly from memory (e.g. a string or a MappedFile), the source must outlive the
+    // tokenizer and the tokens it produced.
+    explicit Tokenizer(std::string_view source);
+
     bool IsEnd();
 
+    // When reading a stream the next token is only read once it is looked at, so a form can be
+    // evaluated before the input that follows it arrives.
     void Next();
 
-    Token GetToken();
+    const Token& GetToken();
 
-    int GetNum(char curr_char);
+    int64_t GetNum(char curr_char, bool negative = false);
 
 private:
-    std::istream* input_stream_;
+    void ReadToken();
+    int Peek();
+    char Get();
+
+    std::istream* input_stream_ = nullptr;
+    std::streambuf* buffer_ = nullptr;
+    const char* position_ = nullptr;
+    const char* end_ = nullptr;
+    std::string symbol_;
     Token current_token_;
     bool is_end_ = false;
+    // Next() was called on a stream but the token wasn't read yet
+    bool pending_ = false;
 };